@@ -198,7 +198,7 @@ void Client::messageReceived(const Message &msg)
             {
                 const quint8 version = qMin(dataVersion, Message::highestSupportedDataVersion());
                 Message msg(endpointAddress(), Protocol::ClientDataVersionNegotiated);
-                msg << version;
+                msg << version << Protocol::supportedFeatures();
                 send(msg);
             }
 
@@ -208,8 +208,12 @@ void Client::messageReceived(const Message &msg)
         case Protocol::ServerDataVersionNegotiated:
         {
             quint8 version;
-            msg >> version;
+            quint32 features;
+            msg >> version >> features;
             Message::setNegotiatedDataVersion(version);
+            Message::setNegotiatedFeatures(features);
+            setStreamCompressionEnabled(features & Protocol::StreamCompression);
+            setMessageBatchingEnabled(true);
 
             m_initState |= ServerDataVersionNegotiated;
             break;
@@ -252,6 +256,12 @@ void Client::unregisterMessageHandler(Protocol::ObjectAddress objectAddress)
     unmonitorObject(objectAddress);
 }
 
+void Client::setCacheStatistics(Protocol::ObjectAddress objectAddress, quint64 hits,
+                                quint64 misses, quint64 evictions, qint64 size)
+{
+    m_statModel->setCacheStatistics(objectAddress, hits, misses, evictions, size);
+}
+
 void Client::objectDestroyed(Protocol::ObjectAddress objectAddress, const QString & /*objectName*/,
                              QObject * /*object*/)
 {
@@ -65,6 +65,10 @@ public:
                                 const char *messageHandlerName) override;
     void unregisterMessageHandler(Protocol::ObjectAddress objectAddress) override;
 
+    /** Reports the cache usage of the client-side model at @p objectAddress for the message statistics. */
+    void setCacheStatistics(Protocol::ObjectAddress objectAddress, quint64 hits, quint64 misses,
+                            quint64 evictions, qint64 size);
+
 signals:
     /** Emitted on transient connection errors.
      *  That is, on errors it's worth re-trying, e.g. because the target wasn't up yet.
@@ -49,13 +49,17 @@ static const MetaEnum::Value<Protocol::MessageType> message_type_table[] = {
     M(ClientDataVersionNegotiated),
     M(ModelRowColumnCountRequest),
     M(ModelContentRequest),
+    M(ModelContentRangeRequest),
+    M(ModelSubtreeRequest),
     M(ModelHeaderRequest),
     M(ModelSetDataRequest),
     M(ModelSortRequest),
     M(ModelSyncBarrier),
+    M(ModelVisibleRegionChanged),
     M(SelectionModelStateRequest),
     M(ModelRowColumnCountReply),
     M(ModelContentReply),
+    M(ModelSubtreeReply),
     M(ModelContentChanged),
     M(ModelHeaderReply),
     M(ModelHeaderChanged),
@@ -75,11 +79,16 @@ static const MetaEnum::Value<Protocol::MessageType> message_type_table[] = {
     M(ServerInfo),
     M(ProbeSettings),
     M(ServerAddress),
-    M(ServerLaunchError)
+    M(ServerLaunchError),
+    M(MessageBatch),
+    M(MessageChunk)
 };
 #undef M
 Q_STATIC_ASSERT(Protocol::MESSAGE_TYPE_COUNT - 1 == (sizeof(message_type_table) / sizeof(MetaEnum::Value<Protocol::MessageType>)));
 
+// after the message type columns
+static const int CacheColumn = Protocol::MESSAGE_TYPE_COUNT - 1;
+
 MessageStatisticsModel::Info::Info()
 {
     messageCount.resize(Protocol::MESSAGE_TYPE_COUNT);
@@ -149,10 +158,28 @@ void MessageStatisticsModel::addMessage(Protocol::ObjectAddress addr, Protocol::
     }
 }
 
+void MessageStatisticsModel::setCacheStatistics(Protocol::ObjectAddress addr, quint64 hits,
+                                                quint64 misses, quint64 evictions, qint64 size)
+{
+    addr -= 1;
+    if (addr >= m_data.size()) {
+        beginInsertRows(QModelIndex(), m_data.size(), addr);
+        m_data.resize(addr + 1);
+        endInsertRows();
+    }
+
+    auto &info = m_data[addr];
+    info.cacheHits = hits;
+    info.cacheMisses = misses;
+    info.cacheEvictions = evictions;
+    info.cacheSize = size;
+    emit dataChanged(index(addr, CacheColumn), index(addr, CacheColumn));
+}
+
 int MessageStatisticsModel::columnCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent);
-    return Protocol::MESSAGE_TYPE_COUNT - 1;
+    return CacheColumn + 1;
 }
 
 int MessageStatisticsModel::rowCount(const QModelIndex &parent) const
@@ -183,6 +210,9 @@ QVariant MessageStatisticsModel::data(const QModelIndex &index, int role) const
         return QVariant();
 
     const auto &info = m_data.at(index.row());
+    if (index.column() == CacheColumn)
+        return cacheData(info, role);
+
     const auto msgType = index.column();
 
     if (role == Qt::DisplayRole) {
@@ -217,8 +247,45 @@ QVariant MessageStatisticsModel::data(const QModelIndex &index, int role) const
     return QVariant();
 }
 
+QVariant MessageStatisticsModel::cacheData(const Info &info, int role) const
+{
+    if (info.cacheSize < 0)
+        return QVariant();
+
+    const auto accesses = info.cacheHits + info.cacheMisses;
+    if (role == Qt::DisplayRole) {
+        return QString(QString::number(info.cacheHits)
+                       + QStringLiteral(" / ")
+                       + QString::number(info.cacheMisses));
+    }
+
+    if (role == Qt::BackgroundRole && accesses > 0) {
+        return colorForRatio((double)info.cacheMisses / (double)accesses);
+    }
+
+    if (role == Qt::ToolTipRole) {
+        return tr("Object: %1\nCache Hits: %2 (%3%)\nCache Misses: %4\nCache Evictions: %5\nCached Data: %6 kB").
+               arg(info.name).
+               arg(info.cacheHits).
+               arg(accesses > 0 ? 100.0 * (double)info.cacheHits / (double)accesses : 0.0, 0, 'f', 2).
+               arg(info.cacheMisses).
+               arg(info.cacheEvictions).
+               arg(info.cacheSize / 1024);
+    }
+
+    return QVariant();
+}
+
 QVariant MessageStatisticsModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
+    if (orientation == Qt::Horizontal && section == CacheColumn) {
+        if (role == Qt::DisplayRole)
+            return tr("Model Cache");
+        if (role == Qt::ToolTipRole)
+            return tr("Cache hits / misses of client-side model data.");
+        return QVariant();
+    }
+
     if (orientation == Qt::Horizontal) {
         if (role == Qt::DisplayRole)
             return MetaEnum::enumToString(static_cast<Protocol::MessageType>(section + 1), message_type_table);
@@ -47,6 +47,9 @@ public:
     void clear();
     void addObject(Protocol::ObjectAddress addr, const QString &name);
     void addMessage(Protocol::ObjectAddress addr, Protocol::MessageType msgType, int size);
+    /** Cache usage of client-side models, shown in an extra column after the message types. */
+    void setCacheStatistics(Protocol::ObjectAddress addr, quint64 hits, quint64 misses,
+                            quint64 evictions, qint64 size);
 
     int columnCount(const QModelIndex &parent) const override;
     int rowCount(const QModelIndex &parent) const override;
@@ -65,7 +68,14 @@ private:
         QString name;
         QVector<int> messageCount;
         QVector<quint64> messageSize;
+
+        quint64 cacheHits = 0;
+        quint64 cacheMisses = 0;
+        quint64 cacheEvictions = 0;
+        qint64 cacheSize = -1; // -1 if there is no cache
     };
+    QVariant cacheData(const Info &info, int role) const;
+
     QVector<Info> m_data;
     int m_totalCount;
     quint64 m_totalSize;
@@ -36,6 +36,9 @@
 #include <QApplication>
 #include <QDataStream>
 #include <QDebug>
+#include <QIcon>
+#include <QImage>
+#include <QPixmap>
 #include <QStyle>
 #include <QStyleOptionViewItem>
 
@@ -49,18 +52,29 @@ void(*RemoteModel::s_registerClientCallback)() = nullptr;
 RemoteModel::Node::~Node()
 {
     qDeleteAll(children);
+    if (handles)
+        handles->remove(handle);
+    if (cache)
+        cache->remove(this);
 }
 
 void RemoteModel::Node::clearChildrenData()
 {
     foreach (auto child, children) {
         child->clearChildrenStructure();
-        child->data.clear();
-        child->flags.clear();
-        child->state.clear();
+        child->clearColumnData();
     }
 }
 
+void RemoteModel::Node::clearColumnData()
+{
+    if (cache)
+        cache->remove(this);
+    data.clear();
+    flags.clear();
+    state.clear();
+}
+
 void RemoteModel::Node::clearChildrenStructure()
 {
     qDeleteAll(children);
@@ -91,14 +105,95 @@ bool RemoteModel::Node::hasColumnData() const
     return data.size() == parent->columnCount && parent->columnCount > 0;
 }
 
+RemoteModel::DataCache::DataCache()
+    : budget(s_defaultCacheBudget)
+{
+    list.lruPrev = &list;
+    list.lruNext = &list;
+}
+
+void RemoteModel::DataCache::touch(Node *node)
+{
+    if (node->lruNext == &list)
+        return; // most recently used already
+    if (node->cache) {
+        Q_ASSERT(node->cache == this);
+        node->lruPrev->lruNext = node->lruNext;
+        node->lruNext->lruPrev = node->lruPrev;
+    }
+    node->cache = this;
+    node->lruPrev = list.lruPrev;
+    node->lruNext = &list;
+    list.lruPrev->lruNext = node;
+    list.lruPrev = node;
+}
+
+void RemoteModel::DataCache::remove(Node *node)
+{
+    Q_ASSERT(node->cache == this);
+    node->lruPrev->lruNext = node->lruNext;
+    node->lruNext->lruPrev = node->lruPrev;
+    node->lruPrev = nullptr;
+    node->lruNext = nullptr;
+    node->cache = nullptr;
+    size -= node->cacheCost;
+    node->cacheCost = 0;
+}
+
+// rough estimate of the memory held by a cached cell, it only needs to be
+// good enough to keep the cache size in the right order of magnitude
+static qint64 cellCost(const QHash<int, QVariant> &data)
+{
+    qint64 cost = 0;
+    for (auto it = data.constBegin(); it != data.constEnd(); ++it) {
+        cost += 2 * sizeof(void *) + sizeof(int) + sizeof(QVariant);
+        const auto &value = it.value();
+        switch (value.userType()) {
+        case QMetaType::QString:
+            cost += value.toString().size() * sizeof(QChar);
+            break;
+        case QMetaType::QByteArray:
+            cost += value.toByteArray().size();
+            break;
+        case QMetaType::QStringList:
+            for (const auto &str : value.toStringList())
+                cost += sizeof(QString) + str.size() * sizeof(QChar);
+            break;
+        case QMetaType::QPixmap:
+        {
+            const auto pixmap = value.value<QPixmap>();
+            cost += pixmap.width() * pixmap.height() * pixmap.depth() / 8;
+            break;
+        }
+        case QMetaType::QImage:
+            cost += value.value<QImage>().byteCount();
+            break;
+        case QMetaType::QIcon:
+            cost += 16 * 16 * 4; // typically a single small pixmap
+            break;
+        default:
+            break;
+        }
+    }
+    return cost;
+}
+
 QVariant RemoteModel::s_emptyDisplayValue;
 QVariant RemoteModel::s_emptySizeHintValue;
+qint64 RemoteModel::s_defaultCacheBudget = []() -> qint64 {
+    bool ok = false;
+    const auto size = qgetenv("GAMMARAY_MODEL_CACHE_SIZE").toLongLong(&ok);
+    return (ok && size > 0 ? size : 64) * 1024 * 1024;
+}();
 
 RemoteModel::RemoteModel(const QString &serverObject, QObject *parent)
     : QAbstractItemModel(parent)
     , m_pendingRequestsTimer(new QTimer(this))
+    , m_cacheStatisticsTimer(new QTimer(this))
     , m_serverObject(serverObject)
     , m_myAddress(Protocol::InvalidObjectAddress)
+    , m_subtreeRequestId(0)
+    , m_viewportsChanged(false)
     , m_currentSyncBarrier(0)
     , m_targetSyncBarrier(0)
     , m_proxyDynamicSortFilter(false)
@@ -120,6 +215,11 @@ RemoteModel::RemoteModel(const QString &serverObject, QObject *parent)
     m_pendingRequestsTimer->setSingleShot(true);
     connect(m_pendingRequestsTimer, &QTimer::timeout, this, &RemoteModel::doRequests);
 
+    // data() is called far too often to report every cache access right away
+    m_cacheStatisticsTimer->setInterval(1000);
+    m_cacheStatisticsTimer->setSingleShot(true);
+    connect(m_cacheStatisticsTimer, &QTimer::timeout, this, &RemoteModel::reportCacheStatistics);
+
     registerClient(serverObject);
     connectToServer();
 }
@@ -207,8 +307,14 @@ QVariant RemoteModel::data(const QModelIndex &index, int role) const
             return s_emptySizeHintValue;
     }
 
-    if ((state & RemoteModelNodeState::Outdated) && ((state & RemoteModelNodeState::Loading) == 0))
+    if ((state & RemoteModelNodeState::Outdated) && ((state & RemoteModelNodeState::Loading) == 0)) {
+        if (state & RemoteModelNodeState::Empty)
+            ++m_cache.misses;
         requestDataAndFlags(index);
+    }
+
+    if (!m_cacheStatisticsTimer->isActive())
+        m_cacheStatisticsTimer->start();
 
     if (state & RemoteModelNodeState::Empty) { // still waiting for data
         if (role == Qt::DisplayRole)
@@ -216,6 +322,11 @@ QVariant RemoteModel::data(const QModelIndex &index, int role) const
         return QVariant();
     }
 
+    // views query many roles per cell, count each cell access once to match the misses
+    if (role == Qt::DisplayRole)
+        ++m_cache.hits;
+    m_cache.touch(node);
+
     // note .value returns good defaults otherwise
     Q_ASSERT(node->data.size() > index.column());
     return node->data.at(index.column()).value(role);
@@ -227,7 +338,7 @@ bool RemoteModel::setData(const QModelIndex &index, const QVariant &value, int r
         return false;
 
     Message msg(m_myAddress, Protocol::ModelSetDataRequest);
-    msg << Protocol::fromQModelIndex(index) << role << value;
+    msg << fromQModelIndex(index) << role << value;
     sendMessage(msg);
     return false;
 }
@@ -273,6 +384,299 @@ void RemoteModel::sort(int column, Qt::SortOrder order)
     sendMessage(msg);
 }
 
+void RemoteModel::setVisibleRegion(const QItemSelection &region)
+{
+    if (region == m_visibleRegion)
+        return;
+    m_visibleRegion = region;
+    if (!isConnected())
+        return;
+
+    QVector<QPair<Protocol::ModelIndex, Protocol::ModelIndex> > ranges;
+    ranges.reserve(region.size());
+    for (const auto &range : region) {
+        if (range.isValid())
+            ranges.push_back(qMakePair(fromQModelIndex(range.topLeft()), fromQModelIndex(range.bottomRight())));
+    }
+
+    Message msg(m_myAddress, Protocol::ModelVisibleRegionChanged);
+    msg << quint32(ranges.size());
+    for (const auto &range : qAsConst(ranges))
+        msg << range.first << range.second;
+    sendMessage(msg);
+}
+
+qint64 RemoteModel::cacheBudget() const
+{
+    return m_cache.budget;
+}
+
+void RemoteModel::setCacheBudget(qint64 bytes)
+{
+    m_cache.budget = bytes;
+    evictCachedData();
+}
+
+void RemoteModel::setCellData(Node *node, int column, const ItemData &data, Qt::ItemFlags flags)
+{
+    Q_ASSERT(node->data.size() > column);
+    const auto cost = cellCost(data) - cellCost(node->data.at(column));
+    node->data[column] = data;
+    node->flags[column] = flags;
+    m_cache.touch(node);
+    node->cacheCost += cost;
+    m_cache.size += cost;
+}
+
+void RemoteModel::evictCachedData()
+{
+    auto link = m_cache.list.lruNext;
+    while (m_cache.size > m_cache.budget && link != &m_cache.list) {
+        auto node = static_cast<Node *>(link);
+        link = link->lruNext;
+        // the reply would find nowhere to go
+        const bool loading = std::any_of(node->state.constBegin(), node->state.constEnd(), [](RemoteModelNodeState::NodeStates state) {
+            return state & RemoteModelNodeState::Loading;
+        });
+        if (loading)
+            continue;
+        node->clearColumnData();
+        ++m_cache.evictions;
+    }
+
+    if (!m_cacheStatisticsTimer->isActive())
+        m_cacheStatisticsTimer->start();
+}
+
+void RemoteModel::reportCacheStatistics()
+{
+    if (!Client::instance() || !isConnected())
+        return;
+    Client::instance()->setCacheStatistics(m_myAddress, m_cache.hits, m_cache.misses, m_cache.evictions, m_cache.size);
+}
+
+void RemoteModel::fetchSubtree(const QModelIndex &index, int depth)
+{
+    if (!isConnected())
+        return;
+
+    Node *node = nodeForIndex(index);
+    Q_ASSERT(node);
+    const qint32 id = ++m_subtreeRequestId;
+    m_pendingSubtrees.insert(id, node);
+
+    Message msg(m_myAddress, Protocol::ModelSubtreeRequest);
+    msg << id << fromQModelIndex(index) << qint32(depth) << qint32(SubtreeNodeBudget);
+    sendMessage(msg);
+}
+
+void RemoteModel::setViewport(QObject *view, const QItemSelection &visible)
+{
+    Q_ASSERT(view);
+    if (visible.isEmpty()) {
+        if (!m_viewports.remove(view))
+            return;
+        disconnect(view, &QObject::destroyed, this, &RemoteModel::viewDestroyed);
+    } else {
+        connect(view, &QObject::destroyed, this, &RemoteModel::viewDestroyed, Qt::UniqueConnection);
+        m_viewports.insert(view, visible);
+        m_viewportsChanged = true;
+        m_pendingRequestsTimer->start();
+    }
+    updateVisibleRegion();
+}
+
+void RemoteModel::viewDestroyed(QObject *view)
+{
+    if (m_viewports.remove(view))
+        updateVisibleRegion();
+}
+
+void RemoteModel::updateVisibleRegion()
+{
+    QItemSelection region;
+    for (const auto &viewport : qAsConst(m_viewports))
+        region.merge(viewport, QItemSelectionModel::Select);
+    setVisibleRegion(region);
+}
+
+void RemoteModel::applyViewports() const
+{
+    // only once per viewport change, so that requests made by other views for
+    // rows outside of the viewports get through on the next attempt
+    if (!m_viewportsChanged || !isConnected())
+        return;
+    m_viewportsChanged = false;
+
+    struct Window {
+        Node *parent;
+        int firstRow;
+        int lastRow;
+    };
+    QVector<Window> windows;
+    for (const auto &viewport : m_viewports) {
+        for (const auto &range : viewport) {
+            if (!range.isValid())
+                continue;
+            Node *parentNode = nodeForIndex(range.parent());
+            const int rowCount = qMin(parentNode->rowCount, parentNode->children.size());
+            if (rowCount <= 0 || parentNode->columnCount <= 0)
+                continue;
+            // one page in either direction
+            const int margin = range.height();
+            windows.push_back({ parentNode, qMax(0, range.top() - margin), qMin(rowCount - 1, range.bottom() + margin) });
+        }
+    }
+
+    // drop requests for rows the user scrolled away from
+    auto pending = m_pendingRequests.find(DataAndFlags);
+    if (pending != m_pendingRequests.end()) {
+        QVector<QModelIndex> dropped;
+        auto &indexes = pending.value();
+        indexes.erase(std::remove_if(indexes.begin(), indexes.end(), [&](const Protocol::ModelIndex &index) {
+            Node *node = nodeForIndex(index);
+            if (!node)
+                return true;
+            const auto row = index.last().row;
+            bool covered = false;
+            for (const auto &window : qAsConst(windows)) {
+                if (window.parent != node->parent)
+                    continue;
+                if (row >= window.firstRow && row <= window.lastRow)
+                    return false;
+                covered = true;
+            }
+            if (!covered)
+                return false; // not shown in any view telling us about its viewport
+
+            const auto column = index.last().column;
+            Q_ASSERT(node->state.size() > column);
+            node->state[column] &= ~RemoteModelNodeState::Loading;
+            dropped.push_back(createIndex(row, column, node));
+            return true;
+        }), indexes.end());
+        if (indexes.isEmpty())
+            m_pendingRequests.erase(pending);
+
+        // in case some other view still shows those, it will ask again
+        for (const auto &index : qAsConst(dropped))
+            emit const_cast<RemoteModel *>(this)->dataChanged(index, index);
+    }
+
+    // prefetch everything in the windows not loaded or on its way yet, in row ranges
+    QVector<QPair<Node *, QPair<int, int> > > ranges;
+    for (const auto &window : qAsConst(windows)) {
+        int firstRow = -1;
+        for (int row = window.firstRow; row <= window.lastRow + 1; ++row) {
+            bool needed = false;
+            if (row <= window.lastRow) {
+                Node *node = window.parent->children.at(row);
+                node->allocateColumns();
+                for (int column = 0; column < node->state.size(); ++column) {
+                    const auto state = node->state.at(column);
+                    if ((state & RemoteModelNodeState::Outdated) && (state & RemoteModelNodeState::Loading) == 0) {
+                        node->state[column] = state | RemoteModelNodeState::Loading;
+                        needed = true;
+                    }
+                }
+            }
+            if (needed && firstRow < 0) {
+                firstRow = row;
+            } else if (!needed && firstRow >= 0) {
+                ranges.push_back(qMakePair(window.parent, qMakePair(firstRow, row - 1)));
+                firstRow = -1;
+            }
+        }
+    }
+    if (ranges.isEmpty())
+        return;
+
+    Message msg(m_myAddress, Protocol::ModelContentRangeRequest);
+    msg << quint32(ranges.size());
+    for (const auto &range : qAsConst(ranges)) {
+        msg << fromQModelIndex(modelIndexForNode(range.first, 0))
+            << qint32(range.second.first) << qint32(range.second.second)
+            << qint32(0) << qint32(range.first->columnCount - 1);
+    }
+    sendMessage(msg);
+}
+
+void RemoteModel::setRowColumnCount(Node *node, qint32 rowCount, qint32 columnCount, qint32 handle)
+{
+    if (handle >= 0)
+        setNodeHandle(node, handle);
+
+    const QModelIndex qmi = modelIndexForNode(node, 0);
+
+    if (columnCount > 0) {
+        beginInsertColumns(qmi, 0, columnCount - 1);
+        node->columnCount = columnCount;
+        endInsertColumns();
+    } else {
+        node->columnCount = columnCount;
+    }
+
+    if (rowCount > 0) {
+        beginInsertRows(qmi, 0, rowCount - 1);
+        node->children.reserve(rowCount);
+        for (int i = 0; i < rowCount; ++i) {
+            auto *child = new Node;
+            child->parent = node;
+            node->children.push_back(child);
+        }
+        node->rowCount = rowCount;
+        endInsertRows();
+    } else {
+        node->rowCount = rowCount;
+    }
+}
+
+void RemoteModel::emitDataChanged(const QHash<QModelIndex, QVector<QModelIndex> > &indexesByParent)
+{
+    // the bounding rect per hierarchy level as an approximation of perfect range batching
+    for (auto it = indexesByParent.constBegin(); it != indexesByParent.constEnd(); ++it) {
+        const auto &indexes = it.value();
+        Q_ASSERT(!indexes.isEmpty());
+        int r1 = std::numeric_limits<int>::max(), r2 = 0, c1 = std::numeric_limits<int>::max(),
+            c2 = 0;
+        for (const auto &index : indexes) {
+            r1 = std::min(r1, index.row());
+            r2 = std::max(r2, index.row());
+            c1 = std::min(c1, index.column());
+            c2 = std::max(c2, index.column());
+        }
+        const auto qmi = indexes.at(0);
+        emit dataChanged(qmi.sibling(r1, c1), qmi.sibling(r2, c2));
+    }
+}
+
+void RemoteModel::readContent(const Message &msg,
+                              const std::function<void(const Protocol::ModelIndex &, const ItemData &, qint32)> &updateCell)
+{
+    if (Message::negotiatedFeatures() & Protocol::ColumnarModelContent) {
+        Protocol::ModelContent content;
+        msg >> content;
+        for (int i = 0; i < content.indexes.size(); ++i) {
+            ItemData itemData;
+            itemData.reserve(content.itemData.at(i).size());
+            const auto &cellData = content.itemData.at(i);
+            for (auto it = cellData.constBegin(); it != cellData.constEnd(); ++it)
+                itemData.insert(it.key(), it.value());
+            updateCell(content.indexes.at(i), itemData, content.flags.at(i));
+        }
+    } else {
+        quint32 size;
+        msg >> size;
+        for (quint32 i = 0; i < size; ++i) {
+            Protocol::ModelIndex index;
+            ItemData itemData;
+            qint32 flags;
+            msg >> index >> itemData >> flags;
+            updateCell(index, itemData, flags);
+        }
+    }
+}
+
 void RemoteModel::newMessage(const GammaRay::Message &msg)
 {
     if (!checkSyncBarrier(msg))
@@ -289,8 +693,8 @@ void RemoteModel::newMessage(const GammaRay::Message &msg)
             // We now need to read the complete entries because of the break -> continue change
             Protocol::ModelIndex index;
             msg >> index;
-            qint32 rowCount, columnCount;
-            msg >> rowCount >> columnCount;
+            qint32 rowCount, columnCount, handle;
+            msg >> rowCount >> columnCount >> handle;
 
             Node *node = nodeForIndex(index);
             if (!node) {
@@ -305,6 +709,13 @@ void RemoteModel::newMessage(const GammaRay::Message &msg)
             // we get -1/-1 if we requested for an invalid index, e.g. due to not having processed
             // all structure changes yet. This will automatically trigger a retry.
             Q_ASSERT((rowCount >= 0 && columnCount >= 0) || (rowCount == -1 && columnCount == -1));
+
+            // The handle belongs to whatever is at this index now, as we processed all structure
+            // changes up to this reply. We need it even when ignoring the rest, the server uses
+            // it for addressing the children of this node from now on.
+            if (handle >= 0 && node != m_root)
+                setNodeHandle(node, handle);
+
             if (node->rowCount >= 0 || node->columnCount >= 0) {
                 // This can happen in similar racy conditions as below, when we request the row/col count
                 // for two different Node* at the same index (one was deleted inbetween and then the other
@@ -317,59 +728,24 @@ void RemoteModel::newMessage(const GammaRay::Message &msg)
                 continue; // we didn't ask for this, probably outdated response for a moved node
 
             Q_ASSERT(node->rowCount < -1 && node->columnCount == -1);
-
-            const QModelIndex qmi = modelIndexForNode(node, 0);
-
-            if (columnCount > 0) {
-                beginInsertColumns(qmi, 0, columnCount - 1);
-                node->columnCount = columnCount;
-                endInsertColumns();
-            } else {
-                node->columnCount = columnCount;
-            }
-
-            if (rowCount > 0) {
-                beginInsertRows(qmi, 0, rowCount - 1);
-                node->children.reserve(rowCount);
-                for (int i = 0; i < rowCount; ++i) {
-                    auto *child = new Node;
-                    child->parent = node;
-                    node->children.push_back(child);
-                }
-                node->rowCount = rowCount;
-                endInsertRows();
-            } else {
-                node->rowCount = rowCount;
-            }
+            setRowColumnCount(node, rowCount, columnCount, handle);
         }
         break;
     }
 
     case Protocol::ModelContentReply:
     {
-        quint32 size;
-        msg >> size;
-        Q_ASSERT(size > 0);
-
         QHash<QModelIndex, QVector<QModelIndex> > dataChangedIndexes;
-        for (quint32 i = 0; i < size; ++i) {
-            Protocol::ModelIndex index;
-            msg >> index;
+        const auto updateCell = [this, &dataChangedIndexes](const Protocol::ModelIndex &index, const ItemData &itemData, qint32 flags) {
             Node *node = nodeForIndex(index);
             const auto column = index.last().column;
             const auto state = node ? stateForColumn(node, column) : RemoteModelNodeState::NoState;
-            typedef QHash<int, QVariant> ItemData;
-            ItemData itemData;
-            qint32 flags;
-            msg >> itemData >> flags;
             if ((state & RemoteModelNodeState::Loading) == 0)
-                continue; // we didn't ask for this, probably outdated response for a moved cell
+                return; // we didn't ask for this, probably outdated response for a moved cell
 
             if (node) {
                 node->allocateColumns();
-                Q_ASSERT(node->data.size() > column);
-                node->data[column] = itemData;
-                node->flags[column] = static_cast<Qt::ItemFlags>(flags);
+                setCellData(node, column, itemData, static_cast<Qt::ItemFlags>(flags));
                 node->state[column] = state & ~(RemoteModelNodeState::Loading | RemoteModelNodeState::Empty | RemoteModelNodeState::Outdated);
 
                 if ((flags & Qt::ItemNeverHasChildren) && column == 0) {
@@ -377,27 +753,68 @@ void RemoteModel::newMessage(const GammaRay::Message &msg)
                     node->columnCount = node->data.size();
                 }
 
-                // group by parent, and emit dataChange for the bounding rect per hierarchy level
-                // as an approximiation of perfect range batching
+                // group by parent, see emitDataChanged()
                 const QModelIndex qmi = modelIndexForNode(node, column);
                 dataChangedIndexes[qmi.parent()].push_back(qmi);
             }
-        }
+        };
 
-        for (auto it = dataChangedIndexes.constBegin(); it != dataChangedIndexes.constEnd(); ++it) {
-            const auto &indexes = it.value();
-            Q_ASSERT(!indexes.isEmpty());
-            int r1 = std::numeric_limits<int>::max(), r2 = 0, c1 = std::numeric_limits<int>::max(),
-                c2 = 0;
-            for (const auto &index : indexes) {
-                r1 = std::min(r1, index.row());
-                r2 = std::max(r2, index.row());
-                c1 = std::min(c1, index.column());
-                c2 = std::max(c2, index.column());
+        readContent(msg, updateCell);
+        emitDataChanged(dataChangedIndexes);
+        evictCachedData();
+        break;
+    }
+
+    case Protocol::ModelSubtreeReply:
+    {
+        qint32 id;
+        msg >> id;
+        // the subtree root is gone, and the indexes in here might point to other nodes by now
+        if (!m_pendingSubtrees.remove(id))
+            break;
+
+        quint32 size;
+        msg >> size;
+        for (quint32 i = 0; i < size; ++i) {
+            Protocol::ModelIndex index;
+            qint32 rowCount, columnCount, handle;
+            msg >> index >> rowCount >> columnCount >> handle;
+
+            // parents come first, so this only fails for nodes that changed in the meantime
+            Node *node = nodeForIndex(index);
+            if (!node)
+                continue;
+            if (node->rowCount >= 0 || node->columnCount >= 0) {
+                // known already, but the handle might be new and used for the children below
+                if (handle >= 0 && node != m_root)
+                    setNodeHandle(node, handle);
+                continue;
+            }
+            if (rowCount < 0) {
+                node->rowCount = -1; // retry on next access
+                continue;
             }
-            const auto qmi = indexes.at(0);
-            emit dataChanged(qmi.sibling(r1, c1), qmi.sibling(r2, c2));
+            setRowColumnCount(node, rowCount, columnCount, handle);
         }
+
+        // unlike with ModelContentReply the content arrives unrequested, so only fill gaps with it
+        QHash<QModelIndex, QVector<QModelIndex> > dataChangedIndexes;
+        readContent(msg, [this, &dataChangedIndexes](const Protocol::ModelIndex &index, const ItemData &itemData, qint32 flags) {
+            Node *node = nodeForIndex(index);
+            const auto column = index.last().column;
+            if (!node || (stateForColumn(node, column) & RemoteModelNodeState::Empty) == 0)
+                return;
+            node->allocateColumns();
+            if (node->data.size() <= column)
+                return;
+            setCellData(node, column, itemData, static_cast<Qt::ItemFlags>(flags));
+            node->state[column] &= ~(RemoteModelNodeState::Empty | RemoteModelNodeState::Outdated);
+
+            const QModelIndex qmi = modelIndexForNode(node, column);
+            dataChangedIndexes[qmi.parent()].push_back(qmi);
+        });
+        emitDataChanged(dataChangedIndexes);
+        evictCachedData();
         break;
     }
 
@@ -446,10 +863,22 @@ void RemoteModel::newMessage(const GammaRay::Message &msg)
             }
         }
 
+        // new content of cells we marked as visible
+        readContent(msg, [this](const Protocol::ModelIndex &index, const ItemData &itemData, qint32 flags) {
+            Node *node = nodeForIndex(index);
+            const auto column = index.last().column;
+            if (!node || !node->hasColumnData() || node->data.size() <= column)
+                return; // not loaded here, no need to keep this then
+            setCellData(node, column, itemData, static_cast<Qt::ItemFlags>(flags));
+            // an ongoing request is fine to complete, its reply can't be older than this
+            node->state[column] = stateForColumn(node, column) & ~(RemoteModelNodeState::Empty | RemoteModelNodeState::Outdated);
+        });
+
         const QModelIndex qmiBegin = modelIndexForNode(node, beginIndex.last().column);
         const QModelIndex qmiEnd = qmiBegin.sibling(endIndex.last().row, endIndex.last().column);
 
         emit dataChanged(qmiBegin, qmiEnd, roles);
+        evictCachedData();
         break;
     }
 
@@ -472,10 +901,14 @@ void RemoteModel::newMessage(const GammaRay::Message &msg)
     {
         Protocol::ModelIndex parentIndex;
         int first, last;
-        msg >> parentIndex >> first >> last;
+        qint32 parentHandle;
+        msg >> parentIndex >> first >> last >> parentHandle;
         Q_ASSERT(last >= first);
 
         Node *parentNode = nodeForIndex(parentIndex);
+        // the children are addressed relative to that from now on
+        if (parentNode && parentNode != m_root && parentHandle >= 0)
+            setNodeHandle(parentNode, parentHandle);
         if (!parentNode || parentNode->rowCount < 0)
             return; // we don't know the parent yet, so we don't care about changes to it either
         Q_ASSERT(first <= parentNode->rowCount);
@@ -502,12 +935,15 @@ void RemoteModel::newMessage(const GammaRay::Message &msg)
     {
         Protocol::ModelIndex sourceParentIndex, destParentIndex;
         int sourceFirst, sourceLast, destChild;
+        qint32 destHandle;
         msg >> sourceParentIndex >> sourceFirst >> sourceLast >> destParentIndex
-        >> destChild;
+        >> destChild >> destHandle;
         Q_ASSERT(sourceLast >= sourceFirst);
 
         Node *sourceParent = nodeForIndex(sourceParentIndex);
         Node *destParent = nodeForIndex(destParentIndex);
+        if (destParent && destParent != m_root && destHandle >= 0)
+            setNodeHandle(destParent, destHandle);
 
         const bool sourceKnown = sourceParent && sourceParent->rowCount >= 0;
         const bool destKnown = destParent && destParent->rowCount >= 0;
@@ -583,6 +1019,7 @@ void RemoteModel::newMessage(const GammaRay::Message &msg)
             emit layoutAboutToBeChanged();
             foreach (const auto &persistentIndex, persistentIndexList())
                 changePersistentIndex(persistentIndex, QModelIndex());
+            dropPendingSubtrees(m_root, false);
             if (hint == 0)
                 m_root->clearChildrenStructure();
             else
@@ -614,6 +1051,7 @@ void RemoteModel::newMessage(const GammaRay::Message &msg)
             }
         }
         for (auto node : qAsConst(parentNodes)) {
+            dropPendingSubtrees(node, false);
             if (hint == 0)
                 node->clearChildrenStructure();
             else
@@ -657,14 +1095,60 @@ RemoteModel::Node *RemoteModel::nodeForIndex(const QModelIndex &index) const
 RemoteModel::Node *RemoteModel::nodeForIndex(const Protocol::ModelIndex &index) const
 {
     Node *node = m_root;
-    for (auto i : index) {
-        if (node->children.size() <= i.row)
+    auto it = index.constBegin();
+    if (it != index.constEnd() && it->row == Protocol::NodeHandleRow) {
+        node = m_nodeHandles.value(it->column);
+        if (!node)
+            return nullptr;
+        ++it;
+    }
+
+    for (; it != index.constEnd(); ++it) {
+        if (node->children.size() <= it->row)
             return nullptr;
-        node = node->children.at(i.row);
+        node = node->children.at(it->row);
     }
     return node;
 }
 
+Protocol::ModelIndex RemoteModel::fromQModelIndex(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return {};
+
+    // path up to the closest ancestor with a handle
+    Protocol::ModelIndex result;
+    result.push_back(Protocol::ModelIndexData(index.row(), index.column()));
+    for (Node *node = nodeForIndex(index)->parent; node != m_root; node = node->parent) {
+        if (node->handle >= 0) {
+            result.push_back(Protocol::ModelIndexData(Protocol::NodeHandleRow, node->handle));
+            break;
+        }
+        result.push_back(Protocol::ModelIndexData(node->parent->children.indexOf(node), 0));
+    }
+    std::reverse(result.begin(), result.end());
+    return result;
+}
+
+void RemoteModel::setNodeHandle(Node *node, qint32 handle)
+{
+    Q_ASSERT(node != m_root);
+    if (node->handle == handle)
+        return;
+
+    if (node->handles)
+        m_nodeHandles.remove(node->handle);
+    // the previous owner of this handle is gone on the server side
+    if (Node *previous = m_nodeHandles.value(handle)) {
+        previous->handle = -1;
+        previous->handles = nullptr;
+    }
+
+    node->handle = handle;
+    node->handles = &m_nodeHandles;
+    m_nodeHandles.insert(handle, node);
+}
+
 QModelIndex RemoteModel::modelIndexForNode(Node *node, int column) const
 {
     Q_ASSERT(node);
@@ -687,6 +1171,16 @@ bool RemoteModel::isAncestor(RemoteModel::Node *ancestor, RemoteModel::Node *chi
     return isAncestor(ancestor, child->parent);
 }
 
+void RemoteModel::dropPendingSubtrees(RemoteModel::Node *node, bool inclusive)
+{
+    for (auto it = m_pendingSubtrees.begin(); it != m_pendingSubtrees.end();) {
+        if ((inclusive && it.value() == node) || isAncestor(node, it.value()))
+            it = m_pendingSubtrees.erase(it);
+        else
+            ++it;
+    }
+}
+
 RemoteModelNodeState::NodeStates RemoteModel::stateForColumn(RemoteModel::Node *node, int columnIndex) const
 {
     Q_ASSERT(node);
@@ -704,10 +1198,15 @@ void RemoteModel::requestRowColumnCount(const QModelIndex &index) const
 
     if (node->rowCount < -1) // already requesting
         return;
+    // on its way already, and if not we get asked again once the reply arrives
+    for (auto subtree : m_pendingSubtrees) {
+        if (subtree == node || isAncestor(subtree, node))
+            return;
+    }
     node->rowCount = -2;
 
     auto &indexes = m_pendingRequests[RowColumnCount];
-    indexes.push_back(Protocol::fromQModelIndex(index));
+    indexes.push_back(fromQModelIndex(index));
     if (indexes.size() > 100) {
         m_pendingRequestsTimer->stop();
         doRequests();
@@ -729,7 +1228,7 @@ void RemoteModel::requestDataAndFlags(const QModelIndex &index) const
     node->state[index.column()] = state | RemoteModelNodeState::Loading; // mark pending request
 
     auto &indexes = m_pendingRequests[DataAndFlags];
-    indexes.push_back(Protocol::fromQModelIndex(index));
+    indexes.push_back(fromQModelIndex(index));
     if (indexes.size() > 100) {
         m_pendingRequestsTimer->stop();
         doRequests();
@@ -740,6 +1239,8 @@ void RemoteModel::requestDataAndFlags(const QModelIndex &index) const
 
 void RemoteModel::doRequests() const
 {
+    applyViewports();
+
     QMutableMapIterator<RequestType, QVector<Protocol::ModelIndex>> it(m_pendingRequests);
 
     while (it.hasNext()) {
@@ -797,6 +1298,7 @@ void RemoteModel::clear()
 
     delete m_root;
     m_root = new Node;
+    m_pendingSubtrees.clear();
     m_horizontalHeaders.clear();
     m_verticalHeaders.clear();
     endResetModel();
@@ -880,8 +1382,10 @@ void RemoteModel::doRemoveRows(RemoteModel::Node *parentNode, int first, int las
         m_verticalHeaders.remove(first, last - first + 1);
 
     // delete nodes
-    for (int i = first; i <= last; ++i)
+    for (int i = first; i <= last; ++i) {
+        dropPendingSubtrees(parentNode->children.at(i), true);
         delete parentNode->children.at(i);
+    }
     parentNode->children.remove(first, last - first + 1);
 
     // adjust row count
@@ -977,6 +1481,13 @@ void RemoteModel::doRemoveColumns(RemoteModel::Node *parentNode, int first, int
     for (auto node : qAsConst(parentNode->children)) {
         if (!node->hasColumnData())
             continue;
+        if (node->cache) {
+            qint64 cost = 0;
+            for (int column = first; column <= last; ++column)
+                cost += cellCost(node->data.at(column));
+            node->cacheCost -= cost;
+            m_cache.size -= cost;
+        }
         node->data.remove(first, delColCount);
         node->flags.remove(first, delColCount);
         node->state.remove(first, delColCount);
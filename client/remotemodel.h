@@ -35,11 +35,15 @@
 #include <common/remotemodelroles.h>
 
 #include <QAbstractItemModel>
+#include <QHash>
+#include <QItemSelection>
 #include <QRegExp>
 #include <QSet>
 #include <QTimer>
 #include <QVector>
 
+#include <functional>
+
 namespace GammaRay {
 class Message;
 
@@ -75,6 +79,34 @@ public:
                         int role = Qt::DisplayRole) const override;
     void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
 
+    /** Marks the cells in @p region as currently shown. Changes to those are sent along
+     *  with their new content, rather than just invalidating them.
+     *  Pass an empty selection to stop that.
+     */
+    void setVisibleRegion(const QItemSelection &region);
+
+    /** Viewport hint for views, @p visible being the cells @p view currently shows.
+     *  A window of rows around those is prefetched, and queued requests for rows that
+     *  left it are dropped. Visible cells are also kept up to date, see setVisibleRegion().
+     *  Pass an empty selection when @p view stops showing this model.
+     */
+    Q_INVOKABLE void setViewport(QObject *view, const QItemSelection &visible);
+
+    /** Fetches the structure of the subtree below @p index, down to @p depth levels
+     *  (-1 for everything), along with the first column content, in a single round trip.
+     *  Large subtrees are cut off after a fixed number of nodes, the remainder is
+     *  loaded on demand as usual. Meant for views about to expand recursively.
+     */
+    Q_INVOKABLE void fetchSubtree(const QModelIndex &index, int depth);
+
+    /** Upper bound for the estimated memory used by cached cell data, in bytes.
+     *  Beyond that, the least recently used rows drop their data again, the
+     *  tree structure is kept. Defaults to the value of the GAMMARAY_MODEL_CACHE_SIZE
+     *  environment variable (in MiB), or 64 MiB.
+     */
+    qint64 cacheBudget() const;
+    void setCacheBudget(qint64 bytes);
+
 public slots:
     void newMessage(const GammaRay::Message &msg);
     void serverRegistered(const QString &objectName, Protocol::ObjectAddress objectAddress);
@@ -87,7 +119,13 @@ signals:
     void proxyFilterRegExpChanged();
 
 private:
-    struct Node { // represents one row
+    struct LruLink {
+        LruLink *lruPrev = nullptr;
+        LruLink *lruNext = nullptr;
+    };
+    struct DataCache;
+
+    struct Node : LruLink { // represents one row
         Node() = default;
         ~Node();
         Q_DISABLE_COPY(Node)
@@ -95,6 +133,8 @@ private:
         void clearChildrenData();
         // forget everything we know about our children, including row/column counts
         void clearChildrenStructure();
+        // delete the cached data of this row, keeping everything below it
+        void clearColumnData();
 
         // resize the initialize the column vectors
         void allocateColumns();
@@ -108,25 +148,73 @@ private:
         QVector<QHash<int, QVariant> > data; // column -> role -> data
         QVector<Qt::ItemFlags> flags;      // column -> flags
         QVector<RemoteModelNodeState::NodeStates> state;         // column -> state (cache outdated, waiting for data, etc)
+
+        // persistent handle assigned by the server, see Protocol::NodeHandleRow
+        qint32 handle = -1;
+        QHash<qint32, Node *> *handles = nullptr;
+
+        // set while this row holds cell data, see DataCache
+        DataCache *cache = nullptr;
+        qint64 cacheCost = 0; // estimated size of data, in bytes
+    };
+
+    /** Rows holding cell data, in a circular list ordered from least to most recently used. */
+    struct DataCache {
+        DataCache();
+        Q_DISABLE_COPY(DataCache)
+        void touch(Node *node);
+        void remove(Node *node);
+
+        LruLink list; // sentinel
+        qint64 size = 0;
+        qint64 budget;
+        quint64 hits = 0;
+        quint64 misses = 0;
+        quint64 evictions = 0;
     };
 
     void clear();
     void connectToServer();
 
+    typedef QHash<int, QVariant> ItemData;
+    /** Reads cell content as written by RemoteModelServer, calling @p updateCell for each cell. */
+    static void readContent(const Message &msg,
+                            const std::function<void(const Protocol::ModelIndex &, const ItemData &, qint32)> &updateCell);
+
     bool checkSyncBarrier(const Message &msg);
 
+    /** Applies row/column counts received for @p node, creating its children. */
+    void setRowColumnCount(Node *node, qint32 rowCount, qint32 columnCount, qint32 handle);
+    /** Emits dataChanged for @p indexesByParent, which are grouped by their parent. */
+    void emitDataChanged(const QHash<QModelIndex, QVector<QModelIndex> > &indexesByParent);
+
+    /** Stores cell content received from the server, updating the cache accounting. */
+    void setCellData(Node *node, int column, const ItemData &data, Qt::ItemFlags flags);
+    /** Drops cached data of the least recently used rows until we are within cacheBudget(). */
+    void evictCachedData();
+
     Node *nodeForIndex(const QModelIndex &index) const;
     Node *nodeForIndex(const Protocol::ModelIndex &index) const;
+    /** Converts @p index into its transport representation, making use of node handles. */
+    Protocol::ModelIndex fromQModelIndex(const QModelIndex &index) const;
+    void setNodeHandle(Node *node, qint32 handle);
     QModelIndex modelIndexForNode(GammaRay::RemoteModel::Node *node, int column) const;
 
     /** Checks if @p ancestor is a (grand)parent of @p child. */
     bool isAncestor(Node *ancestor, Node *child) const;
+    /** Forgets about subtree requests for anything below @p node, and @p node itself if
+     *  @p inclusive is set, call this before deleting those nodes.
+     */
+    void dropPendingSubtrees(Node *node, bool inclusive);
 
     RemoteModelNodeState::NodeStates stateForColumn(Node *node, int columnIndex) const;
 
     void requestRowColumnCount(const QModelIndex &index) const;
     void requestDataAndFlags(const QModelIndex &index) const;
     void requestHeaderData(Qt::Orientation orientation, int section) const;
+    /** Drops queued content requests outside of the viewports and prefetches the rows around them. */
+    void applyViewports() const;
+    void updateVisibleRegion();
     /// Reset the loading state for all rows at @p startRow or later.
     /// This is needed when rows have been added or removed before @p startRow, since
     /// pending replies might have a wrong index.
@@ -157,9 +245,12 @@ private:
 
 private slots:
     void doRequests() const;
+    void viewDestroyed(QObject *view);
+    void reportCacheStatistics();
 
 private:
     Node *m_root;
+    QHash<qint32, Node *> m_nodeHandles;
 
     mutable QVector<QHash<int, QVariant> > m_horizontalHeaders; // section -> role -> data
     mutable QVector<QHash<int, QVariant> > m_verticalHeaders; // section -> role -> data
@@ -171,15 +262,27 @@ private:
 
     mutable QMap<RequestType, QVector<Protocol::ModelIndex>> m_pendingRequests;
     QTimer *m_pendingRequestsTimer;
+    // roots of ModelSubtreeRequests without reply yet, by request id
+    QHash<qint32, Node *> m_pendingSubtrees;
+    qint32 m_subtreeRequestId;
+    enum { SubtreeNodeBudget = 5000 };
+
+    mutable DataCache m_cache;
+    QTimer *m_cacheStatisticsTimer;
 
     QString m_serverObject;
     Protocol::ObjectAddress m_myAddress;
 
+    QItemSelection m_visibleRegion;
+    QHash<QObject *, QItemSelection> m_viewports;
+    mutable bool m_viewportsChanged;
+
     qint32 m_currentSyncBarrier, m_targetSyncBarrier;
 
     // default data() values for empty cells
     static QVariant s_emptyDisplayValue;
     static QVariant s_emptySizeHintValue;
+    static qint64 s_defaultCacheBudget;
 
     // proxy model properties
     bool m_proxyDynamicSortFilter;
@@ -0,0 +1,74 @@
+/*
+  sharedmemoryclientdevice.cpp
+
+  This file is part of GammaRay, the Qt application inspection and
+  manipulation tool.
+
+  Copyright (C) 2019 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+
+  Licensees holding valid commercial KDAB GammaRay licenses may use this file in
+  accordance with GammaRay Commercial License Agreement provided with the Software.
+
+  Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sharedmemoryclientdevice.h"
+
+#include <common/sharedmemorydevice.h>
+
+#include <QSharedMemory>
+
+using namespace GammaRay;
+
+SharedMemoryClientDevice::SharedMemoryClientDevice(QObject *parent)
+    : LocalClientDevice(parent)
+    , m_device(nullptr)
+{
+    // we are only connected once we have the segment attached
+    disconnect(m_socket, &QLocalSocket::connected, this, &ClientDevice::connected);
+}
+
+void SharedMemoryClientDevice::connectToHost()
+{
+    delete m_device;
+    m_device = nullptr;
+    connect(m_socket, &QLocalSocket::readyRead, this, &SharedMemoryClientDevice::readHandshake,
+            Qt::UniqueConnection);
+    LocalClientDevice::connectToHost();
+}
+
+QIODevice *SharedMemoryClientDevice::device() const
+{
+    return m_device;
+}
+
+void SharedMemoryClientDevice::readHandshake()
+{
+    if (m_device || !m_socket->canReadLine())
+        return;
+
+    const QString key = QString::fromUtf8(m_socket->readLine()).trimmed();
+    QSharedMemory *segment = SharedMemoryDevice::attachSegment(key);
+    if (!segment) {
+        m_socket->disconnectFromServer();
+        emit persistentError(tr("Failed to attach to shared memory segment %1.").arg(key));
+        return;
+    }
+
+    disconnect(m_socket, &QLocalSocket::readyRead, this, &SharedMemoryClientDevice::readHandshake);
+    m_device = new SharedMemoryDevice(segment, m_socket, SharedMemoryDevice::ClientRole, this);
+    emit connected();
+}
@@ -30,6 +30,11 @@
 #include "message.h"
 #include "methodargument.h"
 #include "propertysyncer.h"
+#include "variantwrapper.h"
+
+#include <compat/qasconst.h>
+
+#include <QBuffer>
 
 #include <iostream>
 
@@ -40,12 +45,34 @@ Q_LOGGING_CATEGORY(networkstatistics, "gammaray.network.statistics", QtMsgType::
 using namespace GammaRay;
 using namespace std;
 
+// batches beyond this are flushed right away, this matches the largest
+// message size still benefiting from stream compression
+static const int maximumBatchSize = 16 * 1024;
+
+// connections with more data than this waiting to be written are considered
+// stuck and are closed, rather than having them hold up everyone else
+static const qint64 maximumPendingBytes = 256 * 1024 * 1024;
+
+// messages of at least this size are queued by priority and written in chunks of this size
+static const int chunkSize = 64 * 1024;
+// chunks are only written while the device has less than this waiting, so that messages
+// of a higher priority class never have to queue up behind more than that
+static const qint64 maximumBytesInFlight = 2 * chunkSize;
+
+// pending data beyond the high watermark raises backpressure, which is cleared again once
+// everything is written down to the low watermark
+static const qint64 backpressureHighWatermark = 4 * 1024 * 1024;
+static const qint64 backpressureLowWatermark = 1024 * 1024;
+// connections with more than this pending don't hold up the others by raising backpressure
+static const qint64 laggingConnectionBytes = 8 * backpressureHighWatermark;
+
 Endpoint *Endpoint::s_instance = nullptr;
 
 Endpoint::Endpoint(QObject *parent)
     : QObject(parent)
     , m_propertySyncer(new PropertySyncer(this))
-    , m_socket(nullptr)
+    , m_currentConnection(nullptr)
+    , m_backpressure(false)
     , m_myAddress(Protocol::InvalidObjectAddress +1)
     , m_bytesRead(0)
     , m_bytesWritten(0)
@@ -65,6 +92,11 @@ Endpoint::Endpoint(QObject *parent)
     // TODO: we could set this as message handler here and use the same dispatch mechanism
     insertObjectInfo(endpointObj);
 
+    m_messageBatchTimer = new QTimer(this);
+    m_messageBatchTimer->setSingleShot(true);
+    m_messageBatchTimer->setInterval(0);
+    connect(m_messageBatchTimer, &QTimer::timeout, this, static_cast<void (Endpoint::*)()>(&Endpoint::flushMessageBatch));
+
     m_bandwidthMeasurementTimer = new QTimer(this);
     connect(m_bandwidthMeasurementTimer, &QTimer::timeout, this, &Endpoint::doLogTransmissionRate);
     m_bandwidthMeasurementTimer->start(1000);
@@ -78,6 +110,7 @@ Endpoint::~Endpoint()
     for (auto it = m_addressMap.constBegin(); it != m_addressMap.constEnd(); ++it) {
         delete it.value();
     }
+    qDeleteAll(m_connections);
 
     s_instance = nullptr;
 }
@@ -93,6 +126,15 @@ void Endpoint::send(const Message &msg)
     s_instance->doSendMessage(msg);
 }
 
+void Endpoint::reply(const Message &msg)
+{
+    Q_ASSERT(s_instance);
+    if (s_instance->m_currentConnection)
+        s_instance->writeMessage(s_instance->m_currentConnection, msg);
+    else
+        s_instance->doSendMessage(msg);
+}
+
 void Endpoint::sendMessage(const Message &msg)
 {
     if (!isConnected())
@@ -104,18 +146,261 @@ void Endpoint::sendMessage(const Message &msg)
 void Endpoint::doSendMessage(const GammaRay::Message &msg)
 {
     Q_ASSERT(msg.address() != Protocol::InvalidObjectAddress);
-    msg.write(m_socket);
+    // the payload is serialized only once, and if compressed independently of the
+    // connection state that is also only done once, see Message::write()
+    // stream compression depends on the history of each connection though, so small
+    // messages are compressed once per connection with stream compression enabled
+    for (auto connection : qAsConst(m_connections))
+        sendToConnection(connection, msg);
+}
+
+void Endpoint::sendTo(QIODevice *device, const Message &msg)
+{
+    Q_ASSERT(msg.address() != Protocol::InvalidObjectAddress);
+    if (auto connection = connectionForDevice(device))
+        sendToConnection(connection, msg);
+}
+
+void Endpoint::sendToConnection(Connection *connection, const Message &msg)
+{
+    if (!connection->messagesDeferred) {
+        writeMessage(connection, msg);
+        return;
+    }
+    const auto frame = serializeMessage(msg);
+    connection->pendingFrameBytes += frame.data.size();
+    connection->deferredFrames.push_back(frame);
+    checkPendingBytes(connection);
+}
+
+void Endpoint::setMessagesDeferred(QIODevice *device, bool deferred)
+{
+    auto connection = connectionForDevice(device);
+    if (!connection || connection->messagesDeferred == deferred)
+        return;
+    connection->messagesDeferred = deferred;
+    if (deferred)
+        return;
+
+    // replies sent to this connection in the meantime go first
+    flushMessageBatch(connection);
+    for (const auto &frame : qAsConst(connection->deferredFrames)) {
+        connection->pendingFrameBytes -= frame.data.size();
+        enqueueFrame(connection, frame);
+    }
+    connection->deferredFrames.clear();
+    writePendingFrames(connection);
+    updateBackpressure();
+}
+
+void Endpoint::writeMessage(Connection *connection, const Message &msg)
+{
+    if (!connection->device)
+        return;
     m_bytesWritten += msg.size();
+
+    // only bulk messages may be overtaken, anything else sent after a queued message has
+    // to queue up behind it, as do bulk messages to the same object
+    const bool mustQueue = objectPriority(msg.address()) == Protocol::InteractivePriority
+            ? !connection->pendingFrames[Protocol::InteractivePriority].isEmpty()
+            : connection->pendingFramesPerObject.contains(msg.address());
+    if (msg.size() >= chunkSize || mustQueue) {
+        flushMessageBatch(connection);
+        enqueueFrame(connection, serializeMessage(msg));
+        writePendingFrames(connection);
+    } else if (connection->messageBatchingEnabled && msg.size() < maximumBatchSize) {
+        // collect everything sent during this event loop iteration
+        if (!connection->messageBatch) {
+            connection->messageBatch.reset(new Message(endpointAddress(), Protocol::MessageBatch));
+            if (!m_messageBatchTimer->isActive())
+                m_messageBatchTimer->start();
+        }
+        connection->messageBatch->append(msg);
+        if (connection->messageBatch->size() >= maximumBatchSize)
+            flushMessageBatch(connection);
+        return;
+    } else {
+        flushMessageBatch(connection);
+        msg.write(connection->device, connection->messageStream.get());
+    }
+
+    updateBackpressure();
+    checkPendingBytes(connection);
+}
+
+void Endpoint::checkPendingBytes(Connection *connection)
+{
+    const auto pending = pendingBytes(connection);
+    if (pending > maximumPendingBytes) {
+        cerr << "Connection is not keeping up with " << pending
+             << " bytes pending, closing it." << endl;
+        // we might be iterating over the connections right now
+        QPointer<QIODevice> device = connection->device;
+        QTimer::singleShot(0, this, [device]() {
+            if (device)
+                device->close();
+        });
+    }
+}
+
+void Endpoint::flushMessageBatch()
+{
+    m_messageBatchTimer->stop();
+    for (auto connection : qAsConst(m_connections))
+        flushMessageBatch(connection);
+}
+
+void Endpoint::flushMessageBatch(Connection *connection)
+{
+    if (!connection->messageBatch)
+        return;
+
+    std::unique_ptr<Message> batch;
+    std::swap(batch, connection->messageBatch);
+    if (connection->device)
+        batch->write(connection->device, connection->messageStream.get());
+}
+
+Protocol::MessagePriority Endpoint::objectPriority(Protocol::ObjectAddress objectAddress) const
+{
+    const auto it = m_addressMap.constFind(objectAddress);
+    return it != m_addressMap.constEnd() ? it.value()->priority : Protocol::InteractivePriority;
+}
+
+Endpoint::PendingFrame Endpoint::serializeMessage(const Message &msg) const
+{
+    PendingFrame frame;
+    frame.address = msg.address();
+    frame.priority = objectPriority(msg.address());
+
+    QBuffer buffer(&frame.data);
+    buffer.open(QIODevice::WriteOnly);
+    // this is written out of order relative to other objects, so it must not be part of the
+    // compression stream history, compression on its own is shared between connections though
+    msg.write(&buffer);
+    buffer.close();
+    return frame;
+}
+
+void Endpoint::enqueueFrame(Connection *connection, const PendingFrame &frame)
+{
+    connection->pendingFrameBytes += frame.data.size();
+    ++connection->pendingFramesPerObject[frame.address];
+    connection->pendingFrames[frame.priority].enqueue(frame);
+}
+
+void Endpoint::writePendingFrames(Connection *connection)
+{
+    while (connection->device && connection->device->bytesToWrite() < maximumBytesInFlight) {
+        int priority = 0;
+        while (priority < Protocol::MessagePriorityCount && connection->pendingFrames[priority].isEmpty())
+            ++priority;
+        if (priority == Protocol::MessagePriorityCount)
+            return;
+
+        auto &queue = connection->pendingFrames[priority];
+        auto &frame = queue.head();
+        const int size = qMin(chunkSize, frame.data.size() - frame.offset);
+        const bool last = frame.offset + size == frame.data.size();
+        if (frame.offset == 0 && last) {
+            connection->device->write(frame.data);
+        } else {
+            // chunks of the same priority class are never interleaved with each other,
+            // so the receiver needs one reassembly buffer per class only
+            Message chunk(endpointAddress(), Protocol::MessageChunk);
+            chunk << quint8(priority) << last
+                  << QByteArray::fromRawData(frame.data.constData() + frame.offset, size);
+            chunk.write(connection->device, connection->messageStream.get());
+        }
+        frame.offset += size;
+        connection->pendingFrameBytes -= size;
+
+        if (last) {
+            auto it = connection->pendingFramesPerObject.find(frame.address);
+            Q_ASSERT(it != connection->pendingFramesPerObject.end());
+            if (--it.value() == 0)
+                connection->pendingFramesPerObject.erase(it);
+            queue.dequeue();
+        }
+    }
+}
+
+qint64 Endpoint::pendingBytes(const Connection *connection) const
+{
+    return (connection->device ? connection->device->bytesToWrite() : 0) + connection->pendingFrameBytes;
+}
+
+void Endpoint::updateBackpressure()
+{
+    bool backpressure = false;
+    for (auto connection : qAsConst(m_connections)) {
+        const auto pending = pendingBytes(connection);
+        connection->backpressure = pending > (connection->backpressure ? backpressureLowWatermark : backpressureHighWatermark);
+        // a single slow client must not starve all the others, and connections not receiving
+        // messages yet don't drain anything we could hold back
+        if (connection->backpressure && pending <= laggingConnectionBytes && !connection->messagesDeferred)
+            backpressure = true;
+    }
+
+    if (backpressure == m_backpressure)
+        return;
+    m_backpressure = backpressure;
+    emit backpressureChanged(m_backpressure);
+}
+
+bool Endpoint::hasBackpressure()
+{
+    return s_instance && s_instance->m_backpressure;
+}
+
+void Endpoint::deviceBytesWritten()
+{
+    auto connection = connectionForDevice(sender());
+    if (!connection)
+        return;
+    writePendingFrames(connection);
+    updateBackpressure();
+}
+
+void Endpoint::setObjectPriority(Protocol::ObjectAddress objectAddress, Protocol::MessagePriority priority)
+{
+    Q_ASSERT(m_addressMap.contains(objectAddress));
+    if (auto obj = m_addressMap.value(objectAddress))
+        obj->priority = priority;
+}
+
+void Endpoint::setMessageBatchingEnabled(bool enabled)
+{
+    Q_ASSERT(m_currentConnection);
+    if (!m_currentConnection)
+        return;
+    if (!enabled)
+        flushMessageBatch(m_currentConnection);
+    m_currentConnection->messageBatchingEnabled = enabled;
+}
+
+void Endpoint::setStreamCompressionEnabled(bool enabled)
+{
+    Q_ASSERT(m_currentConnection);
+    if (m_currentConnection)
+        m_currentConnection->messageStream->setCompressionEnabled(enabled);
 }
 
 void Endpoint::waitForMessagesWritten()
 {
-    m_socket->waitForBytesWritten(-1);
+    flushMessageBatch();
+    for (auto connection : qAsConst(m_connections)) {
+        while (connection->device) {
+            writePendingFrames(connection);
+            if (!connection->device->waitForBytesWritten(-1))
+                break;
+        }
+    }
 }
 
 bool Endpoint::isConnected()
 {
-    return s_instance && s_instance->m_socket;
+    return s_instance && !s_instance->m_connections.isEmpty();
 }
 
 quint16 Endpoint::defaultPort()
@@ -137,23 +422,62 @@ void Endpoint::doLogTransmissionRate()
             const float transmissionRateRX = (m_bytesRead * 8 / 1024.0 / 1024.0); // in Mpbs
             const float transmissionRateTX = (m_bytesWritten * 8 / 1024.0 / 1024.0); // in Mpbs
             qCWarning(networkstatistics, "RX %7.3f Mbps | TX %7.3f Mbps", transmissionRateRX, transmissionRateTX);
+
+            // ratio of bytes on the wire compared to the uncompressed payload size
+            const auto ratio = [](quint64 compressed, quint64 uncompressed) {
+                return uncompressed ? compressed * 100.0 / uncompressed : 100.0;
+            };
+            for (auto connection : qAsConst(m_connections)) {
+                const auto stream = connection->messageStream.get();
+                qCWarning(networkstatistics, "RX compression %5.1f%% | TX compression %5.1f%% (stream compression %s)",
+                          ratio(stream->bytesRead(), stream->uncompressedBytesRead()),
+                          ratio(stream->bytesWritten(), stream->uncompressedBytesWritten()),
+                          stream->isCompressionEnabled() ? "on" : "off");
+            }
         }
     }
     m_bytesRead = 0;
     m_bytesWritten = 0;
+    for (auto connection : qAsConst(m_connections))
+        connection->messageStream->resetStatistics();
 }
 
 void Endpoint::setDevice(QIODevice *device)
 {
-    Q_ASSERT(!m_socket);
+    Q_ASSERT(!isConnected());
+    addDevice(device);
+}
+
+void Endpoint::addDevice(QIODevice *device)
+{
     Q_ASSERT(device);
-    m_socket = device;
-    connect(m_socket.data(), &QIODevice::readyRead, this, &Endpoint::readyRead);
-    // FIXME Use proper type for m_socket, instead of relying on runtime-connect
+    Q_ASSERT(!connectionForDevice(device));
+    auto connection = new Connection;
+    connection->device = device;
+    connection->messageStream.reset(new MessageStream);
+    m_connections.push_back(connection);
+
+    connect(device, &QIODevice::readyRead, this, &Endpoint::readyRead);
+    connect(device, &QIODevice::bytesWritten, this, &Endpoint::deviceBytesWritten);
+    // FIXME Use proper type for the device, instead of relying on runtime-connect
     // to a slot which doesn't exist in QIODevice
-    connect(m_socket.data(), SIGNAL(disconnected()), SLOT(connectionClosed()));
-    if (m_socket->bytesAvailable())
-        readyRead();
+    connect(device, SIGNAL(disconnected()), SLOT(connectionClosed()));
+    if (device->bytesAvailable())
+        readMessages(device);
+}
+
+QIODevice *Endpoint::currentDevice() const
+{
+    return m_currentConnection ? m_currentConnection->device.data() : nullptr;
+}
+
+Endpoint::Connection *Endpoint::connectionForDevice(const QObject *device) const
+{
+    for (auto connection : m_connections) {
+        if (connection->device == device)
+            return connection;
+    }
+    return nullptr;
 }
 
 Protocol::ObjectAddress Endpoint::endpointAddress() const
@@ -163,8 +487,55 @@ Protocol::ObjectAddress Endpoint::endpointAddress() const
 
 void Endpoint::readyRead()
 {
-    while (Message::canReadMessage(m_socket.data())) {
-        const auto msg = Message::readMessage(m_socket.data());
+    readMessages(qobject_cast<QIODevice *>(sender()));
+}
+
+void Endpoint::readMessages(QIODevice *d)
+{
+    QPointer<QIODevice> device(d);
+    Connection * const previousConnection = m_currentConnection;
+    // the connection might get closed while handling any of its messages
+    while (auto connection = connectionForDevice(device)) {
+        if (!device || !Message::canReadMessage(device))
+            break;
+        const auto msg = Message::readMessage(device, connection->messageStream.get());
+        m_currentConnection = connection;
+        if (msg.address() == endpointAddress() && msg.type() == Protocol::MessageChunk) {
+            quint8 priority;
+            bool last;
+            QByteArray chunk;
+            msg >> priority >> last >> chunk;
+            if (priority < Protocol::MessagePriorityCount) {
+                connection->incomingChunks[priority] += chunk;
+                if (last) {
+                    QByteArray frame;
+                    std::swap(frame, connection->incomingChunks[priority]);
+                    QBuffer buffer(&frame);
+                    buffer.open(QIODevice::ReadOnly);
+                    if (Message::canReadMessage(&buffer))
+                        handleMessage(connection, Message::readMessage(&buffer));
+                    else
+                        cerr << "Received incomplete chunked message of " << frame.size() << " bytes." << endl;
+                }
+            } else {
+                cerr << "Received message chunk of unknown priority class " << int(priority) << endl;
+            }
+        } else {
+            handleMessage(connection, msg);
+        }
+        m_currentConnection = m_connections.contains(previousConnection) ? previousConnection : nullptr;
+    }
+}
+
+void Endpoint::handleMessage(Connection *connection, const Message &msg)
+{
+    if (msg.address() == endpointAddress() && msg.type() == Protocol::MessageBatch) {
+        while (msg.canReadAppendedMessage() && m_currentConnection == connection) {
+            const auto batchedMsg = msg.readAppendedMessage();
+            m_bytesRead += batchedMsg.size();
+            messageReceived(batchedMsg);
+        }
+    } else {
         m_bytesRead += msg.size();
         messageReceived(msg);
     }
@@ -172,10 +543,30 @@ void Endpoint::readyRead()
 
 void Endpoint::connectionClosed()
 {
-    disconnect(m_socket.data(), &QIODevice::readyRead, this, &Endpoint::readyRead);
-    disconnect(m_socket.data(), SIGNAL(disconnected()), this, SLOT(connectionClosed()));
-    m_socket = nullptr;
-    emit disconnected();
+    auto device = qobject_cast<QIODevice *>(sender());
+    auto connection = connectionForDevice(device);
+    if (!connection)
+        return;
+
+    disconnect(device, &QIODevice::readyRead, this, &Endpoint::readyRead);
+    disconnect(device, &QIODevice::bytesWritten, this, &Endpoint::deviceBytesWritten);
+    disconnect(device, SIGNAL(disconnected()), this, SLOT(connectionClosed()));
+    m_connections.removeOne(connection);
+    if (m_currentConnection == connection)
+        m_currentConnection = nullptr;
+    delete connection;
+
+    deviceDisconnected(device);
+    updateBackpressure();
+    if (m_connections.isEmpty()) {
+        m_messageBatchTimer->stop();
+        emit disconnected();
+    }
+}
+
+void Endpoint::deviceDisconnected(QIODevice *device)
+{
+    Q_UNUSED(device);
 }
 
 Protocol::ObjectAddress Endpoint::objectAddress(const QString &objectName) const
@@ -224,11 +615,24 @@ void Endpoint::invokeObject(const QString &objectName, const char *method,
         return;
 #endif
 
-    Message msg(obj->address, Protocol::MethodCall);
     const QByteArray name(method);
     Q_ASSERT(!name.isEmpty());
-    msg << name << args;
-    send(msg);
+    for (auto connection : qAsConst(m_connections)) {
+        // the method name is only sent along with the first call on each connection,
+        // after that the other side knows it by the id we assigned to it
+        Message msg(obj->address, Protocol::MethodCall);
+        auto &methodIds = connection->outgoingMethodIds[obj->address];
+        auto it = methodIds.constFind(name);
+        if (it == methodIds.constEnd()) {
+            const quint16 methodId = methodIds.size() + 1;
+            methodIds.insert(name, methodId);
+            msg << methodId << name;
+        } else {
+            msg << it.value();
+        }
+        msg << args;
+        s_instance->sendToConnection(connection, msg);
+    }
 }
 
 void Endpoint::invokeObjectLocal(QObject *object, const char *method,
@@ -244,6 +648,44 @@ void Endpoint::invokeObjectLocal(QObject *object, const char *method,
                               a[9]);
 }
 
+void Endpoint::invokeObjectLocal(QObject *object, Endpoint::InternedMethod &method,
+                                 const QVariantList &args) const
+{
+    Q_ASSERT(args.size() <= 10);
+    QVector<int> argumentTypes;
+    argumentTypes.reserve(args.size());
+    for (const auto &arg : args)
+        argumentTypes.push_back(arg.userType());
+
+    if (!method.method.isValid() || method.argumentTypes != argumentTypes) {
+        // same lookup as QMetaObject::invokeMethod() does, but only once per argument type combination
+        QByteArray signature = method.name + '(';
+        for (int i = 0; i < args.size(); ++i) {
+            if (i)
+                signature += ',';
+            if (argumentTypes.at(i) == qMetaTypeId<VariantWrapper>())
+                signature += "QVariant";
+            else
+                signature += args.at(i).typeName();
+        }
+        signature += ')';
+
+        const int index = object->metaObject()->indexOfMethod(QMetaObject::normalizedSignature(signature.constData()));
+        if (index < 0) {
+            // let Qt produce the usual diagnostics
+            invokeObjectLocal(object, method.name.constData(), args);
+            return;
+        }
+        method.method = object->metaObject()->method(index);
+        method.argumentTypes = argumentTypes;
+    }
+
+    QVector<MethodArgument> a(10);
+    for (int i = 0; i < args.size(); ++i)
+        a[i] = MethodArgument(args.at(i));
+    method.method.invoke(object, a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9]);
+}
+
 void Endpoint::addObjectNameAddressMapping(const QString &objectName,
                                            Protocol::ObjectAddress objectAddress)
 {
@@ -341,16 +783,33 @@ void Endpoint::dispatchMessage(const Message &msg)
 
     ObjectInfo *obj = it.value();
     if (msg.type() == Protocol::MethodCall) {
-        QByteArray method;
-        msg >> method;
+        if (!m_currentConnection) {
+            cerr << "cannot call method on object of name " << qPrintable(obj->name)
+                 << " outside of the connection it was received on" << endl;
+            return;
+        }
+        auto &incomingMethods = m_currentConnection->incomingMethods[obj->address];
+        quint16 methodId;
+        msg >> methodId;
+        if (methodId == incomingMethods.size() + 1) {
+            InternedMethod method;
+            msg >> method.name;
+            incomingMethods.push_back(method);
+        } else if (methodId == 0 || methodId > incomingMethods.size()) {
+            cerr << "cannot call unknown method id " << methodId << " on object of name "
+                 << qPrintable(obj->name) << " with address " << quint64(obj->address) << endl;
+            return;
+        }
+
+        auto &method = incomingMethods[methodId - 1];
         if (obj->object) {
-            Q_ASSERT(!method.isEmpty());
+            Q_ASSERT(!method.name.isEmpty());
             QVariantList args;
             msg >> args;
 
-            invokeObjectLocal(obj->object, method.constData(), args);
+            invokeObjectLocal(obj->object, method, args);
         } else {
-            cerr << "cannot call method " << method.constData() << " on unknown object of name "
+            cerr << "cannot call method " << method.name.constData() << " on unknown object of name "
                  << qPrintable(obj->name) << " with address " << quint64(obj->address)
                  << " - did you forget to register it?" << endl;
         }
@@ -394,6 +853,10 @@ void Endpoint::removeObjectInfo(Endpoint::ObjectInfo *oi)
 {
     Q_ASSERT(m_addressMap.contains(oi->address));
     m_addressMap.remove(oi->address);
+    for (auto connection : qAsConst(m_connections)) {
+        connection->outgoingMethodIds.remove(oi->address);
+        connection->incomingMethods.remove(oi->address);
+    }
     Q_ASSERT(m_nameMap.contains(oi->name));
     m_nameMap.remove(oi->name);
 
@@ -35,8 +35,11 @@
 #include <QMetaMethod>
 #include <QObject>
 #include <QPointer>
+#include <QQueue>
 #include <QTimer>
 
+#include <memory>
+
 #include <QLoggingCategory>
 Q_DECLARE_LOGGING_CATEGORY(networkstatistics)
 
@@ -47,6 +50,7 @@ QT_END_NAMESPACE
 
 namespace GammaRay {
 class Message;
+class MessageStream;
 class PropertySyncer;
 
 /*! Network protocol endpoint.
@@ -61,12 +65,26 @@ class GAMMARAY_COMMON_EXPORT Endpoint : public QObject
 public:
     ~Endpoint() override;
 
-    /*! Send @p msg to the connected endpoint. */
+    /*! Send @p msg to all connected endpoints. */
     static void send(const Message &msg);
 
+    /*! Send @p msg only to the endpoint that sent the message currently being handled.
+     *  Outside of message handling this is the same as send().
+     */
+    static void reply(const Message &msg);
+
     /*! Returns @c true if we are currently connected to another endpoint. */
     static bool isConnected();
 
+    /*! Returns @c true while more data than is healthy is waiting to be written on any
+     *  of the connections. Producers of large or frequent messages should skip or coalesce
+     *  work until this is cleared again.
+     *  Connections lagging far behind all others are not waited for, those either catch up
+     *  or get closed eventually.
+     *  @see backpressureChanged()
+     */
+    static bool hasBackpressure();
+
     static quint16 defaultPort();
     static quint16 broadcastPort();
 
@@ -150,6 +168,14 @@ public:
     /*! Unregister the message handler for @p objectAddress. */
     virtual void unregisterMessageHandler(Protocol::ObjectAddress objectAddress);
 
+    /*! Sets the priority class of messages sent to @p objectAddress, InteractivePriority by default.
+     *  Large messages are split into chunks. Messages of the interactive class stay in order
+     *  with each other and can overtake messages of the bulk class, messages to the same
+     *  object always stay in order.
+     *  Set this before sending anything to that object.
+     */
+    void setObjectPriority(Protocol::ObjectAddress objectAddress, Protocol::MessagePriority priority);
+
 public slots:
     /*! Convenience overload of send(), to directly send message delivered via signals. */
     void sendMessage(const GammaRay::Message &msg);
@@ -157,7 +183,7 @@ public slots:
 signals:
     /*! Emitted when a connection to another endpoint was successfully established and passed the protocol version handshake step. */
     void connectionEstablished();
-    /*! Emitted when we lost the connection to the other endpoint. */
+    /*! Emitted when we lost the connection to the last other endpoint. */
     void disconnected();
 
     /*! Emitted when a new object with name @p objectName has been registered at address @p objectAddress. */
@@ -166,11 +192,31 @@ signals:
 
     void logTransmissionRate(quint64 bytesRead, quint64 bytesWritten);
 
+    /*! Emitted when hasBackpressure() changes. */
+    void backpressureChanged(bool backpressure);
+
 protected:
     ///@cond internal
     Endpoint(QObject *parent = nullptr);
     /*! Call with the socket once you have established a connection to another endpoint, takes ownership of @p device. */
     void setDevice(QIODevice *device);
+    /*! Like setDevice(), but for endpoints supporting more than one connection at a time.
+     *  Messages sent via send() are delivered to all of them.
+     */
+    void addDevice(QIODevice *device);
+
+    /*! The device the message currently being handled was received on,
+     *  @c nullptr outside of message handling.
+     */
+    QIODevice *currentDevice() const;
+    /*! Sends @p msg only to the endpoint connected via @p device. */
+    void sendTo(QIODevice *device, const Message &msg);
+    /*! Holds back messages sent via send() or sendTo() to the endpoint connected via @p device
+     *  while @p deferred is set, and delivers them in order once it is cleared again.
+     *  Replies are still written immediately.
+     *  Use this while the other side can't decode messages of the current data version yet.
+     */
+    void setMessagesDeferred(QIODevice *device, bool deferred);
 
     /*! The object address of the other endpoint. */
     Protocol::ObjectAddress endpointAddress() const;
@@ -194,12 +240,29 @@ protected:
     virtual void objectDestroyed(Protocol::ObjectAddress objectAddress, const QString &objectName,
                                  QObject *object) = 0;
 
+    /*! Called when the connection via @p device has been closed, before disconnected()
+     *  is emitted in case this was the last one.
+     */
+    virtual void deviceDisconnected(QIODevice *device);
+
     /*! Calls the message handler registered for the receiver of @p msg. */
     void dispatchMessage(const GammaRay::Message &msg);
 
     /*! Sends a given message. */
     virtual void doSendMessage(const Message &msg);
 
+    /*! Enables LZ4 stream compression for outgoing messages of the connection the message
+     *  currently being handled was received on.
+     *  Only call this once the other side agreed to it during the data version negotiation.
+     */
+    void setStreamCompressionEnabled(bool enabled);
+
+    /*! Enables collecting outgoing messages of one event loop iteration into a single
+     *  batch message for the connection the message currently being handled was received on.
+     *  Only call this once the other side passed the protocol version check.
+     */
+    void setMessageBatchingEnabled(bool enabled);
+
     /*! All current object name/address pairs. */
     QVector<QPair<Protocol::ObjectAddress, QString> > objectAddresses() const;
 
@@ -218,12 +281,23 @@ protected:
 
 private slots:
     void readyRead();
+    void deviceBytesWritten();
+    void flushMessageBatch();
     void doLogTransmissionRate();
     void connectionClosed();
     void slotHandlerDestroyed(QObject *obj);
     void slotObjectDestroyed(QObject *obj);
 
 private:
+    /*! A method name interned for MethodCall messages, see invokeObject(). */
+    struct InternedMethod
+    {
+        QByteArray name;
+        // resolved on first use, for the argument types it was resolved for
+        QMetaMethod method;
+        QVector<int> argumentTypes;
+    };
+
     struct ObjectInfo
     {
         ObjectInfo()
@@ -233,6 +307,7 @@ private:
 
         QString name;
         Protocol::ObjectAddress address;
+        Protocol::MessagePriority priority = Protocol::InteractivePriority;
         // the locally registered object
         QObject *object = nullptr;
 
@@ -241,17 +316,75 @@ private:
         QMetaMethod messageHandler;
     };
 
+    /*! A serialized message waiting to be written, possibly in multiple chunks. */
+    struct PendingFrame
+    {
+        QByteArray data;
+        int offset = 0;
+        Protocol::ObjectAddress address = Protocol::InvalidObjectAddress;
+        Protocol::MessagePriority priority = Protocol::InteractivePriority;
+    };
+
+    struct Connection
+    {
+        QPointer<QIODevice> device;
+        std::unique_ptr<MessageStream> messageStream;
+        std::unique_ptr<Message> messageBatch;
+        bool messageBatchingEnabled = false;
+
+        // method ids assigned by us for calls to remote objects
+        QHash<Protocol::ObjectAddress, QHash<QByteArray, quint16> > outgoingMethodIds;
+        // method ids assigned by the other side, indexed by id - 1
+        QHash<Protocol::ObjectAddress, QVector<InternedMethod> > incomingMethods;
+
+        // large messages, and everything that must not overtake them, per priority class
+        QQueue<PendingFrame> pendingFrames[Protocol::MessagePriorityCount];
+        QHash<Protocol::ObjectAddress, int> pendingFramesPerObject;
+        qint64 pendingFrameBytes = 0;
+        // partially received chunked messages, per priority class
+        QByteArray incomingChunks[Protocol::MessagePriorityCount];
+
+        // messages sent via send() or sendTo() held back until the other side is ready for them
+        QVector<PendingFrame> deferredFrames;
+        bool messagesDeferred = false;
+        bool backpressure = false;
+    };
+
     /*! Inserts @p oi into all maps. */
     void insertObjectInfo(ObjectInfo *oi);
     /*! Removes @p oi from all maps and destroys it. */
     void removeObjectInfo(ObjectInfo *oi);
 
+    /*! Invokes the interned @p method on @p object, resolving it if necessary. */
+    void invokeObjectLocal(QObject *object, InternedMethod &method, const QVariantList &args) const;
+
+    Connection *connectionForDevice(const QObject *device) const;
+    void readMessages(QIODevice *device);
+    void handleMessage(Connection *connection, const Message &msg);
+    /*! Writes @p msg to @p connection, or holds it back while messages to it are deferred. */
+    void sendToConnection(Connection *connection, const Message &msg);
+    void writeMessage(Connection *connection, const Message &msg);
+    void flushMessageBatch(Connection *connection);
+    Protocol::MessagePriority objectPriority(Protocol::ObjectAddress objectAddress) const;
+    PendingFrame serializeMessage(const Message &msg) const;
+    void enqueueFrame(Connection *connection, const PendingFrame &frame);
+    void writePendingFrames(Connection *connection);
+    /*! Bytes not yet written to @p connection, including the queued and deferred ones. */
+    qint64 pendingBytes(const Connection *connection) const;
+    /*! Closes @p connection if it fell too far behind. */
+    void checkPendingBytes(Connection *connection);
+    void updateBackpressure();
+
     QHash<QString, ObjectInfo *> m_nameMap;
     QHash<Protocol::ObjectAddress, ObjectInfo *> m_addressMap;
     QHash<QObject *, ObjectInfo *> m_objectMap;
     QMultiHash<QObject *, ObjectInfo *> m_handlerMap;
 
-    QPointer<QIODevice> m_socket;
+    QVector<Connection *> m_connections;
+    // the connection the message currently being handled was received on
+    Connection *m_currentConnection;
+    QTimer *m_messageBatchTimer;
+    bool m_backpressure;
     Protocol::ObjectAddress m_myAddress;
     quint64 m_bytesRead;
     quint64 m_bytesWritten;
@@ -35,48 +35,64 @@
 #include <QDebug>
 #include <qendian.h>
 
-inline void compress(const QByteArray &src, QByteArray &dst)
-{
-    const qint32 srcSz = src.size();
+#include <cstring>
+
+static const int headerSize = sizeof(GammaRay::Protocol::PayloadSize)
+                              + sizeof(GammaRay::Protocol::ObjectAddress)
+                              + sizeof(GammaRay::Protocol::MessageType);
 
-    dst.resize(LZ4_compressBound(srcSz + sizeof(srcSz)));
-    *(qint32 *)dst.data() = srcSz; // save the source size
+// compresses @p srcSz bytes into @p dst starting at @p offset, returns the compressed size
+// including the leading uncompressed size field, or 0 on failure
+static int compress(const char *src, qint32 srcSz, QByteArray &dst, int offset)
+{
+    const int bound = LZ4_compressBound(srcSz);
+    dst.resize(offset + sizeof(srcSz) + bound);
+    memcpy(dst.data() + offset, &srcSz, sizeof(srcSz)); // save the source size
 
-    const int sz
-        = LZ4_compress_default(src.constData(), dst.data() + sizeof(int), srcSz, dst.size());
-    dst.resize(sz + sizeof(srcSz));
+    const int sz = LZ4_compress_default(src, dst.data() + offset + sizeof(srcSz), srcSz, bound);
+    if (sz <= 0)
+        return 0;
+    dst.resize(offset + sizeof(srcSz) + sz);
+    return sz + sizeof(srcSz);
 }
 
-inline void uncompress(const QByteArray &src, QByteArray &dst)
+// decompresses @p srcSz bytes from @p src into @p dst starting at @p offset
+static void uncompress(const char *src, int srcSz, QByteArray &dst, int offset)
 {
-    const qint32 dstSz = *(const qint32 *)src.constData(); // get the dest size
-    dst.resize(dstSz);
-    const int sz = LZ4_decompress_safe(src.constData() + sizeof(dstSz), dst.data(),
-                                       src.size()- sizeof(dstSz), dstSz);
-    if (sz <= 0)
-        dst.resize(0);
-    else
-        dst.resize(sz);
+    qint32 dstSz = 0;
+    if (srcSz >= (int)sizeof(dstSz))
+        memcpy(&dstSz, src, sizeof(dstSz)); // get the dest size
+    if (dstSz <= 0) {
+        dst.resize(offset);
+        return;
+    }
+
+    dst.resize(offset + dstSz);
+    const int sz = LZ4_decompress_safe(src + sizeof(dstSz), dst.data() + offset,
+                                       srcSz - sizeof(dstSz), dstSz);
+    dst.resize(offset + qMax(sz, 0));
 }
 
+// stream compression keeps identical ring buffers on both sides, blocks are placed at
+// the same offsets as long as both sides apply the same wrap-around rule
+static const int streamBlockMaxSize = 16 * 1024;
+static const int streamRingBufferSize = 64 * 1024 + streamBlockMaxSize;
+
 static quint8 s_streamVersion = GammaRay::Message::lowestSupportedDataVersion();
+static quint32 s_features = GammaRay::Protocol::NoFeatures;
 static const int minimumUncompressedSize = 32;
 
-template<typename T> static T readNumber(QIODevice *device)
+template<typename T> static void writeNumber(char *&dst, T value)
 {
-    T buffer;
-    const int readSize = device->read((char *)&buffer, sizeof(T));
-    Q_UNUSED(readSize);
-    Q_ASSERT(readSize == sizeof(T));
-    return qFromBigEndian(buffer);
+    qToBigEndian(value, reinterpret_cast<uchar *>(dst));
+    dst += sizeof(T);
 }
 
-template<typename T> static void writeNumber(QIODevice *device, T value)
+template<typename T> static T readNumber(const char *&src)
 {
-    value = qToBigEndian(value);
-    const int writeSize = device->write((char *)&value, sizeof(T));
-    Q_UNUSED(writeSize);
-    Q_ASSERT(writeSize == sizeof(T));
+    const T value = qFromBigEndian<T>(reinterpret_cast<const uchar *>(src));
+    src += sizeof(T);
+    return value;
 }
 
 using namespace GammaRay;
@@ -85,35 +101,120 @@ class MessageBuffer
 {
 public:
     MessageBuffer()
-        : stream(&data)
+        : standaloneCompressedSize(0)
+        , stream(&data)
     {
         data.open(QIODevice::ReadWrite);
 
         // explicitly reserve memory so a resize() won't shed it
-        data.buffer().reserve(32);
-        scratchSpace.reserve(32);
+        data.buffer().reserve(headerSize + 32);
+        scratchSpace.reserve(headerSize + 32);
     }
 
     ~MessageBuffer() = default;
 
     void clear()
     {
-        data.buffer().resize(0);
+        data.buffer().resize(headerSize);
         resetStatus();
     }
 
     void resetStatus()
     {
-        data.seek(0);
+        data.seek(headerSize);
         scratchSpace.resize(0);
+        standaloneCompressedSize = 0;
         stream.resetStatus();
     }
 
+    // the wire frame, the header is filled in right before sending so that
+    // header and payload go out in a single write
     QBuffer data;
+    // compressed frame, or the compressed frame as received
     QByteArray scratchSpace;
+    // payload size of scratchSpace if it holds the frame compressed independently of any
+    // stream, so writing the same message to multiple devices compresses it only once;
+    // 0 if not compressed yet, -1 if it doesn't compress
+    int standaloneCompressedSize;
     QDataStream stream;
 };
 
+namespace GammaRay {
+class MessageStreamPrivate
+{
+public:
+    MessageStreamPrivate()
+        : compressionEnabled(false)
+        , encoderPos(0)
+        , decoderPos(0)
+        , uncompressedBytesWritten(0)
+        , bytesWritten(0)
+        , uncompressedBytesRead(0)
+        , bytesRead(0)
+    {
+        LZ4_resetStream(&encoder);
+        LZ4_setStreamDecode(&decoder, nullptr, 0);
+    }
+
+    // returns the ring buffer offset for the next block of @p size bytes
+    static int nextBlockOffset(int &pos, int size)
+    {
+        if (pos + size > streamRingBufferSize)
+            pos = 0;
+        const int offset = pos;
+        pos += size;
+        return offset;
+    }
+
+    // compresses @p srcSz bytes into @p dst starting at @p offset, same format as compress()
+    // except for the negated source size, which marks blocks depending on the stream history
+    int compress(const char *src, qint32 srcSz, QByteArray &dst, int offset)
+    {
+        encoderRing.resize(streamRingBufferSize);
+        char *block = encoderRing.data() + nextBlockOffset(encoderPos, srcSz);
+        memcpy(block, src, srcSz);
+
+        const int bound = LZ4_compressBound(srcSz);
+        dst.resize(offset + sizeof(srcSz) + bound);
+        const qint32 marker = -srcSz;
+        memcpy(dst.data() + offset, &marker, sizeof(marker));
+
+        const int sz = LZ4_compress_fast_continue(&encoder, block, dst.data() + offset + sizeof(srcSz), srcSz, bound, 1);
+        Q_ASSERT(sz > 0); // can't fail with a large enough output buffer
+        dst.resize(offset + sizeof(srcSz) + sz);
+        return sz + sizeof(srcSz);
+    }
+
+    void uncompress(const char *src, int srcSz, qint32 dstSz, QByteArray &dst, int offset)
+    {
+        if (dstSz > streamBlockMaxSize) {
+            dst.resize(offset);
+            return;
+        }
+
+        decoderRing.resize(streamRingBufferSize);
+        char *block = decoderRing.data() + nextBlockOffset(decoderPos, dstSz);
+        const int sz = LZ4_decompress_safe_continue(&decoder, src, block, srcSz, dstSz);
+        dst.resize(offset + qMax(sz, 0));
+        if (sz > 0)
+            memcpy(dst.data() + offset, block, sz);
+    }
+
+    LZ4_stream_t encoder;
+    LZ4_streamDecode_t decoder;
+    QByteArray encoderRing;
+    QByteArray decoderRing;
+    bool compressionEnabled;
+    int encoderPos;
+    int decoderPos;
+
+    quint64 uncompressedBytesWritten;
+    quint64 bytesWritten;
+    quint64 uncompressedBytesRead;
+    quint64 bytesRead;
+};
+}
+
 Q_GLOBAL_STATIC_WITH_ARGS(SharedPool<MessageBuffer>, s_sharedMessageBufferPool, (5))
 
 Message::Message()
@@ -155,6 +256,8 @@ Protocol::MessageType Message::type() const
 
 QDataStream &Message::payload() const
 {
+    // we might be about to change the payload
+    m_buffer->standaloneCompressedSize = 0;
     return m_buffer->stream;
 }
 
@@ -180,30 +283,53 @@ bool Message::canReadMessage(QIODevice *device)
     return device->bytesAvailable() >= payloadSize + minimumSize;
 }
 
-Message Message::readMessage(QIODevice *device)
+Message Message::readMessage(QIODevice *device, MessageStream *stream)
 {
     Message msg;
 
-    Protocol::PayloadSize payloadSize = readNumber<qint32>(device);
+    Protocol::PayloadSize payloadSize;
+    device->peek((char *)&payloadSize, sizeof(payloadSize));
+    payloadSize = qFromBigEndian(payloadSize);
+
+    // read the entire frame with a single call, either directly into the payload buffer
+    // or, when compressed, into the scratch space which is then decompressed in place
+    const bool isCompressed = payloadSize < 0;
+    QByteArray &frame = isCompressed ? msg.m_buffer->scratchSpace : msg.m_buffer->data.buffer();
+    frame.resize(headerSize + abs(payloadSize));
+    const qint64 readSize = device->read(frame.data(), frame.size());
+    Q_UNUSED(readSize);
+    Q_ASSERT(readSize == frame.size());
 
-    msg.m_objectAddress = readNumber<Protocol::ObjectAddress>(device);
-    msg.m_messageType = readNumber<Protocol::MessageType>(device);
+    const char *header = frame.constData() + sizeof(Protocol::PayloadSize);
+    msg.m_objectAddress = readNumber<Protocol::ObjectAddress>(header);
+    msg.m_messageType = readNumber<Protocol::MessageType>(header);
     Q_ASSERT(msg.m_messageType != Protocol::InvalidMessageType);
     Q_ASSERT(msg.m_objectAddress != Protocol::InvalidObjectAddress);
-    if (payloadSize < 0) {
-        payloadSize = abs(payloadSize);
-        auto& uncompressedData = msg.m_buffer->scratchSpace;
-        uncompressedData.resize(payloadSize);
-        device->read(uncompressedData.data(), payloadSize);
-        uncompress(uncompressedData, msg.m_buffer->data.buffer());
-        Q_ASSERT(payloadSize == uncompressedData.size());
-    } else {
-        if (payloadSize > 0) {
-            msg.m_buffer->data.buffer() = device->read(payloadSize);
-            Q_ASSERT(payloadSize == msg.m_buffer->data.size());
+
+    if (isCompressed) {
+        const char *src = frame.constData() + headerSize;
+        const int srcSz = frame.size() - headerSize;
+        qint32 dstSz = 0;
+        if (srcSz >= (int)sizeof(dstSz))
+            memcpy(&dstSz, src, sizeof(dstSz));
+        if (dstSz < 0) { // stream compressed
+            if (stream) {
+                stream->d->uncompress(src + sizeof(dstSz), srcSz - sizeof(dstSz), -dstSz,
+                                      msg.m_buffer->data.buffer(), headerSize);
+            } else {
+                qWarning("%s: Received stream compressed message without a stream", Q_FUNC_INFO);
+                msg.m_buffer->data.buffer().resize(headerSize);
+            }
+        } else {
+            uncompress(src, srcSz, msg.m_buffer->data.buffer(), headerSize);
         }
     }
 
+    if (stream) {
+        stream->d->bytesRead += frame.size();
+        stream->d->uncompressedBytesRead += msg.size();
+    }
+
     msg.m_buffer->resetStatus();
 
     return msg;
@@ -232,41 +358,149 @@ void Message::setNegotiatedDataVersion(quint8 version)
 void Message::resetNegotiatedDataVersion()
 {
     s_streamVersion = lowestSupportedDataVersion();
+    s_features = Protocol::NoFeatures;
 }
 
-void Message::write(QIODevice *device) const
+quint32 Message::negotiatedFeatures()
+{
+    return s_features;
+}
+
+void Message::setNegotiatedFeatures(quint32 features)
+{
+    s_features = features;
+}
+
+void Message::write(QIODevice *device, MessageStream *stream) const
 {
     Q_ASSERT(m_objectAddress != Protocol::InvalidObjectAddress);
     Q_ASSERT(m_messageType != Protocol::InvalidMessageType);
-    static const bool compressionEnabled = qgetenv("GAMMARAY_DISABLE_LZ4") != "1";
-    const int buffSize = m_buffer->data.size();
-    auto& compressedData = m_buffer->scratchSpace;
-    if (buffSize > minimumUncompressedSize && compressionEnabled)
-        compress(m_buffer->data.buffer(), compressedData);
-
-    const bool isCompressed = compressedData.size() && compressedData.size() < buffSize;
-    if (isCompressed)
-        writeNumber<Protocol::PayloadSize>(device, -compressedData.size()); // send compressed Buffer
-    else
-        writeNumber<Protocol::PayloadSize>(device, buffSize);   // send uncompressed Buffer
-
-    writeNumber(device, m_objectAddress);
-    writeNumber(device, m_messageType);
-
-    if (buffSize) {
-        if (isCompressed) {
-            const int s = device->write(compressedData);
-            Q_ASSERT(s == compressedData.size());
-            Q_UNUSED(s);
-        } else {
-            const int s = device->write(m_buffer->data.buffer());
-            Q_ASSERT(s == m_buffer->data.size());
-            Q_UNUSED(s);
+    static const bool compressionEnabled = MessageStream::isCompressionSupported();
+
+    QByteArray *frame = &m_buffer->data.buffer();
+    const int buffSize = frame->size() - headerSize;
+    Protocol::PayloadSize payloadSize = buffSize;
+    if (stream && stream->isCompressionEnabled() && buffSize > 0 && buffSize <= streamBlockMaxSize) {
+        // the block is part of the stream history now, so this has to be sent compressed
+        // even if it didn't get any smaller, otherwise the decoder history diverges
+        auto &compressedFrame = m_buffer->scratchSpace;
+        payloadSize = -stream->d->compress(frame->constData() + headerSize, buffSize, compressedFrame, headerSize);
+        frame = &compressedFrame;
+        m_buffer->standaloneCompressedSize = 0;
+    } else if (buffSize > minimumUncompressedSize && compressionEnabled
+               && m_messageType != Protocol::MessageChunk) { // chunks carry frames compressed already
+        auto &compressedFrame = m_buffer->scratchSpace;
+        if (m_buffer->standaloneCompressedSize == 0) {
+            const int compressedSize = compress(frame->constData() + headerSize, buffSize, compressedFrame, headerSize);
+            m_buffer->standaloneCompressedSize = compressedSize > 0 && compressedSize < buffSize ? compressedSize : -1;
+        }
+        if (m_buffer->standaloneCompressedSize > 0) {
+            frame = &compressedFrame;
+            payloadSize = -m_buffer->standaloneCompressedSize; // negative size marks compressed payloads
         }
     }
+
+    writeHeader(frame->data(), payloadSize);
+
+    const qint64 s = device->write(*frame);
+    Q_ASSERT(s == frame->size());
+    Q_UNUSED(s);
+
+    if (stream) {
+        stream->d->bytesWritten += frame->size();
+        stream->d->uncompressedBytesWritten += buffSize;
+    }
 }
 
 int Message::size() const
 {
-    return m_buffer->data.size();
+    return m_buffer->data.size() - headerSize;
+}
+
+void Message::append(const Message &msg)
+{
+    Q_ASSERT(msg.m_objectAddress != Protocol::InvalidObjectAddress);
+    Q_ASSERT(msg.m_messageType != Protocol::InvalidMessageType);
+
+    const QByteArray &frame = msg.m_buffer->data.buffer();
+    char header[headerSize];
+    msg.writeHeader(header, frame.size() - headerSize);
+
+    QBuffer &data = m_buffer->data;
+    m_buffer->standaloneCompressedSize = 0;
+    data.write(header, headerSize);
+    data.write(frame.constData() + headerSize, frame.size() - headerSize);
+}
+
+bool Message::canReadAppendedMessage() const
+{
+    return canReadMessage(&m_buffer->data);
+}
+
+Message Message::readAppendedMessage() const
+{
+    // appended messages are never compressed on their own
+    return readMessage(&m_buffer->data);
+}
+
+void Message::writeHeader(char *header, Protocol::PayloadSize payloadSize) const
+{
+    writeNumber(header, payloadSize);
+    writeNumber(header, m_objectAddress);
+    writeNumber(header, m_messageType);
+}
+
+MessageStream::MessageStream()
+    : d(new MessageStreamPrivate)
+{
+}
+
+MessageStream::~MessageStream() = default;
+
+bool MessageStream::isCompressionSupported()
+{
+    return qgetenv("GAMMARAY_DISABLE_LZ4") != "1";
+}
+
+bool MessageStream::isCompressionEnabled() const
+{
+    return d->compressionEnabled;
+}
+
+void MessageStream::setCompressionEnabled(bool enabled)
+{
+    d->compressionEnabled = enabled;
+}
+
+void MessageStream::reset()
+{
+    d.reset(new MessageStreamPrivate);
+}
+
+quint64 MessageStream::uncompressedBytesWritten() const
+{
+    return d->uncompressedBytesWritten;
+}
+
+quint64 MessageStream::bytesWritten() const
+{
+    return d->bytesWritten;
+}
+
+quint64 MessageStream::uncompressedBytesRead() const
+{
+    return d->uncompressedBytesRead;
+}
+
+quint64 MessageStream::bytesRead() const
+{
+    return d->bytesRead;
+}
+
+void MessageStream::resetStatistics()
+{
+    d->uncompressedBytesWritten = 0;
+    d->bytesWritten = 0;
+    d->uncompressedBytesRead = 0;
+    d->bytesRead = 0;
 }
@@ -41,6 +41,9 @@
 class MessageBuffer;
 
 namespace GammaRay {
+class MessageStream;
+class MessageStreamPrivate;
+
 /**
  * Single message send between client and server.
  * Binary format:
@@ -107,8 +110,11 @@ public:
 
     /** Checks if there is a full message waiting in @p device. */
     static bool canReadMessage(QIODevice *device);
-    /** Read the next message from @p device. */
-    static Message readMessage(QIODevice *device);
+    /** Read the next message from @p device.
+     *  Messages compressed in streaming mode can only be decoded if the @p stream
+     *  of the receiving connection is provided.
+     */
+    static Message readMessage(QIODevice *device, MessageStream *stream = nullptr);
 
     static quint8 lowestSupportedDataVersion();
     static quint8 highestSupportedDataVersion();
@@ -117,12 +123,28 @@ public:
     static void setNegotiatedDataVersion(quint8 version);
     static void resetNegotiatedDataVersion();
 
-    /** Write this message to @p device. */
-    void write(QIODevice *device) const;
+    /** Optional protocol features both sides agreed on, see Protocol::Feature. */
+    static quint32 negotiatedFeatures();
+    static void setNegotiatedFeatures(quint32 features);
+
+    /** Write this message to @p device.
+     *  If @p stream is provided and has compression enabled, the payload is compressed
+     *  using the history of all previous messages written with the same @p stream.
+     */
+    void write(QIODevice *device, MessageStream *stream = nullptr) const;
 
     /** Size of the uncompressed message payload. */
     int size() const;
 
+    /** Appends @p msg including its header to the payload of this message.
+     *  This allows sending multiple messages as one, which is then compressed as a whole.
+     */
+    void append(const Message &msg);
+    /** Checks if there is another message appended to this one left to read. */
+    bool canReadAppendedMessage() const;
+    /** Read the next message appended to this one. */
+    Message readAppendedMessage() const;
+
 private:
     Message();
 
@@ -130,12 +152,55 @@ private:
      *  and write-only for messages to be sent.
      */
     QDataStream &payload() const;
+    /** Writes the wire format header for a payload of @p payloadSize bytes to @p header. */
+    void writeHeader(char *header, Protocol::PayloadSize payloadSize) const;
 
     Protocol::ObjectAddress m_objectAddress;
     Protocol::MessageType m_messageType;
 
     std::unique_ptr<MessageBuffer, std::function<void(MessageBuffer *)>> m_buffer;
 };
+
+/**
+ * Per-connection state for reading and writing messages.
+ *
+ * This holds the LZ4 stream compression history of both directions of a connection,
+ * which allows compressing even small and repetitive messages well, as well as
+ * statistics about the compression ratio. Stream compression has to be negotiated,
+ * as the other side can only decode such messages in the same order they were written.
+ */
+class GAMMARAY_COMMON_EXPORT MessageStream
+{
+public:
+    MessageStream();
+    ~MessageStream();
+
+    /** Returns @c true if stream compression is available on this side. */
+    static bool isCompressionSupported();
+
+    /** Returns @c true if outgoing messages are stream-compressed. */
+    bool isCompressionEnabled() const;
+    /** Enables stream compression for outgoing messages, once the other side agreed to it. */
+    void setCompressionEnabled(bool enabled);
+
+    /** Discards the compression history, call this for every new connection. */
+    void reset();
+
+    /** Payload bytes written since the last resetStatistics(), before compression. */
+    quint64 uncompressedBytesWritten() const;
+    /** Bytes written to the device since the last resetStatistics(). */
+    quint64 bytesWritten() const;
+    /** Payload bytes read since the last resetStatistics(), after decompression. */
+    quint64 uncompressedBytesRead() const;
+    /** Bytes read from the device since the last resetStatistics(). */
+    quint64 bytesRead() const;
+    void resetStatistics();
+
+private:
+    Q_DISABLE_COPY(MessageStream)
+    friend class Message;
+    std::unique_ptr<MessageStreamPrivate> d;
+};
 }
 
 #endif
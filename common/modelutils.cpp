@@ -28,7 +28,7 @@
 
 #include "modelutils.h"
 
-#include <QAbstractItemModel>
+#include <QAbstractProxyModel>
 
 using namespace GammaRay;
 
@@ -73,3 +73,19 @@ QModelIndexList ModelUtils::match(const QModelIndex &start, int role, MatchAccep
 
     return result;
 }
+
+QModelIndex ModelUtils::mapFromSource(const QAbstractItemModel *model, const QModelIndex &sourceIndex)
+{
+    if (!model || !sourceIndex.isValid())
+        return QModelIndex();
+    if (sourceIndex.model() == model)
+        return sourceIndex;
+
+    const auto proxy = qobject_cast<const QAbstractProxyModel *>(model);
+    if (!proxy)
+        return QModelIndex();
+    const auto index = mapFromSource(proxy->sourceModel(), sourceIndex);
+    if (!index.isValid())
+        return QModelIndex();
+    return proxy->mapFromSource(index);
+}
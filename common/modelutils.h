@@ -33,6 +33,10 @@
 
 #include <QModelIndex>
 
+QT_BEGIN_NAMESPACE
+class QAbstractItemModel;
+QT_END_NAMESPACE
+
 namespace GammaRay {
 namespace ModelUtils {
 
@@ -52,6 +56,18 @@ typedef bool (*MatchAcceptor)(const QVariant &);
 GAMMARAY_COMMON_EXPORT QModelIndexList match(const QModelIndex &start, int role,
                                              MatchAcceptor accept, int hits = 1,
                                              Qt::MatchFlags flags = Qt::MatchFlags(Qt::MatchWrap));
+
+/**
+ * Maps @p sourceIndex to @p model, through any number of proxy models.
+ *
+ * This is the cheap alternative to searching for an item with match(), for
+ * cases where the index in the underlying source model can be determined directly.
+ *
+ * @return An invalid index if @p model is not (a proxy chain on top of) the model
+ * of @p sourceIndex, or if the item is filtered out.
+ */
+GAMMARAY_COMMON_EXPORT QModelIndex mapFromSource(const QAbstractItemModel *model,
+                                                 const QModelIndex &sourceIndex);
 }
 }
 
@@ -27,6 +27,11 @@
 */
 
 #include "protocol.h"
+#include "message.h"
+
+#include <QBitArray>
+
+#include <algorithm>
 
 namespace GammaRay {
 namespace Protocol {
@@ -54,12 +59,135 @@ QModelIndex toQModelIndex(const QAbstractItemModel *model, const Protocol::Model
 
 qint32 version()
 {
-    return 36;
+    return 48;
 }
 
 qint32 broadcastFormatVersion()
 {
     return 2;
 }
+
+quint32 supportedFeatures()
+{
+    quint32 features = ColumnarModelContent;
+    if (MessageStream::isCompressionSupported())
+        features |= StreamCompression;
+    return features;
 }
 }
+}
+
+QDataStream &operator<<(QDataStream &s, const GammaRay::Protocol::ModelContent &content)
+{
+    const int size = content.indexes.size();
+    Q_ASSERT(content.itemData.size() == size);
+    Q_ASSERT(content.flags.size() == size);
+
+    s << quint32(size);
+    for (const auto &index : content.indexes)
+        s << index;
+
+    // flags are usually the same for all cells
+    const bool uniformFlags = std::all_of(content.flags.constBegin(), content.flags.constEnd(),
+                                          [&content](qint32 flags) { return flags == content.flags.first(); });
+    s << uniformFlags;
+    if (uniformFlags && size) {
+        s << content.flags.first();
+    } else if (!uniformFlags) {
+        for (const auto flags : content.flags)
+            s << flags;
+    }
+
+    // collect roles and their value type, or UnknownType if the type differs between cells
+    QMap<int, int> roleTypes;
+    for (const auto &itemData : content.itemData) {
+        for (auto it = itemData.constBegin(); it != itemData.constEnd(); ++it) {
+            auto roleIt = roleTypes.find(it.key());
+            if (roleIt == roleTypes.end())
+                roleTypes.insert(it.key(), it.value().userType());
+            else if (roleIt.value() != it.value().userType())
+                roleIt.value() = QMetaType::UnknownType;
+        }
+    }
+
+    s << quint32(roleTypes.size());
+    for (auto roleIt = roleTypes.constBegin(); roleIt != roleTypes.constEnd(); ++roleIt) {
+        const int role = roleIt.key();
+        const int type = roleIt.value();
+        s << qint32(role) << QByteArray(type == QMetaType::UnknownType ? nullptr : QMetaType::typeName(type));
+
+        QBitArray present(size);
+        for (int i = 0; i < size; ++i)
+            present.setBit(i, content.itemData.at(i).contains(role));
+        s << present;
+
+        for (int i = 0; i < size; ++i) {
+            if (!present.testBit(i))
+                continue;
+            const QVariant value = content.itemData.at(i).value(role);
+            if (type == QMetaType::UnknownType)
+                s << value;
+            else
+                QMetaType::save(s, type, value.constData());
+        }
+    }
+    return s;
+}
+
+QDataStream &operator>>(QDataStream &s, GammaRay::Protocol::ModelContent &content)
+{
+    quint32 size;
+    s >> size;
+    content.indexes.resize(size);
+    content.itemData.clear();
+    content.itemData.resize(size);
+    content.flags.resize(size);
+
+    for (auto &index : content.indexes)
+        s >> index;
+
+    bool uniformFlags;
+    s >> uniformFlags;
+    if (uniformFlags && size) {
+        qint32 flags;
+        s >> flags;
+        content.flags.fill(flags);
+    } else if (!uniformFlags) {
+        for (auto &flags : content.flags)
+            s >> flags;
+    }
+
+    quint32 roleCount;
+    s >> roleCount;
+    for (quint32 r = 0; r < roleCount && s.status() == QDataStream::Ok; ++r) {
+        qint32 role;
+        QByteArray typeName;
+        QBitArray present;
+        s >> role >> typeName >> present;
+
+        int type = QMetaType::UnknownType;
+        if (!typeName.isEmpty()) {
+            type = QMetaType::type(typeName.constData());
+            if (type == QMetaType::UnknownType) {
+                // we can't know how much data to skip
+                s.setStatus(QDataStream::ReadCorruptData);
+                break;
+            }
+        }
+
+        for (int i = 0; i < present.size() && i < int(size); ++i) {
+            if (!present.testBit(i))
+                continue;
+            QVariant value;
+            if (type == QMetaType::UnknownType) {
+                s >> value;
+            } else {
+                value = QVariant(type, nullptr);
+                QMetaType::load(s, type, value.data());
+            }
+            // roles are sorted, so this always appends
+            content.itemData[i].insert(role, value);
+        }
+    }
+    return s;
+}
@@ -34,6 +34,7 @@
 #include <QAbstractItemModel>
 #include <QDataStream>
 #include <QDebug>
+#include <QMap>
 #include <QVector>
 #include <QModelIndex>
 
@@ -76,15 +77,19 @@ enum BuildInMessageType {
     ClientDataVersionNegotiated,
     ModelRowColumnCountRequest,
     ModelContentRequest,
+    ModelContentRangeRequest,
+    ModelSubtreeRequest,
     ModelHeaderRequest,
     ModelSetDataRequest,
     ModelSortRequest,
     ModelSyncBarrier,
+    ModelVisibleRegionChanged,
     SelectionModelStateRequest,
 
     // server -> client
     ModelRowColumnCountReply,
     ModelContentReply,
+    ModelSubtreeReply,
     ModelContentChanged,
     ModelHeaderReply,
     ModelHeaderChanged,
@@ -112,9 +117,28 @@ enum BuildInMessageType {
     ServerAddress,
     ServerLaunchError,
 
+    // server <-> client, multiple messages sent as one, see Endpoint
+    MessageBatch,
+    // server <-> client, part of a large message interleaved with others, see Endpoint
+    MessageChunk,
+
     MESSAGE_TYPE_COUNT // NOTE when changing this enum, also update MessageStatisticsModel!
 };
 
+/*! Optional protocol features, agreed on during the data version negotiation. */
+enum Feature {
+    NoFeatures = 0x0,
+    StreamCompression = 0x1, ///< LZ4 compression across messages, see MessageStream
+    ColumnarModelContent = 0x2 ///< ModelContentReply encoded as ModelContent
+};
+
+/*! Priority classes for outgoing messages, see Endpoint::setObjectPriority(). */
+enum MessagePriority {
+    InteractivePriority = 0, ///< everything that has to arrive in the order it was sent, such as model content
+    BulkPriority, ///< large payloads such as remote view frames, other traffic may overtake these
+    MessagePriorityCount
+};
+
 ///@cond internal
 /*! Transport protocol representation of a model index element. */
 class ModelIndexData
@@ -126,9 +150,17 @@ public:
     qint32 row;
     qint32 column;
 };
-/*! Transport protocol representation of a QModelIndex. */
+/*! Transport protocol representation of a QModelIndex.
+ *  This is the path of rows and columns from the root, or from a persistent node handle
+ *  assigned by the server (see NodeHandleRow).
+ */
 using ModelIndex = QVector<ModelIndexData>;
 
+/*! Row value marking the first element of a ModelIndex as persistent node handle, with the handle
+ *  stored in the column field. The handle replaces the path from the root to that node.
+ */
+static const qint32 NodeHandleRow = -2;
+
 /*! Protocol representation of an QItemSelectionRange. */
 struct ItemSelectionRange {
     ModelIndex topLeft;
@@ -137,6 +169,17 @@ struct ItemSelectionRange {
 /*! Protocol representation of an QItemSelection. */
 using ItemSelection = QVector<ItemSelectionRange>;
 
+/*! Item data and flags of a set of model cells.
+ *  This is serialized column-wise, that is the roles and the value types per role are only
+ *  sent once, followed by the values of all cells having that role.
+ */
+struct ModelContent
+{
+    QVector<ModelIndex> indexes;
+    QVector<QMap<int, QVariant> > itemData;
+    QVector<qint32> flags;
+};
+
 /*! Serializes a QModelIndex. */
 GAMMARAY_COMMON_EXPORT ModelIndex fromQModelIndex(const QModelIndex &index);
 
@@ -150,6 +193,9 @@ GAMMARAY_COMMON_EXPORT qint32 version();
 
 /*! Broadcast format version. */
 GAMMARAY_COMMON_EXPORT qint32 broadcastFormatVersion();
+
+/*! Optional features supported by this side of the connection. */
+GAMMARAY_COMMON_EXPORT quint32 supportedFeatures();
 }
 }
 
@@ -166,6 +212,9 @@ inline QDataStream& operator<<(QDataStream& s, const GammaRay::Protocol::ModelIn
     return s;
 }
 
+GAMMARAY_COMMON_EXPORT QDataStream& operator<<(QDataStream &s, const GammaRay::Protocol::ModelContent &content);
+GAMMARAY_COMMON_EXPORT QDataStream& operator>>(QDataStream &s, GammaRay::Protocol::ModelContent &content);
+
 inline QDebug& operator<<(QDebug &s, const GammaRay::Protocol::ModelIndexData &data)
 {
     s << '(' << data.row << ',' << data.column << ')';
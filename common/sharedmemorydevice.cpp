@@ -0,0 +1,347 @@
+/*
+  sharedmemorydevice.cpp
+
+  This file is part of GammaRay, the Qt application inspection and
+  manipulation tool.
+
+  Copyright (C) 2019 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+
+  Licensees holding valid commercial KDAB GammaRay licenses may use this file in
+  accordance with GammaRay Commercial License Agreement provided with the Software.
+
+  Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sharedmemorydevice.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QLocalSocket>
+#include <QSharedMemory>
+
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <QFile>
+#ifdef QT_POSIX_IPC
+#include <sys/mman.h>
+#else
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+#endif
+
+using namespace GammaRay;
+
+namespace {
+const quint32 SegmentMagic = 0x47525348;
+const int CacheLineSize = 64;
+
+// doorbell messages
+const char DataSignal = 'D';
+const char SpaceSignal = 'S';
+
+// Removes the name of @p segment, so that the system releases it once both sides detached,
+// rather than keeping it around forever if the creator crashes. This has to match how
+// QSharedMemory derives the system resource from its native key.
+void unlinkSegment(const QSharedMemory *segment)
+{
+#ifdef Q_OS_UNIX
+    const QByteArray nativeKey = QFile::encodeName(segment->nativeKey());
+#ifdef QT_POSIX_IPC
+    if (shm_unlink(nativeKey.constData()) != 0)
+        qWarning() << "Failed to unlink shared memory segment:" << segment->nativeKey();
+#else
+    const key_t key = ftok(nativeKey.constData(), 'Q');
+    const int id = key == -1 ? -1 : shmget(key, 0, 0400);
+    if (id == -1 || shmctl(id, IPC_RMID, nullptr) != 0)
+        qWarning() << "Failed to remove shared memory segment:" << segment->nativeKey();
+    // the key file is only needed for looking the segment up
+    QFile::remove(segment->nativeKey());
+#endif
+#else
+    // named shared memory is reference counted by the system
+    Q_UNUSED(segment);
+#endif
+}
+}
+
+// Positions are free running and only ever written by one side each, the
+// flags are handed over between producer and consumer.
+struct SharedMemoryDevice::Ring
+{
+    QBasicAtomicInteger<quint32> writePos;
+    // consumer has been rung for new data and did not pick that up yet
+    QBasicAtomicInt dataSignaled;
+    char padding0[CacheLineSize - 2 * sizeof(quint32)];
+
+    QBasicAtomicInteger<quint32> readPos;
+    // producer is waiting for free space
+    QBasicAtomicInt writerBlocked;
+    char padding1[CacheLineSize - 2 * sizeof(quint32)];
+};
+
+struct SharedMemoryDevice::SegmentHeader
+{
+    quint32 magic;
+    quint32 ringSize;
+    char padding[CacheLineSize - 2 * sizeof(quint32)];
+    Ring rings[2]; // server to client, client to server
+    // ring data follows
+};
+
+QSharedMemory *SharedMemoryDevice::createSegment(const QString &key, int ringSize)
+{
+    Q_ASSERT(ringSize > 0 && (ringSize & (ringSize - 1)) == 0);
+
+    std::unique_ptr<QSharedMemory> segment(new QSharedMemory(key));
+    if (!segment->create(int(sizeof(SegmentHeader)) + 2 * ringSize)) {
+        qWarning() << "Failed to create shared memory segment:" << segment->errorString();
+        return nullptr;
+    }
+
+    auto header = static_cast<SegmentHeader *>(segment->data());
+    memset(header, 0, sizeof(SegmentHeader));
+    header->magic = SegmentMagic;
+    header->ringSize = ringSize;
+    return segment.release();
+}
+
+QSharedMemory *SharedMemoryDevice::attachSegment(const QString &key)
+{
+    std::unique_ptr<QSharedMemory> segment(new QSharedMemory(key));
+    if (!segment->attach()) {
+        qWarning() << "Failed to attach to shared memory segment:" << segment->errorString();
+        return nullptr;
+    }
+
+    const auto header = static_cast<const SegmentHeader *>(segment->constData());
+    if (segment->size() < int(sizeof(SegmentHeader)) || header->magic != SegmentMagic
+        || qint64(segment->size()) < qint64(sizeof(SegmentHeader)) + 2 * qint64(header->ringSize)) {
+        qWarning() << "Invalid shared memory segment:" << key;
+        return nullptr;
+    }
+
+    // both sides are attached now, nobody else needs to find the segment anymore
+    unlinkSegment(segment.get());
+    return segment.release();
+}
+
+SharedMemoryDevice::SharedMemoryDevice(QSharedMemory *segment, QLocalSocket *doorbell, Role role,
+                                       QObject *parent)
+    : QIODevice(parent)
+    , m_segment(segment)
+    , m_doorbell(doorbell)
+    , m_pendingWriteOffset(0)
+{
+    auto header = static_cast<SegmentHeader *>(m_segment->data());
+    const int readIndex = role == ServerRole ? 1 : 0;
+    const int writeIndex = 1 - readIndex;
+    m_readRing = &header->rings[readIndex];
+    m_writeRing = &header->rings[writeIndex];
+    auto data = reinterpret_cast<char *>(header + 1);
+    m_readData = data + readIndex * header->ringSize;
+    m_writeData = data + writeIndex * header->ringSize;
+    m_ringMask = header->ringSize - 1;
+
+    connect(m_doorbell, &QLocalSocket::readyRead, this, &SharedMemoryDevice::doorbellRang);
+    connect(m_doorbell, &QLocalSocket::disconnected, this, &SharedMemoryDevice::doorbellDisconnected);
+    // the peer might have rung before we got here, e.g. during the connection handshake
+    if (m_doorbell->bytesAvailable() > 0)
+        QMetaObject::invokeMethod(this, "doorbellRang", Qt::QueuedConnection);
+
+    open(QIODevice::ReadWrite);
+}
+
+SharedMemoryDevice::~SharedMemoryDevice() = default;
+
+bool SharedMemoryDevice::isSequential() const
+{
+    return true;
+}
+
+qint64 SharedMemoryDevice::bytesAvailable() const
+{
+    if (!isOpen())
+        return QIODevice::bytesAvailable();
+    return QIODevice::bytesAvailable()
+           + (m_readRing->writePos.loadAcquire() - m_readRing->readPos.load());
+}
+
+qint64 SharedMemoryDevice::bytesToWrite() const
+{
+    return m_pendingWrite.size() - m_pendingWriteOffset;
+}
+
+bool SharedMemoryDevice::waitForReadyRead(int msecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (bytesAvailable() == 0) {
+        if (!isOpen())
+            return false;
+        const int remaining = msecs < 0 ? -1 : qMax<int>(0, msecs - timer.elapsed());
+        if (remaining == 0 || !m_doorbell->waitForReadyRead(remaining))
+            return false;
+        doorbellRang();
+    }
+    return true;
+}
+
+bool SharedMemoryDevice::waitForBytesWritten(int msecs)
+{
+    if (bytesToWrite() == 0)
+        return false;
+
+    QElapsedTimer timer;
+    timer.start();
+    while (bytesToWrite() > 0) {
+        if (!isOpen())
+            return false;
+        const int remaining = msecs < 0 ? -1 : qMax<int>(0, msecs - timer.elapsed());
+        if (remaining == 0 || !m_doorbell->waitForReadyRead(remaining))
+            return false;
+        doorbellRang();
+    }
+    return true;
+}
+
+void SharedMemoryDevice::close()
+{
+    if (!isOpen())
+        return;
+    QIODevice::close();
+    m_pendingWrite.clear();
+    m_pendingWriteOffset = 0;
+    m_doorbell->disconnectFromServer();
+}
+
+qint64 SharedMemoryDevice::readData(char *data, qint64 maxSize)
+{
+    const quint32 readPos = m_readRing->readPos.load();
+    const quint32 available = m_readRing->writePos.loadAcquire() - readPos;
+    const auto size = static_cast<quint32>(qMin<qint64>(available, maxSize));
+    if (size == 0)
+        return 0;
+
+    const quint32 offset = readPos & m_ringMask;
+    const quint32 firstChunk = qMin(size, m_ringMask + 1 - offset);
+    memcpy(data, m_readData + offset, firstChunk);
+    memcpy(data + firstChunk, m_readData, size - firstChunk);
+
+    // full barrier, pairs with the one in flushPendingWrite()
+    m_readRing->readPos.fetchAndStoreOrdered(readPos + size);
+    if (m_readRing->writerBlocked.load() && m_readRing->writerBlocked.fetchAndStoreOrdered(0))
+        ring(SpaceSignal);
+    return size;
+}
+
+qint64 SharedMemoryDevice::writeData(const char *data, qint64 maxSize)
+{
+    // anything not fitting into the ring is kept, and sent in order once the peer caught up
+    if (bytesToWrite() > 0) {
+        m_pendingWrite.append(data, maxSize);
+        return maxSize;
+    }
+
+    const quint32 written = writeToRing(data, static_cast<quint32>(qMin<qint64>(maxSize, m_ringMask + 1)));
+    if (written < maxSize) {
+        m_pendingWrite = QByteArray(data + written, maxSize - written);
+        m_pendingWriteOffset = 0;
+        flushPendingWrite();
+    }
+    return maxSize;
+}
+
+quint32 SharedMemoryDevice::writeToRing(const char *data, quint32 size)
+{
+    const quint32 writePos = m_writeRing->writePos.load();
+    const quint32 free = m_ringMask + 1 - (writePos - m_writeRing->readPos.loadAcquire());
+    size = qMin(size, free);
+    if (size == 0)
+        return 0;
+
+    const quint32 offset = writePos & m_ringMask;
+    const quint32 firstChunk = qMin(size, m_ringMask + 1 - offset);
+    memcpy(m_writeData + offset, data, firstChunk);
+    memcpy(m_writeData, data + firstChunk, size - firstChunk);
+
+    // full barrier, pairs with the one in doorbellRang()
+    m_writeRing->writePos.fetchAndStoreOrdered(writePos + size);
+    if (!m_writeRing->dataSignaled.fetchAndStoreOrdered(1))
+        ring(DataSignal);
+    return size;
+}
+
+// returns @c true if all pending data made it into the ring
+bool SharedMemoryDevice::flushPendingWrite()
+{
+    bool announced = false;
+    while (bytesToWrite() > 0) {
+        const quint32 size = static_cast<quint32>(qMin<qint64>(bytesToWrite(), m_ringMask + 1));
+        const quint32 written = writeToRing(m_pendingWrite.constData() + m_pendingWriteOffset, size);
+        if (written > 0) {
+            m_pendingWriteOffset += written;
+            continue;
+        }
+
+        // tell the reader we are waiting, then try once more so we don't miss a read
+        // that happened in between
+        if (announced)
+            return false;
+        m_writeRing->writerBlocked.fetchAndStoreOrdered(1);
+        announced = true;
+    }
+
+    m_pendingWrite.clear();
+    m_pendingWriteOffset = 0;
+    return true;
+}
+
+void SharedMemoryDevice::ring(char signal)
+{
+    if (m_doorbell->state() != QLocalSocket::ConnectedState)
+        return;
+    m_doorbell->write(&signal, 1);
+    m_doorbell->flush();
+}
+
+void SharedMemoryDevice::doorbellRang()
+{
+    if (!isOpen())
+        return;
+
+    const QByteArray rings = m_doorbell->readAll();
+    if (rings.contains(SpaceSignal) && bytesToWrite() > 0) {
+        const qint64 pending = bytesToWrite();
+        flushPendingWrite();
+        if (pending > bytesToWrite())
+            emit bytesWritten(pending - bytesToWrite());
+    }
+
+    if (rings.contains(DataSignal)) {
+        // re-arm before looking at the data, so we don't miss a write in between
+        m_readRing->dataSignaled.fetchAndStoreOrdered(0);
+        if (bytesAvailable() > 0)
+            emit readyRead();
+    }
+}
+
+void SharedMemoryDevice::doorbellDisconnected()
+{
+    close();
+    emit disconnected();
+}
@@ -0,0 +1,123 @@
+/*
+  sharedmemorydevice.h
+
+  This file is part of GammaRay, the Qt application inspection and
+  manipulation tool.
+
+  Copyright (C) 2019 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+
+  Licensees holding valid commercial KDAB GammaRay licenses may use this file in
+  accordance with GammaRay Commercial License Agreement provided with the Software.
+
+  Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GAMMARAY_SHAREDMEMORYDEVICE_H
+#define GAMMARAY_SHAREDMEMORYDEVICE_H
+
+#include "gammaray_common_export.h"
+
+#include <QByteArray>
+#include <QIODevice>
+
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+class QLocalSocket;
+class QSharedMemory;
+QT_END_NAMESPACE
+
+namespace GammaRay {
+/**
+ * Bidirectional stream between two processes on the same host, backed by a
+ * pair of single-producer/single-consumer ring buffers in a shared memory segment.
+ *
+ * Payload data never passes through the kernel, the local socket both sides
+ * are connected by is only used as doorbell: a single byte is sent when the
+ * peer needs to be woken up for new data or for free space in a full ring.
+ * The socket also provides the connection lifetime, the device is closed and
+ * emits disconnected() once the socket connection is lost.
+ */
+class GAMMARAY_COMMON_EXPORT SharedMemoryDevice : public QIODevice
+{
+    Q_OBJECT
+public:
+    enum Role {
+        ServerRole, ///< creator of the segment
+        ClientRole
+    };
+
+    enum {
+        DefaultRingSize = 16 * 1024 * 1024
+    };
+
+    /** Creates and initializes a new segment for use with SharedMemoryDevice.
+     *  @p ringSize has to be a power of two, it is used for each direction.
+     *  Returns @c nullptr on failure.
+     */
+    static QSharedMemory *createSegment(const QString &key, int ringSize = DefaultRingSize);
+    /** Attaches to a segment previously created by createSegment().
+     *  This also removes the name of the segment, so it can't be attached to again, and
+     *  the system releases it once both sides detached, even if the creator crashed.
+     *  Returns @c nullptr on failure.
+     */
+    static QSharedMemory *attachSegment(const QString &key);
+
+    /** Takes ownership of @p segment, but not of @p doorbell. */
+    SharedMemoryDevice(QSharedMemory *segment, QLocalSocket *doorbell, Role role,
+                       QObject *parent = nullptr);
+    ~SharedMemoryDevice() override;
+
+    bool isSequential() const override;
+    qint64 bytesAvailable() const override;
+    qint64 bytesToWrite() const override;
+    bool waitForReadyRead(int msecs) override;
+    bool waitForBytesWritten(int msecs) override;
+    void close() override;
+
+signals:
+    void disconnected();
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private slots:
+    void doorbellRang();
+    void doorbellDisconnected();
+
+private:
+    struct Ring;
+    struct SegmentHeader;
+
+    quint32 writeToRing(const char *data, quint32 size);
+    bool flushPendingWrite();
+    void ring(char signal);
+
+    std::unique_ptr<QSharedMemory> m_segment;
+    QLocalSocket *m_doorbell;
+    Ring *m_readRing;
+    Ring *m_writeRing;
+    char *m_readData;
+    char *m_writeData;
+    quint32 m_ringMask;
+    // data not fitting into the write ring yet
+    QByteArray m_pendingWrite;
+    int m_pendingWriteOffset;
+};
+}
+
+#endif // GAMMARAY_SHAREDMEMORYDEVICE_H
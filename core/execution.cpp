@@ -29,6 +29,13 @@
 #include <config-gammaray.h>
 #include "execution.h"
 
+#include <QCache>
+#include <QHash>
+#include <QMetaMethod>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
 #include <QtGlobal>
 
 #if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
@@ -131,6 +138,24 @@ Execution::Trace Execution::stackTrace(int maxDepth, int skip)
     return t;
 }
 
+namespace {
+// the platform resolvers are not thread-safe, so the lock also serializes all resolving
+struct ResolvedFrameCache
+{
+    ResolvedFrameCache()
+        : frames(4096)
+    {
+    }
+
+    QMutex lock;
+    QCache<const void *, Execution::ResolvedFrame> frames;
+    // bumped whenever the resolver loads a trace, see resolveCached()
+    quint64 loadGeneration = 0;
+};
+}
+
+Q_GLOBAL_STATIC(ResolvedFrameCache, s_resolvedFrameCache)
+
 #ifdef USE_BACKWARD_CPP
 static backward::TraceResolver* resolver()
 {
@@ -190,52 +215,84 @@ static QString maybeDemangleName(char *name)
 }
 #endif
 
-Execution::ResolvedFrame Execution::resolveOne(const Execution::Trace &trace, int index)
+static const void *frameAddress(const Execution::Trace &trace, int index)
 {
-    ResolvedFrame frame;
-    if (index >= trace.size())
-        return frame;
+    auto &data = Execution::TracePrivate::get(trace);
+#ifdef USE_BACKWARD_CPP
+    return data[index].addr;
+#else
+    return data.at(index);
+#endif
+}
+
+// pre-condition: cache lock is held
+// @p loaded is the load generation of the last time @p trace was loaded into the resolver by
+// the caller, anyone else might have loaded a different one since then while not holding the lock
+static Execution::ResolvedFrame resolveCached(const Execution::Trace &trace, int index, quint64 *loaded)
+{
+    auto &data = Execution::TracePrivate::get(trace);
+    const void *addr = frameAddress(trace, index);
+    if (const auto cachedFrame = s_resolvedFrameCache()->frames.object(addr))
+        return *cachedFrame;
 
+    Execution::ResolvedFrame frame;
 #ifdef USE_BACKWARD_CPP
-    auto &st = TracePrivate::get(trace);
-    resolver()->load_stacktrace(st);
-    frame = toResolvedFrame(resolver()->resolve(st[index]), st[index].addr);
+    if (*loaded == 0 || *loaded != s_resolvedFrameCache()->loadGeneration) {
+        resolver()->load_stacktrace(data);
+        *loaded = ++s_resolvedFrameCache()->loadGeneration;
+    }
+    frame = toResolvedFrame(resolver()->resolve(data[index]), data[index].addr);
 
 #elif defined(HAVE_BACKTRACE)
-    const auto &v = TracePrivate::get(trace);
-    char **strings = backtrace_symbols(v.data() + index, 1);
+    Q_UNUSED(loaded);
+    char **strings = backtrace_symbols(data.data() + index, 1);
     frame.name = maybeDemangleName(strings[0]);
     free(strings);
 
 #else
-    Q_UNUSED(trace);
-    Q_UNUSED(index);
+    Q_UNUSED(loaded);
 #endif
+    s_resolvedFrameCache()->frames.insert(addr, new Execution::ResolvedFrame(frame));
     return frame;
 }
 
+Execution::ResolvedFrame Execution::resolveOne(const Execution::Trace &trace, int index)
+{
+    if (index >= trace.size())
+        return ResolvedFrame();
+
+    QMutexLocker lock(&s_resolvedFrameCache()->lock);
+    quint64 loaded = 0;
+    return resolveCached(trace, index, &loaded);
+}
+
+bool Execution::resolveOneCached(const Execution::Trace &trace, int index, ResolvedFrame *frame)
+{
+    if (index >= trace.size()) {
+        *frame = ResolvedFrame();
+        return true;
+    }
+
+    QMutexLocker lock(&s_resolvedFrameCache()->lock);
+    const auto cachedFrame = s_resolvedFrameCache()->frames.object(frameAddress(trace, index));
+    if (!cachedFrame)
+        return false;
+    *frame = *cachedFrame;
+    return true;
+}
+
 QVector<Execution::ResolvedFrame> Execution::resolveAll(const Execution::Trace &trace)
 {
     QVector<ResolvedFrame> frames;
     frames.reserve(trace.size());
 
-#ifdef USE_BACKWARD_CPP
-    auto &st = TracePrivate::get(trace);
-    resolver()->load_stacktrace(st);
-    for (int i = 0; i < trace.size(); ++i)
-        frames.push_back(toResolvedFrame(resolver()->resolve(st[i]), st[i].addr));
-
-#elif defined(HAVE_BACKTRACE)
-    const auto &v = TracePrivate::get(trace);
-    char **strings = backtrace_symbols(v.data(), v.size());
-    for (int i = 0; i < v.size(); ++i) {
-        ResolvedFrame frame;
-        frame.name = maybeDemangleName(strings[i]);
-        frames.push_back(frame);
+    // the lock is taken per frame, so that lookups from other threads don't have to wait
+    // for the entire trace
+    quint64 loaded = 0;
+    for (int i = 0; i < trace.size(); ++i) {
+        QMutexLocker lock(&s_resolvedFrameCache()->lock);
+        frames.push_back(resolveCached(trace, i, &loaded));
     }
-    free(strings);
-
-#endif
     return frames;
 }
 
@@ -332,6 +389,12 @@ Execution::ResolvedFrame Execution::resolveOne(const Execution::Trace &trace, in
     return TracePrivate::get(trace).at(index);
 }
 
+bool Execution::resolveOneCached(const Execution::Trace &trace, int index, ResolvedFrame *frame)
+{
+    *frame = index < trace.size() ? resolveOne(trace, index) : ResolvedFrame();
+    return true;
+}
+
 QVector<Execution::ResolvedFrame> Execution::resolveAll(const Execution::Trace &trace)
 {
     QVector<ResolvedFrame> frames;
@@ -382,5 +445,150 @@ int Trace::size() const
     return d->data.size();
 }
 
+bool Trace::operator==(const Trace &other) const
+{
+    if (d == other.d)
+        return true;
+#if defined(USE_BACKWARD_CPP)
+    if (d->data.size() != other.d->data.size())
+        return false;
+    for (std::size_t i = 0; i < d->data.size(); ++i) {
+        if (d->data[i].addr != other.d->data[i].addr)
+            return false;
+    }
+    return true;
+#elif defined(Q_OS_WIN)
+    return false; // resolved eagerly, only shared instances are equal
+#else
+    return d->data == other.d->data;
+#endif
+}
+
+bool Trace::operator!=(const Trace &other) const
+{
+    return !operator==(other);
+}
+
+uint qHash(const Trace &trace, uint seed)
+{
+#if defined(USE_BACKWARD_CPP)
+    auto &data = trace.d->data; // backward's operator[] is non-const
+    for (std::size_t i = 0; i < data.size(); ++i)
+        seed ^= ::qHash(data[i].addr) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    return seed;
+#elif defined(Q_OS_WIN)
+    return ::qHash(trace.d.get(), seed);
+#else
+    return qHashRange(trace.d->data.constBegin(), trace.d->data.constEnd(), seed);
+#endif
+}
+
+class ResolveJob : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ResolveJob(const Trace &trace, int index = -1)
+        : trace(trace)
+        , index(index)
+    {
+    }
+
+    Trace trace;
+    // the single frame to resolve, all of them if negative
+    int index;
+
+signals:
+    void finished(const QVector<GammaRay::Execution::ResolvedFrame> &frames);
+};
+
+class SymbolResolverThread : public QThread
+{
+public:
+    SymbolResolverThread()
+    {
+        setObjectName(QStringLiteral("GammaRay::SymbolResolverThread"));
+        qRegisterMetaType<QVector<ResolvedFrame> >();
+    }
+
+    ~SymbolResolverThread() override
+    {
+        {
+            QMutexLocker lock(&m_mutex);
+            m_stop = true;
+            m_waitCondition.wakeAll();
+        }
+        wait();
+        qDeleteAll(m_jobs);
+    }
+
+    void enqueue(ResolveJob *job)
+    {
+        QMutexLocker lock(&m_mutex);
+        m_jobs.enqueue(job);
+        if (!isRunning())
+            start(QThread::LowPriority);
+        m_waitCondition.wakeOne();
+    }
+
+protected:
+    void run() override
+    {
+        static const QMetaMethod finishedSignal = QMetaMethod::fromSignal(&ResolveJob::finished);
+        forever {
+            ResolveJob *job = nullptr;
+            {
+                QMutexLocker lock(&m_mutex);
+                while (!m_stop && m_jobs.isEmpty())
+                    m_waitCondition.wait(&m_mutex);
+                if (m_stop)
+                    return;
+                job = m_jobs.dequeue();
+            }
+
+            // the receiver is gone already, nothing to do
+            if (job->isSignalConnected(finishedSignal)) {
+                if (job->index < 0)
+                    emit job->finished(resolveAll(job->trace));
+                else
+                    emit job->finished(QVector<ResolvedFrame>() << resolveOne(job->trace, job->index));
+            }
+            delete job;
+        }
+    }
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_waitCondition;
+    QQueue<ResolveJob *> m_jobs;
+    bool m_stop = false;
+};
+
 }}
+
+Q_GLOBAL_STATIC(Execution::SymbolResolverThread, s_symbolResolverThread)
+
+void Execution::resolveAllAsync(const Trace &trace, QObject *context,
+                                const std::function<void(const QVector<ResolvedFrame> &)> &callback)
+{
+    Q_ASSERT(context);
+    auto job = new ResolveJob(trace);
+    // the job is emitting from the resolver thread, so this is always a queued connection
+    QObject::connect(job, &ResolveJob::finished, context, callback);
+    job->moveToThread(s_symbolResolverThread());
+    s_symbolResolverThread()->enqueue(job);
+}
+
+void Execution::resolveOneAsync(const Trace &trace, int index, QObject *context,
+                                const std::function<void(const ResolvedFrame &)> &callback)
+{
+    Q_ASSERT(context);
+    auto job = new ResolveJob(trace, index);
+    QObject::connect(job, &ResolveJob::finished, context, [callback](const QVector<ResolvedFrame> &frames) {
+        callback(frames.value(0));
+    });
+    job->moveToThread(s_symbolResolverThread());
+    s_symbolResolverThread()->enqueue(job);
+}
 //END generic code
+
+#include "execution.moc"
@@ -36,8 +36,13 @@
 #include <QMetaType>
 #include <QVector>
 
+#include <functional>
 #include <memory>
 
+QT_BEGIN_NAMESPACE
+class QObject;
+QT_END_NAMESPACE
+
 namespace GammaRay {
 
 /*! Functions to inspect the current program execution. */
@@ -68,11 +73,20 @@ public:
 
     bool empty() const;
     int size() const;
+
+    /*! Two traces are equal if they consist of the same frames. */
+    bool operator==(const Trace &other) const;
+    bool operator!=(const Trace &other) const;
+
 private:
+    friend GAMMARAY_CORE_EXPORT uint qHash(const Trace &trace, uint seed);
     friend class TracePrivate;
     std::shared_ptr<TracePrivate> d;
 };
 
+/*! Hash over the frames of @p trace, for use in QHash. */
+GAMMARAY_CORE_EXPORT uint qHash(const Trace &trace, uint seed = 0);
+
 /*! Create a backtrace.
  *  @param maxDepth The maximum amount of frames to trace
  *  @param skip The amount of frames to skip from the beginning. This is useful to
@@ -89,15 +103,31 @@ public:
     SourceLocation location;
 };
 
-/*! Resolve a single backtrace frame. */
+/*! Resolve a single backtrace frame.
+ *  Resolved frames are cached by address, this is shared by all resolve functions.
+ */
 GAMMARAY_CORE_EXPORT ResolvedFrame resolveOne(const Trace &trace, int index);
+/*! Look up a single backtrace frame without resolving it.
+ *  Returns @c false if the frame hasn't been resolved before.
+ */
+GAMMARAY_CORE_EXPORT bool resolveOneCached(const Trace &trace, int index, ResolvedFrame *frame);
 /*! Resolve an entire backtrace. */
 GAMMARAY_CORE_EXPORT QVector<ResolvedFrame> resolveAll(const Trace &trace);
+/*! Resolve an entire backtrace in a background thread.
+ *  @p callback is invoked with the resolved frames in the thread of @p context,
+ *  unless @p context is destroyed before, which also cancels the request.
+ */
+GAMMARAY_CORE_EXPORT void resolveAllAsync(const Trace &trace, QObject *context,
+                                          const std::function<void(const QVector<ResolvedFrame> &)> &callback);
+/*! Resolve a single backtrace frame in a background thread, see resolveAllAsync(). */
+GAMMARAY_CORE_EXPORT void resolveOneAsync(const Trace &trace, int index, QObject *context,
+                                          const std::function<void(const ResolvedFrame &)> &callback);
 
 }
 
 }
 
 Q_DECLARE_METATYPE(GammaRay::Execution::Trace)
+Q_DECLARE_METATYPE(GammaRay::Execution::ResolvedFrame)
 
 #endif // GAMMARAY_EXECUTION_H
@@ -105,6 +105,22 @@ SourceLocation ObjectDataProvider::creationLocation(QObject *obj)
     return loc;
 }
 
+SourceLocation ObjectDataProvider::resolvedCreationLocation(QObject *obj)
+{
+    SourceLocation loc;
+    if (!obj)
+        return loc;
+
+    foreach (auto provider, *s_providers()) {
+        loc = provider->creationLocation(obj);
+        if (loc.isValid())
+            return loc;
+    }
+
+    loc = Probe::instance()->resolveObjectCreationSourceLocation(obj);
+    return loc;
+}
+
 SourceLocation ObjectDataProvider::declarationLocation(QObject *obj)
 {
     SourceLocation loc;
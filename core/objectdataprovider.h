@@ -84,6 +84,12 @@ GAMMARAY_CORE_EXPORT QString shortTypeName(QObject *obj);
 /*! Returns the source location where this object was created, if known. */
 GAMMARAY_CORE_EXPORT SourceLocation creationLocation(QObject *obj);
 
+/*! Returns the source location where this object was created, if known.
+ * Unlike creationLocation() this resolves the location on the calling thread if
+ * necessary, use this only for on-demand operations such as problem scans.
+ */
+GAMMARAY_CORE_EXPORT SourceLocation resolvedCreationLocation(QObject *obj);
+
 /*! Returns the source location where the type of this object was declared, if known. */
 GAMMARAY_CORE_EXPORT SourceLocation declarationLocation(QObject *obj);
 }
@@ -30,7 +30,10 @@
 
 #include "probe.h"
 
+#include <compat/qasconst.h>
+
 #include <QThread>
+#include <QTimer>
 #include <QCoreApplication>
 
 #include <algorithm>
@@ -41,11 +44,18 @@ using namespace std;
 
 ObjectListModel::ObjectListModel(Probe *probe)
     : ObjectModelBase< QAbstractTableModel >(probe)
+    , m_flushTimer(new QTimer(this))
 {
     connect(probe, &Probe::objectCreated,
             this, &ObjectListModel::objectAdded);
     connect(probe, &Probe::objectDestroyed,
             this, &ObjectListModel::objectRemoved);
+    connect(probe, &Probe::objectCreationSourceLocationResolved,
+            this, &ObjectListModel::objectCreationSourceLocationResolved);
+
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(0);
+    connect(m_flushTimer, &QTimer::timeout, this, &ObjectListModel::flushPendingChanges);
 }
 
 QPair<int, QVariant> ObjectListModel::defaultSelectedItem() const
@@ -87,38 +97,117 @@ void ObjectListModel::objectAdded(QObject *obj)
     Q_ASSERT(obj);
     Q_ASSERT(Probe::instance()->isValidObject(obj));
 
-    auto it = std::lower_bound(m_objects.begin(), m_objects.end(), obj);
-    Q_ASSERT(it == m_objects.end() || *it != obj);
-
-    const int row = std::distance(m_objects.begin(), it);
-    Q_ASSERT(row >= 0 && row <= m_objects.size());
+    if (m_pendingRemovals.remove(obj)) {
+        // address got reused before we got to remove the old object, keep the row for the new one
+        const auto idx = indexForObject(obj);
+        emit dataChanged(idx, idx.sibling(idx.row(), columnCount() - 1));
+        return;
+    }
 
-    beginInsertRows(QModelIndex(), row, row);
-    m_objects.insert(it, obj);
-    Q_ASSERT(m_objects.at(row) == obj);
-    endInsertRows();
+    Q_ASSERT(!m_pendingAdditions.contains(obj));
+    Q_ASSERT(!std::binary_search(m_objects.constBegin(), m_objects.constEnd(), obj));
+    m_pendingAdditions.insert(obj);
+    m_flushTimer->start();
 }
 
 void ObjectListModel::objectRemoved(QObject *obj)
 {
     Q_ASSERT(thread() == QThread::currentThread());
 
-    auto it = std::lower_bound(m_objects.begin(), m_objects.end(), obj);
-    if (it == m_objects.end() || *it != obj) {
+    if (m_pendingAdditions.remove(obj))
+        return;
+
+    if (!std::binary_search(m_objects.constBegin(), m_objects.constEnd(), obj)) {
         // not found
         return;
     }
 
-    const int row = std::distance(m_objects.begin(), it);
-    Q_ASSERT(row >= 0 && row < m_objects.size());
-    Q_ASSERT(m_objects.at(row) == obj);
+    m_pendingRemovals.insert(obj);
+    m_flushTimer->start();
+}
+
+void ObjectListModel::objectCreationSourceLocationResolved(QObject *obj)
+{
+    const auto idx = indexForObject(obj);
+    if (idx.isValid())
+        emit dataChanged(idx, idx, QVector<int>() << ObjectModel::CreationLocationRole);
+}
+
+void ObjectListModel::flushPendingChanges()
+{
+    Q_ASSERT(thread() == QThread::currentThread());
+    m_flushTimer->stop();
+
+    removePendingObjects();
+    insertPendingObjects();
+}
+
+void ObjectListModel::removePendingObjects()
+{
+    if (m_pendingRemovals.isEmpty())
+        return;
+
+    QVector<int> rows;
+    rows.reserve(m_pendingRemovals.size());
+    for (QObject *obj : qAsConst(m_pendingRemovals)) {
+        const auto it = std::lower_bound(m_objects.constBegin(), m_objects.constEnd(), obj);
+        Q_ASSERT(it != m_objects.constEnd() && *it == obj);
+        rows.push_back(std::distance(m_objects.constBegin(), it));
+    }
+    m_pendingRemovals.clear();
+    std::sort(rows.begin(), rows.end());
+
+    // back to front, so the rows of the remaining ranges stay valid
+    for (int last = rows.size() - 1; last >= 0;) {
+        int first = last;
+        while (first > 0 && rows.at(first - 1) == rows.at(first) - 1)
+            --first;
+
+        beginRemoveRows(QModelIndex(), rows.at(first), rows.at(last));
+        m_objects.remove(rows.at(first), last - first + 1);
+        endRemoveRows();
+        last = first - 1;
+    }
+}
+
+void ObjectListModel::insertPendingObjects()
+{
+    if (m_pendingAdditions.isEmpty())
+        return;
 
-    beginRemoveRows(QModelIndex(), row, row);
-    m_objects.erase(it);
-    endRemoveRows();
+    QVector<QObject *> added;
+    added.reserve(m_pendingAdditions.size());
+    for (QObject *obj : qAsConst(m_pendingAdditions))
+        added.push_back(obj);
+    m_pendingAdditions.clear();
+    std::sort(added.begin(), added.end());
+
+    // back to front, new objects ending up between the same two existing ones form one range
+    for (int last = added.size() - 1; last >= 0;) {
+        const auto it = std::lower_bound(m_objects.constBegin(), m_objects.constEnd(), added.at(last));
+        const int row = std::distance(m_objects.constBegin(), it);
+        int first = last;
+        while (first > 0 && (row == 0 || m_objects.at(row - 1) < added.at(first - 1)))
+            --first;
+        const int count = last - first + 1;
+
+        beginInsertRows(QModelIndex(), row, row + count - 1);
+        m_objects.insert(row, count, nullptr);
+        std::copy(added.constBegin() + first, added.constBegin() + last + 1, m_objects.begin() + row);
+        endInsertRows();
+        last = first - 1;
+    }
 }
 
 const QVector<QObject *> &ObjectListModel::objects() const
 {
     return m_objects;
 }
+
+QModelIndex ObjectListModel::indexForObject(QObject *object) const
+{
+    const auto it = std::lower_bound(m_objects.constBegin(), m_objects.constEnd(), object);
+    if (it == m_objects.constEnd() || *it != object)
+        return QModelIndex();
+    return index(std::distance(m_objects.constBegin(), it), 0);
+}
@@ -35,6 +35,10 @@
 #include <QVector>
 #include <QSet>
 
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
 namespace GammaRay {
 class Probe;
 
@@ -48,6 +52,9 @@ class Probe;
  * So the solution: only call these methods in the main thread
  * and on remove. when called from a background thread, invalidate
  * the data first.
+ *
+ * Added and removed objects are collected and applied once per event loop pass,
+ * as a few notifications for contiguous row ranges rather than one per object.
  */
 class ObjectListModel : public ObjectModelBase<QAbstractTableModel>
 {
@@ -62,21 +69,33 @@ public:
 
     /*!
      * Returns a list of all objects.
+     * This does not contain objects added since the last flushPendingChanges() call yet.
      *
      * FIXME: This is a dirty hack. Instead of offering a getter to the internal data
      * here, we should move it out and only give the model a view of the data.
      */
     const QVector<QObject*> &objects() const;
 
+    /*! Returns the index of @p object, in O(log(n)). */
+    QModelIndex indexForObject(QObject *object) const;
+
+    /*! Applies added and removed objects right away, instead of on the next event loop pass. */
+    void flushPendingChanges();
+
 private slots:
     void objectAdded(QObject *obj);
     void objectRemoved(QObject *obj);
+    void objectCreationSourceLocationResolved(QObject *obj);
 
 private:
-    void removeObject(QObject *obj);
+    void removePendingObjects();
+    void insertPendingObjects();
 
     // sorted vector for stable iterators/indexes, esp. for the model methods
     QVector<QObject *> m_objects;
+    QSet<QObject *> m_pendingAdditions;
+    QSet<QObject *> m_pendingRemovals;
+    QTimer *m_flushTimer;
 };
 }
 
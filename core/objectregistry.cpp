@@ -0,0 +1,250 @@
+/*
+  objectregistry.cpp
+
+  This file is part of GammaRay, the Qt application inspection and
+  manipulation tool.
+
+  Copyright (C) 2019 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+
+  Licensees holding valid commercial KDAB GammaRay licenses may use this file in
+  accordance with GammaRay Commercial License Agreement provided with the Software.
+
+  Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "objectregistry.h"
+
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QMutex>
+#include <QVector>
+
+using namespace GammaRay;
+
+namespace {
+const int ShardBits = 6;
+const int ShardCount = 1 << ShardBits;
+const int InitialCapacity = 16;
+
+// marks a removed entry, probing has to continue past it
+const QObject *tombstone()
+{
+    return reinterpret_cast<const QObject *>(quintptr(1));
+}
+
+quintptr hashPointer(const QObject *obj)
+{
+    // Fibonacci hashing, the low bits of heap pointers carry next to no entropy
+    return (reinterpret_cast<quintptr>(obj) >> 3)
+           * static_cast<quintptr>(Q_UINT64_C(0x9E3779B97F4A7C15));
+}
+
+int shardIndex(quintptr hash)
+{
+    return static_cast<int>(hash >> (sizeof(quintptr) * 8 - ShardBits));
+}
+}
+
+struct ObjectRegistry::Table
+{
+    explicit Table(int capacity)
+        : mask(capacity - 1)
+        , slots(new QAtomicPointer<const QObject>[capacity])
+    {
+        Q_ASSERT((capacity & mask) == 0);
+    }
+
+    int capacity() const
+    {
+        return mask + 1;
+    }
+
+    // returns the first slot that is either empty or holds @p obj
+    int find(const QObject *obj, quintptr hash) const
+    {
+        for (int i = hash & mask;; i = (i + 1) & mask) {
+            const QObject *o = slots[i].loadAcquire();
+            if (!o || o == obj)
+                return i;
+        }
+    }
+
+    const int mask;
+    std::unique_ptr<QAtomicPointer<const QObject>[]> slots;
+};
+
+struct ObjectRegistry::Shard
+{
+    Shard()
+        : table(new Table(InitialCapacity))
+    {
+    }
+
+    ~Shard()
+    {
+        delete table.load();
+        qDeleteAll(retired);
+    }
+
+    QAtomicPointer<Table> table;
+    mutable QAtomicInt readers;
+
+    // everything below is only accessed with writeLock held
+    mutable QMutex writeLock;
+    int size = 0;
+    int used = 0; // size + tombstones, this has to stay below the table capacity
+    QVector<Table *> retired;
+};
+
+ObjectRegistry::ObjectRegistry()
+    : m_shards(new Shard[ShardCount])
+{
+}
+
+ObjectRegistry::~ObjectRegistry() = default;
+
+bool ObjectRegistry::contains(const QObject *obj) const
+{
+    if (!obj)
+        return false;
+
+    const auto hash = hashPointer(obj);
+    const Shard &shard = m_shards[shardIndex(hash)];
+    shard.readers.ref();
+    const Table *table = shard.table.loadAcquire();
+    const bool found = table->slots[table->find(obj, hash)].loadAcquire() == obj;
+    shard.readers.deref();
+    return found;
+}
+
+bool ObjectRegistry::insert(const QObject *obj)
+{
+    Q_ASSERT(obj && obj != tombstone());
+
+    const auto hash = hashPointer(obj);
+    Shard &shard = m_shards[shardIndex(hash)];
+    QMutexLocker lock(&shard.writeLock);
+    reclaimRetiredTables(shard);
+
+    Table *table = shard.table.load();
+    int freeSlot = -1;
+    int i = hash & table->mask;
+    for (;; i = (i + 1) & table->mask) {
+        const QObject *o = table->slots[i].load();
+        if (o == obj)
+            return false;
+        if (!o)
+            break;
+        if (o == tombstone() && freeSlot < 0)
+            freeSlot = i;
+    }
+
+    if (freeSlot < 0) {
+        // we are about to consume an empty slot, keep the load factor below 1/2
+        if ((shard.used + 1) * 2 > table->capacity()) {
+            rehash(shard, shard.size + 1);
+            table = shard.table.load();
+            i = table->find(obj, hash);
+        }
+        ++shard.used;
+        freeSlot = i;
+    }
+
+    table->slots[freeSlot].storeRelease(obj);
+    ++shard.size;
+    return true;
+}
+
+bool ObjectRegistry::remove(const QObject *obj)
+{
+    if (!obj)
+        return false;
+
+    const auto hash = hashPointer(obj);
+    Shard &shard = m_shards[shardIndex(hash)];
+    QMutexLocker lock(&shard.writeLock);
+    reclaimRetiredTables(shard);
+
+    Table *table = shard.table.load();
+    const int i = table->find(obj, hash);
+    if (table->slots[i].load() != obj)
+        return false;
+
+    // concurrent lookups for other objects might currently be probing past this slot
+    table->slots[i].storeRelease(tombstone());
+    --shard.size;
+    return true;
+}
+
+int ObjectRegistry::size() const
+{
+    int size = 0;
+    for (int i = 0; i < ShardCount; ++i) {
+        QMutexLocker lock(&m_shards[i].writeLock);
+        size += m_shards[i].size;
+    }
+    return size;
+}
+
+void ObjectRegistry::clear()
+{
+    for (int i = 0; i < ShardCount; ++i) {
+        Shard &shard = m_shards[i];
+        QMutexLocker lock(&shard.writeLock);
+        shard.retired.push_back(shard.table.fetchAndStoreOrdered(new Table(InitialCapacity)));
+        shard.size = 0;
+        shard.used = 0;
+        reclaimRetiredTables(shard);
+    }
+}
+
+// pre-condition: shard write lock is held
+void ObjectRegistry::rehash(Shard &shard, int minimumSize)
+{
+    int capacity = InitialCapacity;
+    while (capacity < minimumSize * 4)
+        capacity *= 2;
+
+    const Table *oldTable = shard.table.load();
+    auto newTable = new Table(capacity);
+    for (int i = 0; i < oldTable->capacity(); ++i) {
+        const QObject *o = oldTable->slots[i].load();
+        if (!o || o == tombstone())
+            continue;
+        newTable->slots[newTable->find(o, hashPointer(o))].store(o);
+    }
+    shard.used = shard.size;
+
+    // lookups that started before this still see the old table, which therefore
+    // has to stay alive until we know there are no more readers on this shard
+    shard.retired.push_back(shard.table.fetchAndStoreOrdered(newTable));
+    reclaimRetiredTables(shard);
+}
+
+// pre-condition: shard write lock is held
+void ObjectRegistry::reclaimRetiredTables(Shard &shard)
+{
+    if (shard.retired.isEmpty())
+        return;
+
+    // the table pointer exchange above is ordered, so anyone not yet accounted
+    // for in the reader count will pick up the new table
+    if (shard.readers.fetchAndAddOrdered(0) != 0)
+        return;
+
+    qDeleteAll(shard.retired);
+    shard.retired.clear();
+}
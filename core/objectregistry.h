@@ -0,0 +1,82 @@
+/*
+  objectregistry.h
+
+  This file is part of GammaRay, the Qt application inspection and
+  manipulation tool.
+
+  Copyright (C) 2019 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+
+  Licensees holding valid commercial KDAB GammaRay licenses may use this file in
+  accordance with GammaRay Commercial License Agreement provided with the Software.
+
+  Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GAMMARAY_OBJECTREGISTRY_H
+#define GAMMARAY_OBJECTREGISTRY_H
+
+#include <QtGlobal>
+
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+class QObject;
+QT_END_NAMESPACE
+
+namespace GammaRay {
+
+/**
+ * Set of QObject pointers, optimized for concurrent lookups.
+ *
+ * The set is split into a fixed number of shards selected by the pointer hash,
+ * each shard being an open-addressing hash table. Lookups never block, they only
+ * announce themselves in a per-shard reader counter so that a table replaced by
+ * a rehash is not freed while still being probed. Modifications are serialized
+ * per shard, so writers on different shards do not contend either.
+ *
+ * @note This only tracks pointer values, it does not make it safe to dereference
+ * a contained object on its own.
+ */
+class ObjectRegistry
+{
+public:
+    ObjectRegistry();
+    ~ObjectRegistry();
+
+    /** Returns @c true if @p obj is contained. Lock-free, usable from any thread. */
+    bool contains(const QObject *obj) const;
+    /** Adds @p obj, returns @c false if it was contained already. */
+    bool insert(const QObject *obj);
+    /** Removes @p obj, returns @c false if it was not contained. */
+    bool remove(const QObject *obj);
+
+    /** Number of contained objects. */
+    int size() const;
+    void clear();
+
+private:
+    Q_DISABLE_COPY(ObjectRegistry)
+    struct Table;
+    struct Shard;
+
+    static void rehash(Shard &shard, int minimumSize);
+    static void reclaimRetiredTables(Shard &shard);
+
+    std::unique_ptr<Shard[]> m_shards;
+};
+}
+
+#endif // GAMMARAY_OBJECTREGISTRY_H
@@ -35,7 +35,6 @@
 #include <QThread>
 #include <QCoreApplication>
 
-#include <algorithm>
 #include <iostream>
 
 #define IF_DEBUG(x)
@@ -54,6 +53,8 @@ ObjectTreeModel::ObjectTreeModel(Probe *probe)
             this, &ObjectTreeModel::objectRemoved);
     connect(probe, &Probe::objectReparented,
             this, &ObjectTreeModel::objectReparented);
+    connect(probe, &Probe::objectCreationSourceLocationResolved,
+            this, &ObjectTreeModel::objectCreationSourceLocationResolved);
 }
 
 QPair<int, QVariant> ObjectTreeModel::defaultSelectedItem() const
@@ -102,13 +103,12 @@ void ObjectTreeModel::objectAdded(QObject *obj)
     // either we get a proper parent and hence valid index or there is no parent
     Q_ASSERT(index.isValid() || !parentObject(obj));
 
-    QVector<QObject *> &children = m_parentChildMap[ parentObject(obj) ];
-    auto it = std::lower_bound(children.begin(), children.end(), obj);
-    const int row = std::distance(children.begin(), it);
+    SortedObjectSet &children = m_parentChildMap[ parentObject(obj) ];
+    const int row = children.lowerBound(obj);
 
     beginInsertRows(index, row, row);
 
-    children.insert(it, obj);
+    children.insert(obj);
     m_childParentMap.insert(obj, parentObject(obj));
 
     endInsertRows();
@@ -137,16 +137,15 @@ void ObjectTreeModel::objectRemoved(QObject *obj)
     if (parentObj && !parentIndex.isValid())
         return;
 
-    QVector<QObject *> &siblings = m_parentChildMap[ parentObj ];
+    SortedObjectSet &siblings = m_parentChildMap[ parentObj ];
 
-    auto it = std::lower_bound(siblings.begin(), siblings.end(), obj);
-    if (it == siblings.end() || *it != obj)
+    const int row = siblings.indexOf(obj);
+    if (row < 0)
         return;
-    const int row = std::distance(siblings.begin(), it);
 
     beginRemoveRows(parentIndex, row, row);
 
-    siblings.erase(it);
+    siblings.remove(obj);
     m_childParentMap.remove(obj);
     m_parentChildMap.remove(obj);
 
@@ -178,12 +177,10 @@ void ObjectTreeModel::objectReparented(QObject *obj)
     if ((oldParent && !sourceParent.isValid()) || (oldParent == parentObject(obj)))
         return;
 
-    QVector<QObject *> &oldSiblings = m_parentChildMap[oldParent];
-    auto oldIt = std::lower_bound(oldSiblings.begin(),
-                                                          oldSiblings.end(), obj);
-    if (oldIt == oldSiblings.end() || *oldIt != obj)
+    SortedObjectSet &oldSiblings = m_parentChildMap[oldParent];
+    const int sourceRow = oldSiblings.indexOf(obj);
+    if (sourceRow < 0)
         return;
-    const int sourceRow = std::distance(oldSiblings.begin(), oldIt);
 
     IF_DEBUG(cout << "actually reparenting! " << hex << obj << " old parent: " << oldParent << " new parent: " << parentObject(
                  obj) << dec << endl;
@@ -191,14 +188,12 @@ void ObjectTreeModel::objectReparented(QObject *obj)
     const auto destParent = indexForObject(parentObject(obj));
     Q_ASSERT(destParent.isValid() || !parentObject(obj));
 
-    QVector<QObject *> &newSiblings = m_parentChildMap[parentObject(obj)];
-    auto newIt = std::lower_bound(newSiblings.begin(),
-                                                          newSiblings.end(), obj);
-    const int destRow = std::distance(newSiblings.begin(), newIt);
+    SortedObjectSet &newSiblings = m_parentChildMap[parentObject(obj)];
+    const int destRow = newSiblings.lowerBound(obj);
 
     beginMoveRows(sourceParent, sourceRow, sourceRow, destParent, destRow);
-    oldSiblings.erase(oldIt);
-    newSiblings.insert(newIt, obj);
+    oldSiblings.remove(obj);
+    newSiblings.insert(obj);
     m_childParentMap.insert(obj, parentObject(obj));
     endMoveRows();
 }
@@ -228,7 +223,8 @@ int ObjectTreeModel::rowCount(const QModelIndex &parent) const
     if (parent.column() == 1)
         return 0;
     QObject *parentObj = reinterpret_cast<QObject *>(parent.internalPointer());
-    return m_parentChildMap.value(parentObj).size();
+    const auto it = m_parentChildMap.constFind(parentObj);
+    return it == m_parentChildMap.constEnd() ? 0 : it.value().size();
 }
 
 QModelIndex ObjectTreeModel::parent(const QModelIndex &child) const
@@ -240,12 +236,22 @@ QModelIndex ObjectTreeModel::parent(const QModelIndex &child) const
 QModelIndex ObjectTreeModel::index(int row, int column, const QModelIndex &parent) const
 {
     QObject *parentObj = reinterpret_cast<QObject *>(parent.internalPointer());
-    const QVector<QObject *> children = m_parentChildMap.value(parentObj);
+    const auto it = m_parentChildMap.constFind(parentObj);
+    if (it == m_parentChildMap.constEnd())
+        return {};
+    const SortedObjectSet &children = it.value();
     if (row < 0 || column < 0 || row >= children.size() || column >= columnCount())
         return {};
     return createIndex(row, column, children.at(row));
 }
 
+void ObjectTreeModel::objectCreationSourceLocationResolved(QObject *obj)
+{
+    const auto index = indexForObject(obj);
+    if (index.isValid())
+        emit dataChanged(index, index, QVector<int>() << ObjectModel::CreationLocationRole);
+}
+
 QModelIndex ObjectTreeModel::indexForObject(QObject *object) const
 {
     if (!object)
@@ -254,11 +260,11 @@ QModelIndex ObjectTreeModel::indexForObject(QObject *object) const
     const QModelIndex parentIndex = indexForObject(parent);
     if (!parentIndex.isValid() && parent)
         return QModelIndex();
-    const QVector<QObject *> &siblings = m_parentChildMap[ parent ];
-    auto it = std::lower_bound(siblings.constBegin(), siblings.constEnd(), object);
-    if (it == siblings.constEnd() || *it != object)
+    const auto it = m_parentChildMap.constFind(parent);
+    if (it == m_parentChildMap.constEnd())
         return QModelIndex();
-
-    const int row = std::distance(siblings.constBegin(), it);
-    return index(row, 0, parentIndex);
+    const int row = it.value().indexOf(object);
+    if (row < 0)
+        return QModelIndex();
+    return createIndex(row, 0, object);
 }
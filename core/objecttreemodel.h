@@ -30,8 +30,9 @@
 #define GAMMARAY_OBJECTTREEMODEL_H
 
 #include "objectmodelbase.h"
+#include "sortedobjectset.h"
 
-#include <QVector>
+#include <QHash>
 
 namespace GammaRay {
 class Probe;
@@ -50,17 +51,18 @@ public:
 
     Q_INVOKABLE QPair<int, QVariant> defaultSelectedItem() const;
 
+    /*! Returns the index of @p object, in O(depth * log(siblings)). */
+    QModelIndex indexForObject(QObject *object) const;
+
 private slots:
     void objectAdded(QObject *obj);
     void objectRemoved(QObject *obj);
     void objectReparented(QObject *obj);
-
-private:
-    QModelIndex indexForObject(QObject *object) const;
+    void objectCreationSourceLocationResolved(QObject *obj);
 
 private:
     QHash<QObject *, QObject *> m_childParentMap;
-    QHash<QObject *, QVector<QObject *> > m_parentChildMap;
+    QHash<QObject *, SortedObjectSet> m_parentChildMap;
 };
 }
 
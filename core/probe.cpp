@@ -36,10 +36,12 @@
 #include "classesiconsrepositoryserver.h"
 #include "metaobjectrepository.h"
 #include "objectlistmodel.h"
+#include "objectregistry.h"
 #include "objecttreemodel.h"
 #include "probesettings.h"
 #include "probecontroller.h"
 #include "problemcollector.h"
+#include "stacktracestore.h"
 #include "toolmanager.h"
 #include "toolpluginmodel.h"
 #include "util.h"
@@ -53,6 +55,8 @@
 #include "toolpluginerrormodel.h"
 #include "probeguard.h"
 
+#include <common/modelevent.h>
+#include <common/modelutils.h>
 #include <common/objectbroker.h>
 #include <common/streamoperators.h>
 #include <common/paths.h>
@@ -62,15 +66,18 @@
 #include <QGuiApplication>
 #include <QWindow>
 #include <QDir>
+#include <QAbstractProxyModel>
 #include <QLibrary>
 #include <QMouseEvent>
 #include <QUrl>
 #include <QThread>
+#include <QThreadStorage>
 #include <QTimer>
 #include <private/qobject_p.h>
 #include <algorithm>
 #include <iostream>
 #include <cstdio>
+#include <memory>
 
 #define IF_DEBUG(x)
 
@@ -86,16 +93,49 @@ using namespace std;
 QAtomicPointer<Probe> Probe::s_instance = QAtomicPointer<Probe>(nullptr);
 
 namespace GammaRay {
+// callbacks per kind, computed once when registering a callback set
+// immutable once published, as signal spy callbacks can run concurrently in any thread
+struct SignalSpyDispatchTable
+{
+    template<typename Callback>
+    struct SignalCallbacks
+    {
+        bool operator==(const SignalCallbacks &other) const
+        {
+            return signalIndex == other.signalIndex && methodIndex == other.methodIndex;
+        }
+
+        QVector<Callback> signalIndex; // as provided by Qt
+        QVector<Callback> methodIndex;
+    };
+
+    bool operator==(const SignalSpyDispatchTable &other) const
+    {
+        return signalBegin == other.signalBegin && signalEnd == other.signalEnd
+               && slotBegin == other.slotBegin && slotEnd == other.slotEnd;
+    }
+
+    SignalCallbacks<SignalSpyCallbackSet::BeginCallback> signalBegin;
+    SignalCallbacks<SignalSpyCallbackSet::EndCallback> signalEnd;
+    QVector<SignalSpyCallbackSet::BeginCallback> slotBegin;
+    QVector<SignalSpyCallbackSet::EndCallback> slotEnd;
+};
+
 static void signal_begin_callback(QObject *caller, int method_index, void **argv)
 {
     if (method_index == 0 || Probe::instance()->filterObject(caller))
         return;
 
-    method_index = Util::signalIndexToMethodIndex(caller->metaObject(), method_index);
-    Probe::executeSignalCallback([=](const SignalSpyCallbackSet &callbacks) {
-            if (callbacks.signalBeginCallback)
-                callbacks.signalBeginCallback(caller, method_index, argv);
-        });
+    const auto &callbacks = Probe::signalSpyDispatchTable()->signalBegin;
+    // map before calling anything, the callbacks are free to modify the caller
+    const int signal_index = method_index;
+    if (!callbacks.methodIndex.isEmpty())
+        method_index = Util::signalIndexToMethodIndex(caller->metaObject(), signal_index);
+
+    for (auto callback : callbacks.signalIndex)
+        callback(caller, signal_index, argv);
+    for (auto callback : callbacks.methodIndex)
+        callback(caller, method_index, argv);
 }
 
 static void signal_end_callback(QObject *caller, int method_index)
@@ -103,16 +143,18 @@ static void signal_end_callback(QObject *caller, int method_index)
     if (method_index == 0)
         return;
 
-    QMutexLocker locker(Probe::objectLock());
     if (!Probe::instance()->isValidObject(caller)) // implies filterObject()
         return; // deleted in the slot
-    locker.unlock();
 
-    method_index = Util::signalIndexToMethodIndex(caller->metaObject(), method_index);
-    Probe::executeSignalCallback([=](const SignalSpyCallbackSet &callbacks) {
-            if (callbacks.signalEndCallback)
-                callbacks.signalEndCallback(caller, method_index);
-        });
+    const auto &callbacks = Probe::signalSpyDispatchTable()->signalEnd;
+    const int signal_index = method_index;
+    if (!callbacks.methodIndex.isEmpty())
+        method_index = Util::signalIndexToMethodIndex(caller->metaObject(), signal_index);
+
+    for (auto callback : callbacks.signalIndex)
+        callback(caller, signal_index);
+    for (auto callback : callbacks.methodIndex)
+        callback(caller, method_index);
 }
 
 static void slot_begin_callback(QObject *caller, int method_index, void **argv)
@@ -120,10 +162,8 @@ static void slot_begin_callback(QObject *caller, int method_index, void **argv)
     if (method_index == 0 || Probe::instance()->filterObject(caller))
         return;
 
-    Probe::executeSignalCallback([=](const SignalSpyCallbackSet &callbacks) {
-            if (callbacks.slotBeginCallback)
-                callbacks.slotBeginCallback(caller, method_index, argv);
-        });
+    for (auto callback : Probe::signalSpyDispatchTable()->slotBegin)
+        callback(caller, method_index, argv);
 }
 
 static void slot_end_callback(QObject *caller, int method_index)
@@ -131,15 +171,11 @@ static void slot_end_callback(QObject *caller, int method_index)
     if (method_index == 0)
         return;
 
-    QMutexLocker locker(Probe::objectLock());
     if (!Probe::instance()->isValidObject(caller)) // implies filterObject()
         return; // deleted in the slot
-    locker.unlock();
 
-    Probe::executeSignalCallback([=](const SignalSpyCallbackSet &callbacks) {
-            if (callbacks.slotEndCallback)
-                callbacks.slotEndCallback(caller, method_index);
-        });
+    for (auto callback : Probe::signalSpyDispatchTable()->slotEnd)
+        callback(caller, method_index);
 }
 
 static QItemSelectionModel *selectionModelFactory(QAbstractItemModel *model)
@@ -169,6 +205,15 @@ void dumpObject(QObject *obj)
     cout.flags(oldFlags);
 }
 
+// objects created from the ctor in a thread other than the probe thread, not yet known to the probe
+struct StagedObjectCreations
+{
+    QMutex lock;
+    QVector<QObject *> objects; // entries of objects destroyed meanwhile are set to nullptr
+    QHash<const QObject *, int> positions;
+    QHash<QObject *, Execution::Trace> traces;
+};
+
 struct Listener
 {
     Listener() = default;
@@ -176,10 +221,15 @@ struct Listener
     bool trackDestroyed = true;
     QVector<QObject *> addedBeforeProbeInstance;
 
-    QHash<QObject*, Execution::Trace> constructionBacktracesForObjects;
+    StackTraceStore constructionBacktracesForObjects;
+
+    // staging buffers of all threads, these can outlive their thread until drained
+    QMutex stagedObjectCreationsLock;
+    QVector<std::shared_ptr<StagedObjectCreations> > stagedObjectCreations;
 };
 
 Q_GLOBAL_STATIC(Listener, s_listener)
+Q_GLOBAL_STATIC(QThreadStorage<std::shared_ptr<StagedObjectCreations> >, s_localStagedObjectCreations)
 
 // ensures proper information is returned by isValidObject by
 // locking it in objectAdded/Removed
@@ -190,7 +240,9 @@ Probe::Probe(QObject *parent)
     , m_objectListModel(new ObjectListModel(this))
     , m_objectTreeModel(new ObjectTreeModel(this))
     , m_window(nullptr)
+    , m_validObjects(new ObjectRegistry)
     , m_metaObjectRegistry(new MetaObjectRegistry(this))
+    , m_filterVerdictsEnabled(false)
     , m_queueTimer(new QTimer(this))
     , m_server(nullptr)
 {
@@ -200,6 +252,12 @@ Probe::Probe(QObject *parent)
     StreamOperators::registerOperators();
     ProbeSettings::receiveSettings();
 
+    {
+        const auto budget = ProbeSettings::value(QStringLiteral("StackTraceMemoryBudget"), 16 * 1024).toInt();
+        QMutexLocker lock(s_lock());
+        s_listener()->constructionBacktracesForObjects.setMemoryBudget(qint64(budget) * 1024);
+    }
+
     m_server = new Server(this);
 
     ObjectBroker::setSelectionModelFactoryCallback(selectionModelFactory);
@@ -240,7 +298,9 @@ Probe::Probe(QObject *parent)
             = signal_spy_set->slot_begin_callback;
         m_previousSignalSpyCallbackSet.slotEndCallback
             = signal_spy_set->slot_end_callback;
-        registerSignalSpyCallbackSet(m_previousSignalSpyCallbackSet); // daisy-chain existing callbacks
+        // daisy-chain existing callbacks, those expect the indexes as Qt provides them
+        m_previousSignalSpyCallbackSet.rawSignalIndexes = true;
+        registerSignalSpyCallbackSet(m_previousSignalSpyCallbackSet);
     }
 
     connect(this, &Probe::objectCreated, m_metaObjectRegistry, &MetaObjectRegistry::objectAdded);
@@ -265,6 +325,16 @@ Probe::~Probe()
     qt_register_signal_spy_callbacks(prevCallbacks);
 #endif
 
+    if (!s_listener.isDestroyed()) {
+        QMutexLocker lock(&s_listener()->stagedObjectCreationsLock);
+        for (const auto &staged : qAsConst(s_listener()->stagedObjectCreations)) {
+            QMutexLocker stagedLock(&staged->lock);
+            staged->objects.clear();
+            staged->positions.clear();
+            staged->traces.clear();
+        }
+    }
+
     ObjectBroker::clear();
     ProbeSettings::resetLauncherIdentifier();
     MetaObjectRepository::instance()->clear();
@@ -276,6 +346,7 @@ Probe::~Probe()
 void Probe::setWindow(QObject *window)
 {
     m_window = window;
+    m_filterVerdicts.clear();
 }
 
 QObject *Probe::window() const
@@ -378,6 +449,9 @@ void Probe::startupHookReceived()
 void Probe::delayedInit()
 {
     QCoreApplication::instance()->installEventFilter(this);
+    // from now on we see all reparenting, and unless we attached at runtime also all destruction,
+    // which is what is needed to keep filterObject() results up to date
+    m_filterVerdictsEnabled = !needsObjectDiscovery();
 
     QString appName = qApp->applicationName();
     if (appName.isEmpty() && !qApp->arguments().isEmpty()) {
@@ -464,9 +538,22 @@ bool Probe::filterObject(QObject *obj) const
         return false;
     }
 
+    // objects of our thread can still emit signals from elsewhere, the cache is not synchronized
+    const bool useCache = m_filterVerdictsEnabled && QThread::currentThread() == thread();
+    if (useCache) {
+        if (m_filterVerdictsOutdated.loadAcquire()) {
+            m_filterVerdicts.clear();
+            m_filterVerdictsOutdated.storeRelease(0);
+        }
+        const auto it = m_filterVerdicts.constFind(obj);
+        if (it != m_filterVerdicts.constEnd())
+            return it.value();
+    }
+
     QSet<QObject *> visitedObjects;
     int iteration = 0;
     QObject *o = obj;
+    bool filtered = false;
     do {
         if (iteration > 100) {
             // Probably we have a loop in the tree. Do loop detection.
@@ -481,11 +568,44 @@ bool Probe::filterObject(QObject *obj) const
         }
         ++iteration;
 
-        if (o == this || o == window())
-            return true;
+        if (o == this || o == window()) {
+            filtered = true;
+            break;
+        }
         o = o->parent();
+
+        // the first ancestor we know about decides for the rest of the chain
+        if (o && useCache) {
+            const auto it = m_filterVerdicts.constFind(o);
+            if (it != m_filterVerdicts.constEnd()) {
+                filtered = it.value();
+                break;
+            }
+        }
     } while (o);
-    return false;
+
+    if (useCache)
+        m_filterVerdicts.insert(obj, filtered);
+    return filtered;
+}
+
+// pre-condition: arbitrary thread
+void Probe::invalidateFilterVerdicts(QObject *obj)
+{
+    if (!m_filterVerdictsEnabled || obj->thread() != thread())
+        return; // never cached, see filterObject()
+
+    if (QThread::currentThread() != thread()) {
+        // an object deleted from outside its thread, let filterObject() sort this out on our side
+        m_filterVerdictsOutdated.storeRelease(1);
+        return;
+    }
+
+    // reparenting changes the verdict for the entire subtree
+    if (obj->children().isEmpty())
+        m_filterVerdicts.remove(obj);
+    else
+        m_filterVerdicts.clear();
 }
 
 void Probe::registerModel(const QString &objectName, QAbstractItemModel *model)
@@ -510,6 +630,22 @@ QAbstractItemModel *Probe::objectTreeModel() const
     return m_objectTreeModel;
 }
 
+QModelIndex Probe::indexForObject(QObject *object, const QAbstractItemModel *model) const
+{
+    // server-side proxies only connect to their source once in use
+    Model::used(model);
+
+    const QAbstractItemModel *sourceModel = model;
+    while (auto proxy = qobject_cast<const QAbstractProxyModel *>(sourceModel))
+        sourceModel = proxy->sourceModel();
+
+    if (sourceModel == m_objectTreeModel)
+        return ModelUtils::mapFromSource(model, m_objectTreeModel->indexForObject(object));
+    if (sourceModel == m_objectListModel)
+        return ModelUtils::mapFromSource(model, m_objectListModel->indexForObject(object));
+    return QModelIndex();
+}
+
 ProblemCollector *Probe::problemCollector() const
 {
     return m_problemCollector;
@@ -517,9 +653,7 @@ ProblemCollector *Probe::problemCollector() const
 
 bool Probe::isValidObject(const QObject *obj) const
 {
-    ///TODO: can we somehow assert(s_lock().isLocked()) ?!
-    ///  -> Not with a recursive mutex. Make it non-recursive, and you can do Q_ASSERT(!s_lock().tryLock());
-    return m_validObjects.contains(obj);
+    return m_validObjects->contains(obj);
 }
 
 QMutex *Probe::objectLock()
@@ -536,7 +670,7 @@ QMutex *Probe::objectLock()
  * - emit objectCreated right away
  * (3) other thread, from ctor:
  * - wait until next event-loop re-entry in other thread (FIXME: we do not currently do this!!)
- * - post information to our thread
+ * - stage in a per-thread buffer, drained in bulk by our thread (see stageCreatedObject())
  * (4) other thread, after ctor:
  * - post information to our thread
  * - emit objectCreated there right away if object still valid
@@ -545,8 +679,6 @@ QMutex *Probe::objectLock()
  */
 void Probe::objectAdded(QObject *obj, bool fromCtor)
 {
-    QMutexLocker lock(s_lock());
-
     // attempt to ignore objects created by GammaRay itself, especially short-lived ones
     if (fromCtor && ProbeGuard::insideProbe() && obj->thread() == QThread::currentThread())
         return;
@@ -555,6 +687,14 @@ void Probe::objectAdded(QObject *obj, bool fromCtor)
     if (s_listener.isDestroyed())
         return;
 
+    // case (3), this does not need the object lock
+    if (fromCtor && isInitialized() && instance()->thread() != QThread::currentThread()) {
+        instance()->stageCreatedObject(obj);
+        return;
+    }
+
+    QMutexLocker lock(s_lock());
+
 
     if (Execution::hasFastStackTrace() && fromCtor) {
         s_listener()->constructionBacktracesForObjects.insert(obj, Execution::stackTrace(32, 2)); // skip 2: this and the hook function calling us
@@ -579,7 +719,7 @@ void Probe::objectAdded(QObject *obj, bool fromCtor)
         return;
     }
 
-    if (instance()->m_validObjects.contains(obj)) {
+    if (instance()->m_validObjects->contains(obj)) {
         // this happens when we get a child event before the objectAdded call from the ctor
         // or when we add an item from addedBeforeProbeInstance who got added already
         // due to the add-parent-before-child logic
@@ -592,11 +732,11 @@ void Probe::objectAdded(QObject *obj, bool fromCtor)
     }
 
     // make sure we already know the parent
-    if (obj->parent() && !instance()->m_validObjects.contains(obj->parent()))
+    if (obj->parent() && !instance()->m_validObjects->contains(obj->parent()))
         objectAdded(obj->parent(), fromCtor);
-    Q_ASSERT(!obj->parent() || instance()->m_validObjects.contains(obj->parent()));
+    Q_ASSERT(!obj->parent() || instance()->m_validObjects->contains(obj->parent()));
 
-    instance()->m_validObjects << obj;
+    instance()->m_validObjects->insert(obj);
 
     if (!fromCtor && obj->parent() && instance()->isObjectCreationQueued(obj->parent())) {
         // when a child event triggers a call to objectAdded while inside the ctor
@@ -627,8 +767,13 @@ void Probe::processQueuedObjectChanges()
     // must be called from the main thread via timeout
     Q_ASSERT(QThread::currentThread() == thread());
 
-    const auto queuedObjectChanges = m_queuedObjectChanges; // copy, in case this gets modified while we iterate (which can actually happen)
-    for (const auto &change : queuedObjectChanges) {
+    drainStagedObjectCreations();
+
+    // this can get modified while we iterate (which can actually happen), so use indexes and copy the entries
+    for (int i = 0; i < m_queuedObjectChanges.size(); ++i) {
+        const auto change = m_queuedObjectChanges.at(i);
+        if (!change.obj) // purged
+            continue;
         switch (change.type) {
         case ObjectChange::Create:
             objectFullyConstructed(change.obj);
@@ -643,6 +788,10 @@ void Probe::processQueuedObjectChanges()
              )
 
     m_queuedObjectChanges.clear();
+    m_queuedObjectCreations.clear();
+
+    // apply this batch to the object list in as few steps as possible
+    m_objectListModel->flushPendingChanges();
 
     for (QObject *obj : qAsConst(m_pendingReparents)) {
         if (!isValidObject(obj))
@@ -660,7 +809,7 @@ void Probe::objectFullyConstructed(QObject *obj)
 {
     Q_ASSERT(thread() == QThread::currentThread());
 
-    if (!m_validObjects.contains(obj)) {
+    if (!m_validObjects->contains(obj)) {
         // deleted already
         IF_DEBUG(cout << "stale fully constructed: " << hex << obj << endl;
                  )
@@ -671,7 +820,7 @@ void Probe::objectFullyConstructed(QObject *obj)
         // when the call was delayed from the ctor construction,
         // the parent might not have been set properly yet. hence
         // apply the filter again
-        m_validObjects.remove(obj);
+        m_validObjects->remove(obj);
         IF_DEBUG(cout << "now filtered fully constructed: " << hex << obj << endl;
                  )
         return;
@@ -682,12 +831,12 @@ void Probe::objectFullyConstructed(QObject *obj)
 
     // ensure we know all our ancestors already
     for (QObject *parent = obj->parent(); parent; parent = parent->parent()) {
-        if (!m_validObjects.contains(parent)) {
+        if (!m_validObjects->contains(parent)) {
             objectAdded(parent); // will also handle any further ancestors
             break;
         }
     }
-    Q_ASSERT(!obj->parent() || m_validObjects.contains(obj->parent()));
+    Q_ASSERT(!obj->parent() || m_validObjects->contains(obj->parent()));
 
     m_toolManager->objectAdded(obj);
     emit objectCreated(obj);
@@ -704,6 +853,10 @@ void Probe::objectFullyConstructed(QObject *obj)
  */
 void Probe::objectRemoved(QObject *obj)
 {
+    // short-lived objects from other threads usually never leave the staging buffer
+    if (isInitialized() && instance()->unstageCreatedObject(obj))
+        return;
+
     QMutexLocker lock(s_lock());
 
     if (!isInitialized()) {
@@ -716,6 +869,7 @@ void Probe::objectRemoved(QObject *obj)
         if (!s_listener())
             return;
 
+        s_listener()->constructionBacktracesForObjects.remove(obj);
         QVector<QObject *> &addedBefore = s_listener()->addedBeforeProbeInstance;
         for (auto it = addedBefore.begin(); it != addedBefore.end();) {
             if (*it == obj)
@@ -729,7 +883,16 @@ void Probe::objectRemoved(QObject *obj)
     IF_DEBUG(cout << "object removed:" << hex << obj << " " << obj->parent() << endl;
              )
 
-    bool success = instance()->m_validObjects.remove(obj);
+    // also for untracked objects, the address might get reused
+    instance()->invalidateFilterVerdicts(obj);
+
+    // the object might still be staged by another thread, e.g. when deleted after that thread finished
+    instance()->drainStagedObjectCreations();
+
+    // also for untracked objects, traces are recorded before filtering
+    s_listener()->constructionBacktracesForObjects.remove(obj);
+
+    bool success = instance()->m_validObjects->remove(obj);
     if (!success) {
         // object was not tracked by the probe, probably a gammaray object
         EXPENSIVE_ASSERT(!instance()->isObjectCreationQueued(obj));
@@ -758,10 +921,119 @@ void Probe::queueCreatedObject(QObject *obj)
     ObjectChange c;
     c.obj = obj;
     c.type = ObjectChange::Create;
+    m_queuedObjectCreations.insert(obj, m_queuedObjectChanges.size());
     m_queuedObjectChanges.push_back(c);
     notifyQueuedObjectChanges();
 }
 
+/*
+ * Objects created in other threads are collected in a per-thread buffer first,
+ * without holding the object lock. They are moved to the regular queue in bulk
+ * from drainStagedObjectCreations(), or dropped again if they are destroyed
+ * before that. Ancestors are staged first, so the parent-before-child order is
+ * retained.
+ *
+ * pre-condition: lock may or may not be held already, thread other than ours, from ctor
+ */
+void Probe::stageCreatedObject(QObject *obj)
+{
+    Q_ASSERT(QThread::currentThread() != thread());
+
+    if (m_validObjects->contains(obj))
+        return;
+
+    // the parent lives in this thread as well (if it is set already)
+    if (obj->parent() && !m_validObjects->contains(obj->parent()))
+        stageCreatedObject(obj->parent());
+    m_validObjects->insert(obj);
+
+    IF_DEBUG(cout << "objectAdded Staged: " << hex << obj << endl;)
+
+    auto &staged = s_localStagedObjectCreations()->localData();
+    if (!staged) {
+        staged = std::make_shared<StagedObjectCreations>();
+        QMutexLocker lock(&s_listener()->stagedObjectCreationsLock);
+        s_listener()->stagedObjectCreations.push_back(staged);
+    }
+
+    {
+        QMutexLocker lock(&staged->lock);
+        staged->positions.insert(obj, staged->objects.size());
+        staged->objects.push_back(obj);
+        if (Execution::hasFastStackTrace())
+            staged->traces.insert(obj, Execution::stackTrace(32, 3)); // skip 3: this, objectAdded and the hook function calling us
+    }
+
+    // one notification per drain is enough
+    if (m_objectCreationsStaged.testAndSetOrdered(0, 1))
+        startQueueTimer();
+}
+
+// pre-condition: lock may or may not be held already, arbitrary thread
+bool Probe::unstageCreatedObject(QObject *obj)
+{
+    if (s_localStagedObjectCreations.isDestroyed() || !s_localStagedObjectCreations()->hasLocalData())
+        return false;
+
+    const auto &staged = s_localStagedObjectCreations()->localData();
+    {
+        QMutexLocker lock(&staged->lock);
+        const auto it = staged->positions.find(obj);
+        if (it == staged->positions.end())
+            return false;
+        staged->objects[it.value()] = nullptr;
+        staged->positions.erase(it);
+        staged->traces.remove(obj);
+    }
+
+    IF_DEBUG(cout << "objectRemoved Staged: " << hex << obj << endl;)
+    m_validObjects->remove(obj);
+    return true;
+}
+
+// pre-condition: we have the lock, arbitrary thread
+void Probe::drainStagedObjectCreations()
+{
+    // reset before looking at the buffers, so anything staged after this triggers another notification
+    if (!m_objectCreationsStaged.fetchAndStoreOrdered(0))
+        return;
+
+    auto &allStaged = s_listener()->stagedObjectCreations;
+    QMutexLocker listLock(&s_listener()->stagedObjectCreationsLock);
+    for (auto it = allStaged.begin(); it != allStaged.end();) {
+        const auto &staged = *it;
+        {
+            QMutexLocker lock(&staged->lock);
+            m_queuedObjectChanges.reserve(m_queuedObjectChanges.size() + staged->positions.size());
+            for (QObject *obj : qAsConst(staged->objects)) {
+                if (!obj)
+                    continue;
+                EXPENSIVE_ASSERT(!isObjectCreationQueued(obj));
+                ObjectChange c;
+                c.obj = obj;
+                c.type = ObjectChange::Create;
+                m_queuedObjectCreations.insert(obj, m_queuedObjectChanges.size());
+                m_queuedObjectChanges.push_back(c);
+            }
+            for (auto traceIt = staged->traces.constBegin(); traceIt != staged->traces.constEnd(); ++traceIt)
+                s_listener()->constructionBacktracesForObjects.insert(traceIt.key(), traceIt.value());
+            staged->objects.clear();
+            staged->positions.clear();
+            staged->traces.clear();
+        }
+
+        // we are the last owner, so the thread is gone
+        if (staged.use_count() == 1)
+            it = allStaged.erase(it);
+        else
+            ++it;
+    }
+    listLock.unlock();
+
+    if (!m_queuedObjectChanges.isEmpty())
+        notifyQueuedObjectChanges();
+}
+
 // pre-condition: we have the lock, arbitrary thread
 void Probe::queueDestroyedObject(QObject *obj)
 {
@@ -775,22 +1047,20 @@ void Probe::queueDestroyedObject(QObject *obj)
 // pre-condition: we have the lock, arbitrary thread
 bool Probe::isObjectCreationQueued(QObject *obj) const
 {
-    return std::find_if(m_queuedObjectChanges.begin(), m_queuedObjectChanges.end(),
-                        [obj](const ObjectChange &c) {
-        return c.obj == obj && c.type == Probe::ObjectChange::Create;
-    }) != m_queuedObjectChanges.end();
+    return m_queuedObjectCreations.contains(obj);
 }
 
 // pre-condition: we have the lock, arbitrary thread
 void Probe::purgeChangesForObject(QObject *obj)
 {
-    for (int i = 0; i < m_queuedObjectChanges.size(); ++i) {
-        if (m_queuedObjectChanges.at(i).obj == obj
-            && m_queuedObjectChanges.at(i).type == ObjectChange::Create) {
-            m_queuedObjectChanges.remove(i);
-            return;
-        }
-    }
+    const auto it = m_queuedObjectCreations.find(obj);
+    if (it == m_queuedObjectCreations.end())
+        return;
+
+    // don't remove the entry, that would invalidate the positions of all following ones
+    Q_ASSERT(m_queuedObjectChanges.at(it.value()).obj == obj);
+    m_queuedObjectChanges[it.value()].obj = nullptr;
+    m_queuedObjectCreations.erase(it);
 }
 
 // pre-condition: we have the lock, arbitrary thread
@@ -799,22 +1069,41 @@ void Probe::notifyQueuedObjectChanges()
     if (m_queueTimer->isActive())
         return;
 
-    if (thread() == QThread::currentThread()) {
+    if (thread() == QThread::currentThread())
         m_queueTimer->start();
-    } else {
-        static QMetaMethod m;
-        if (m.methodIndex() < 0) {
-            const auto idx = QTimer::staticMetaObject.indexOfMethod("start()");
-            Q_ASSERT(idx >= 0);
-            m = QTimer::staticMetaObject.method(idx);
-            Q_ASSERT(m.methodIndex() >= 0);
-        }
-        m.invoke(m_queueTimer, Qt::QueuedConnection);
+    else
+        startQueueTimer();
+}
+
+// pre-condition: arbitrary thread
+void Probe::startQueueTimer()
+{
+    static QMetaMethod m;
+    if (m.methodIndex() < 0) {
+        const auto idx = QTimer::staticMetaObject.indexOfMethod("start()");
+        Q_ASSERT(idx >= 0);
+        m = QTimer::staticMetaObject.method(idx);
+        Q_ASSERT(m.methodIndex() >= 0);
     }
+    m.invoke(m_queueTimer, Qt::QueuedConnection);
 }
 
 bool Probe::eventFilter(QObject *receiver, QEvent *event)
 {
+    // keep cached filterObject() results in sync, even for our own objects
+    switch (event->type()) {
+    case QEvent::ChildAdded:
+    case QEvent::ChildRemoved:
+        invalidateFilterVerdicts(static_cast<QChildEvent *>(event)->child());
+        break;
+    case QEvent::ParentChange:
+    case QEvent::ThreadChange:
+        invalidateFilterVerdicts(receiver);
+        break;
+    default:
+        break;
+    }
+
     if (ProbeGuard::insideProbe() && receiver->thread() == QThread::currentThread())
         return QObject::eventFilter(receiver, event);
 
@@ -823,7 +1112,7 @@ bool Probe::eventFilter(QObject *receiver, QEvent *event)
         QObject *obj = childEvent->child();
 
         QMutexLocker lock(s_lock());
-        const bool tracked = m_validObjects.contains(obj);
+        const bool tracked = m_validObjects->contains(obj);
         const bool filtered = filterObject(obj);
 
         IF_DEBUG(cout << "child event: " << hex << obj << ", p: " << obj->parent() << dec
@@ -856,7 +1145,7 @@ bool Probe::eventFilter(QObject *receiver, QEvent *event)
     // widget only unfortunately, but more precise than ChildAdded/Removed...
     if (event->type() == QEvent::ParentChange) {
         QMutexLocker lock(s_lock());
-        const bool tracked = m_validObjects.contains(receiver);
+        const bool tracked = m_validObjects->contains(receiver);
         const bool filtered = filterObject(receiver);
         if (!filtered && tracked && !isObjectCreationQueued(receiver)
             && !isObjectCreationQueued(receiver->parent())) {
@@ -872,9 +1161,8 @@ bool Probe::eventFilter(QObject *receiver, QEvent *event)
         && event->type() != QEvent::Destroy
         && event->type() != QEvent::WinIdChange // unsafe since emitted from dtors
         && !filterObject(receiver)) {
-        QMutexLocker lock(s_lock());
-        const bool tracked = m_validObjects.contains(receiver);
-        if (!tracked)
+        // lock-free pre-check, discoverObject() verifies this again with the lock held
+        if (!isValidObject(receiver))
             discoverObject(receiver);
     }
 
@@ -905,7 +1193,7 @@ void Probe::discoverObject(QObject *object)
         return;
 
     QMutexLocker lock(s_lock());
-    if (m_validObjects.contains(object))
+    if (m_validObjects->contains(object))
         return;
 
     objectAdded(object);
@@ -970,16 +1258,51 @@ void Probe::registerSignalSpyCallbackSet(const SignalSpyCallbackSet &callbacks)
     setupSignalSpyCallbacks();
 }
 
+void Probe::unregisterSignalSpyCallbackSet(const SignalSpyCallbackSet &callbacks)
+{
+    if (m_signalSpyCallbacks.removeOne(callbacks))
+        setupSignalSpyCallbacks();
+}
+
 void Probe::setupSignalSpyCallbacks()
 {
+    SignalSpyDispatchTable newTable;
+    for (const auto &it : qAsConst(m_signalSpyCallbacks)) {
+        if (it.signalBeginCallback)
+            (it.rawSignalIndexes ? newTable.signalBegin.signalIndex : newTable.signalBegin.methodIndex).push_back(it.signalBeginCallback);
+        if (it.signalEndCallback)
+            (it.rawSignalIndexes ? newTable.signalEnd.signalIndex : newTable.signalEnd.methodIndex).push_back(it.signalEndCallback);
+        if (it.slotBeginCallback)
+            newTable.slotBegin.push_back(it.slotBeginCallback);
+        if (it.slotEndCallback)
+            newTable.slotEnd.push_back(it.slotEndCallback);
+    }
+
+    // callbacks in other threads might still iterate a retired table and we have no cheap way
+    // of telling when they are done, so tables are never freed. Reuse an identical one instead,
+    // that bounds this by the number of distinct callback combinations rather than by the
+    // number of (un)registrations.
+    const auto it = std::find_if(m_signalSpyDispatchTables.cbegin(), m_signalSpyDispatchTables.cend(),
+                                 [&newTable](const std::unique_ptr<const SignalSpyDispatchTable> &t) {
+        return *t == newTable;
+    });
+    const SignalSpyDispatchTable *table = nullptr;
+    if (it != m_signalSpyDispatchTables.cend()) {
+        table = it->get();
+    } else {
+        table = new SignalSpyDispatchTable(newTable);
+        m_signalSpyDispatchTables.emplace_back(table);
+    }
+    m_signalSpyDispatchTable.storeRelease(table);
+
     // memory management is with us for Qt >= 5.14, therefore static here!
     static QSignalSpyCallbackSet cbs = { nullptr, nullptr, nullptr, nullptr };
-    foreach (const auto &it, m_signalSpyCallbacks) {
-        if (it.signalBeginCallback) cbs.signal_begin_callback = signal_begin_callback;
-        if (it.signalEndCallback) cbs.signal_end_callback = signal_end_callback;
-        if (it.slotBeginCallback) cbs.slot_begin_callback = slot_begin_callback;
-        if (it.slotEndCallback) cbs.slot_end_callback = slot_end_callback;
-    }
+    cbs.signal_begin_callback = table->signalBegin.signalIndex.isEmpty() && table->signalBegin.methodIndex.isEmpty()
+                                ? nullptr : signal_begin_callback;
+    cbs.signal_end_callback = table->signalEnd.signalIndex.isEmpty() && table->signalEnd.methodIndex.isEmpty()
+                              ? nullptr : signal_end_callback;
+    cbs.slot_begin_callback = table->slotBegin.isEmpty() ? nullptr : slot_begin_callback;
+    cbs.slot_end_callback = table->slotEnd.isEmpty() ? nullptr : slot_end_callback;
 #if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
     qt_register_signal_spy_callbacks(&cbs);
 #else
@@ -987,22 +1310,53 @@ void Probe::setupSignalSpyCallbacks()
 #endif
 }
 
-template<typename Func>
-void Probe::executeSignalCallback(const Func &func)
+const SignalSpyDispatchTable *Probe::signalSpyDispatchTable()
 {
-    std::for_each(instance()->m_signalSpyCallbacks.constBegin(),
-                  instance()->m_signalSpyCallbacks.constEnd(),
-                  func);
+    return instance()->m_signalSpyDispatchTable.loadAcquire();
 }
 
 SourceLocation Probe::objectCreationSourceLocation(QObject *object) const
 {
-  if (!s_listener()->constructionBacktracesForObjects.contains(object)) {
+  const auto st = objectCreationStackTrace(object);
+  if (st.empty()) {
     IF_DEBUG(std::cout << "No backtrace for object available" << object << "." << std::endl;)
     return SourceLocation();
   }
 
-  const auto &st = s_listener()->constructionBacktracesForObjects.value(object);
+  // resolving symbols can take a while, so never do that here
+  const auto frameIndex = creationFrameIndex(object);
+  Execution::ResolvedFrame frame;
+  if (Execution::resolveOneCached(st, frameIndex, &frame))
+    return frame.location;
+
+  {
+    QMutexLocker lock(s_lock());
+    if (m_pendingCreationSourceLocations.contains(object))
+      return SourceLocation();
+    m_pendingCreationSourceLocations.insert(object);
+  }
+  auto probe = const_cast<Probe *>(this);
+  Execution::resolveOneAsync(st, frameIndex, probe, [probe, object](const Execution::ResolvedFrame &) {
+    {
+      QMutexLocker lock(s_lock());
+      probe->m_pendingCreationSourceLocations.remove(object);
+    }
+    emit probe->objectCreationSourceLocationResolved(object);
+  });
+  return SourceLocation();
+}
+
+SourceLocation Probe::resolveObjectCreationSourceLocation(QObject *object) const
+{
+  const auto st = objectCreationStackTrace(object);
+  if (st.empty())
+    return SourceLocation();
+  return Execution::resolveOne(st, creationFrameIndex(object)).location;
+}
+
+int Probe::creationFrameIndex(QObject *object)
+{
+  // skip the constructors of all QObject subclasses involved
   int distanceToQObject = 0;
 
   const QMetaObject *metaObject = object->metaObject();
@@ -1010,12 +1364,25 @@ SourceLocation Probe::objectCreationSourceLocation(QObject *object) const
     distanceToQObject++;
     metaObject = metaObject->superClass();
   }
-
-  const auto frame = Execution::resolveOne(st, distanceToQObject + 1);
-  return frame.location;
+  return distanceToQObject + 1;
 }
 
 Execution::Trace Probe::objectCreationStackTrace(QObject *object) const
 {
-    return s_listener()->constructionBacktracesForObjects.value(object);
+    QMutexLocker lock(s_lock());
+    return s_listener()->constructionBacktracesForObjects.trace(object);
+}
+
+QString Probe::objectCreationStackTraceStatistics() const
+{
+    QMutexLocker lock(s_lock());
+    const auto &store = s_listener()->constructionBacktracesForObjects;
+    auto stats = tr("%n object(s), %1 unique stack trace(s), %2 KiB of %3 KiB used",
+                    nullptr, store.size())
+                 .arg(store.uniqueTraceCount())
+                 .arg(store.memoryUsage() / 1024)
+                 .arg(store.memoryBudget() / 1024);
+    if (store.droppedCount() > 0)
+        stats += tr(", %n stack trace(s) dropped", nullptr, store.droppedCount());
+    return stats;
 }
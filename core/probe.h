@@ -35,12 +35,14 @@
 #include <common/sourcelocation.h>
 
 #include <QObject>
+#include <QHash>
 #include <QList>
 #include <QPoint>
 #include <QSet>
 #include <QVector>
 
 #include <memory>
+#include <vector>
 
 QT_BEGIN_NAMESPACE
 class QAbstractItemModel;
@@ -61,6 +63,8 @@ class Server;
 class ToolManager;
 class ProblemCollector;
 class MetaObjectRegistry;
+class ObjectRegistry;
+struct SignalSpyDispatchTable;
 namespace Execution { class Trace; }
 
 /*!
@@ -116,6 +120,14 @@ public:
      * @return a pointer to a QAbstractItemModel instance.
      */
     QAbstractItemModel *objectTreeModel() const;
+    /*!
+     * Returns the index of @p object in @p model, without searching the model.
+     * @param model Either objectTreeModel(), objectListModel() or a chain of proxy
+     * models on top of either of those.
+     * @return An invalid index if @p object is not known or filtered out by a proxy.
+     * @since 2.12
+     */
+    QModelIndex indexForObject(QObject *object, const QAbstractItemModel *model) const;
     /*!
      * Register a model for remote usage.
      * @param objectName Unique identifier for the model, typically in reverse domain notation.
@@ -174,11 +186,31 @@ public:
      * @since 2.2
      */
     void registerSignalSpyCallbackSet(const SignalSpyCallbackSet &callbacks);
+    /*!
+     * Unregister a signal spy callback set registered with registerSignalSpyCallbackSet() before.
+     *
+     * @since 2.12
+     */
+    void unregisterSignalSpyCallbackSet(const SignalSpyCallbackSet &callbacks);
 
-    /*! Returns the source code location @p object was created at. */
+    /*! Returns the source code location @p object was created at.
+     *  If that hasn't been resolved yet, this returns an invalid location and resolves it in
+     *  the background, objectCreationSourceLocationResolved() is emitted once done.
+     */
     SourceLocation objectCreationSourceLocation(QObject *object) const;
+    /*! Returns the source code location @p object was created at, resolving it on the calling
+     *  thread if necessary. This can take a while, so only use it for on-demand operations
+     *  such as problem scans, objectCreationSourceLocation() is the right choice for everything else.
+     */
+    SourceLocation resolveObjectCreationSourceLocation(QObject *object) const;
     /*! Returns the entire stack trace for the creation of @p object. */
     Execution::Trace objectCreationStackTrace(QObject *object) const;
+    /*!
+     * Returns a human readable summary of the memory used for recording object creation
+     * stack traces. The budget for this can be set with the StackTraceMemoryBudget probe
+     * setting, in KiB.
+     */
+    QString objectCreationStackTraceStatistics() const;
 
     ///@cond internal
     QObject *window() const;
@@ -196,7 +228,9 @@ public:
     /*!
      * Check whether @p obj is still valid.
      *
-     * @note The objectLock must be locked when this is called!
+     * This check itself is lock-free and can be done from any thread.
+     * @note The objectLock must be locked in order to safely access @p obj
+     * afterwards, otherwise it might be destroyed concurrently.
      */
     bool isValidObject(const QObject *obj) const;
 
@@ -214,7 +248,7 @@ public:
 
     ///@cond internal
     static void startupHookReceived();
-    template<typename Func> static void executeSignalCallback(const Func &func);
+    static const SignalSpyDispatchTable *signalSpyDispatchTable();
     ///@endcond
 
     ProblemCollector *problemCollector() const;
@@ -260,6 +294,16 @@ signals:
     void objectDestroyed(QObject *obj);
     void objectReparented(QObject *obj);
 
+    /*!
+     * Emitted when the source location @p obj was created at became available,
+     * after objectCreationSourceLocation() returned an invalid location for it.
+     *
+     * Note:
+     * - This signal is emitted from the thread the probe exists in.
+     * - @p obj might have been destroyed meanwhile, see isValidObject().
+     */
+    void objectCreationSourceLocationResolved(QObject *obj);
+
     void aboutToDetach();
 
 protected:
@@ -291,9 +335,19 @@ private:
     bool isObjectCreationQueued(QObject *obj) const;
     void purgeChangesForObject(QObject *obj);
     void notifyQueuedObjectChanges();
+    void startQueueTimer();
+
+    void stageCreatedObject(QObject *obj);
+    bool unstageCreatedObject(QObject *obj);
+    void drainStagedObjectCreations();
+
+    void invalidateFilterVerdicts(QObject *obj);
 
     void findExistingObjects();
 
+    /*! Index of the frame in the creation stack trace of @p object that called its constructor. */
+    static int creationFrameIndex(QObject *object);
+
     /*! Check if we are capable of showing widgets. */
     static bool canShowWidgets();
     void showInProcessUi();
@@ -312,7 +366,7 @@ private:
     ProblemCollector *m_problemCollector;
     ToolManager *m_toolManager;
     QObject *m_window;
-    QSet<const QObject *> m_validObjects;
+    std::unique_ptr<ObjectRegistry> m_validObjects;
     MetaObjectRegistry *m_metaObjectRegistry;
 
     // all delayed object changes need to go through a single queue, as the order is crucial
@@ -324,12 +378,27 @@ private:
         } type;
     };
     QVector<ObjectChange> m_queuedObjectChanges;
+    // position of queued Create changes in the above, purged entries are kept as tombstones
+    QHash<const QObject *, int> m_queuedObjectCreations;
+    // set while objects from other threads wait in their staging buffer
+    QAtomicInt m_objectCreationsStaged;
+
+    // cached filterObject() results for objects of our thread, not synchronized, so
+    // this must only be used while running in our thread, other callers walk the parents
+    mutable QHash<const QObject *, bool> m_filterVerdicts;
+    mutable QAtomicInt m_filterVerdictsOutdated;
+    bool m_filterVerdictsEnabled;
 
     QList<QObject *> m_pendingReparents;
     QTimer *m_queueTimer;
     QVector<QObject *> m_globalEventFilters;
     QVector<SignalSpyCallbackSet> m_signalSpyCallbacks;
+    // all distinct tables ever published, callbacks in other threads might still use an older one
+    std::vector<std::unique_ptr<const SignalSpyDispatchTable> > m_signalSpyDispatchTables;
+    QAtomicPointer<const SignalSpyDispatchTable> m_signalSpyDispatchTable;
     SignalSpyCallbackSet m_previousSignalSpyCallbackSet;
+    // objects whose creation source location is being resolved, protected by s_lock()
+    mutable QSet<QObject *> m_pendingCreationSourceLocations;
     Server *m_server;
 };
 }
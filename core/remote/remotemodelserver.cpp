@@ -42,7 +42,12 @@
 #include <QDebug>
 #include <QBuffer>
 #include <QIcon>
+#include <QTimer>
 
+#include <algorithm>
+#include <memory>
+
+#include <cstring>
 #include <iostream>
 
 using namespace GammaRay;
@@ -54,10 +59,22 @@ RemoteModelServer::RemoteModelServer(const QString &objectName, QObject *parent)
     : QObject(parent)
     , m_model(nullptr)
     , m_dummyBuffer(new QBuffer(&m_dummyData, this))
+    , m_dataChangedTimer(new QTimer(this))
+    , m_nextNodeHandle(0)
+    , m_nodeHandleLookupValid(false)
     , m_monitored(false)
 {
     setObjectName(objectName);
     m_dummyBuffer->open(QIODevice::WriteOnly);
+
+    m_dataChangedTimer->setSingleShot(true);
+    m_dataChangedTimer->setInterval(0);
+    connect(m_dataChangedTimer, &QTimer::timeout, this, [this]() {
+        // otherwise this happens once the backpressure is released
+        if (!Endpoint::hasBackpressure())
+            sendDataChanges();
+    });
+
     registerServer();
 }
 
@@ -77,6 +94,9 @@ void RemoteModelServer::setModel(QAbstractItemModel *model)
         disconnectModel();
 
     m_model = model;
+    clearNodeHandles();
+    m_dirtyRegions.clear();
+    m_visibleRegions.clear();
     if (m_model && m_monitored)
         connectModel();
 
@@ -88,6 +108,7 @@ void RemoteModelServer::connectModel()
 {
     Q_ASSERT(m_model);
     Model::used(m_model);
+    m_nodeHandleLookupValid = false;
 
     connect(m_model.data(), &QAbstractItemModel::headerDataChanged,
             this, &RemoteModelServer::headerDataChanged);
@@ -107,6 +128,18 @@ void RemoteModelServer::connectModel()
             this, &RemoteModelServer::columnsRemoved);
     connect(m_model.data(), &QAbstractItemModel::dataChanged,
             this, &RemoteModelServer::dataChanged);
+    connect(m_model.data(), &QAbstractItemModel::rowsAboutToBeInserted,
+            this, &RemoteModelServer::sendDataChanges);
+    connect(m_model.data(), &QAbstractItemModel::rowsAboutToBeRemoved,
+            this, &RemoteModelServer::sendDataChanges);
+    connect(m_model.data(), &QAbstractItemModel::columnsAboutToBeInserted,
+            this, &RemoteModelServer::sendDataChanges);
+    connect(m_model.data(), &QAbstractItemModel::columnsAboutToBeMoved,
+            this, &RemoteModelServer::sendDataChanges);
+    connect(m_model.data(), &QAbstractItemModel::columnsAboutToBeRemoved,
+            this, &RemoteModelServer::sendDataChanges);
+    connect(m_model.data(), &QAbstractItemModel::layoutAboutToBeChanged,
+            this, &RemoteModelServer::sendDataChanges);
     connect(m_model.data(),
             &QAbstractItemModel::layoutChanged,
             this,
@@ -119,6 +152,8 @@ void RemoteModelServer::disconnectModel()
 {
     Q_ASSERT(m_model);
     Model::unused(m_model);
+    m_dirtyRegions.clear();
+    m_dataChangedTimer->stop();
 
     disconnect(m_model.data(), &QAbstractItemModel::headerDataChanged,
                this, &RemoteModelServer::headerDataChanged);
@@ -138,6 +173,18 @@ void RemoteModelServer::disconnectModel()
                this, &RemoteModelServer::columnsRemoved);
     disconnect(m_model.data(), &QAbstractItemModel::dataChanged,
                this, &RemoteModelServer::dataChanged);
+    disconnect(m_model.data(), &QAbstractItemModel::rowsAboutToBeInserted,
+               this, &RemoteModelServer::sendDataChanges);
+    disconnect(m_model.data(), &QAbstractItemModel::rowsAboutToBeRemoved,
+               this, &RemoteModelServer::sendDataChanges);
+    disconnect(m_model.data(), &QAbstractItemModel::columnsAboutToBeInserted,
+               this, &RemoteModelServer::sendDataChanges);
+    disconnect(m_model.data(), &QAbstractItemModel::columnsAboutToBeMoved,
+               this, &RemoteModelServer::sendDataChanges);
+    disconnect(m_model.data(), &QAbstractItemModel::columnsAboutToBeRemoved,
+               this, &RemoteModelServer::sendDataChanges);
+    disconnect(m_model.data(), &QAbstractItemModel::layoutAboutToBeChanged,
+               this, &RemoteModelServer::sendDataChanges);
     disconnect(m_model.data(), &QAbstractItemModel::layoutChanged,
                this, &RemoteModelServer::layoutChanged);
     disconnect(m_model.data(), &QAbstractItemModel::modelReset, this, &RemoteModelServer::modelReset);
@@ -162,17 +209,24 @@ void RemoteModelServer::newRequest(const GammaRay::Message &msg)
         for (quint32 i = 0; i < size; ++i) {
             Protocol::ModelIndex index;
             msg >> index;
-            const QModelIndex qmIndex = Protocol::toQModelIndex(m_model, index);
+            const QModelIndex qmIndex = toQModelIndex(index);
 
             qint32 rowCount = -1, columnCount = -1;
+            qint32 handle = -1;
             if (index.isEmpty() || qmIndex.isValid()) {
                 rowCount = m_model->rowCount(qmIndex);
                 columnCount = m_model->columnCount(qmIndex);
+                // nodes get a handle once they have children, the client has to know about
+                // one assigned earlier though, as the children are addressed relative to it
+                if (qmIndex.isValid() && qmIndex.column() == 0) {
+                    updateNodeHandleLookup();
+                    handle = rowCount > 0 ? nodeHandle(qmIndex) : announcedNodeHandle(qmIndex);
+                }
             }
 
-            reply << index << rowCount << columnCount;
+            reply << index << rowCount << columnCount << handle;
         }
-        sendMessage(reply);
+        sendReply(reply);
         break;
     }
 
@@ -187,7 +241,7 @@ void RemoteModelServer::newRequest(const GammaRay::Message &msg)
         for (quint32 i = 0; i < size; ++i) {
             Protocol::ModelIndex index;
             msg >> index;
-            const QModelIndex qmIndex = Protocol::toQModelIndex(m_model, index);
+            const QModelIndex qmIndex = toQModelIndex(index);
             if (!qmIndex.isValid())
                 continue;
             indexes.push_back(qmIndex);
@@ -196,13 +250,95 @@ void RemoteModelServer::newRequest(const GammaRay::Message &msg)
             break;
 
         Message msg(m_myAddress, Protocol::ModelContentReply);
-        msg << quint32(indexes.size());
-        for (const auto &qmIndex : qAsConst(indexes))
-            msg << Protocol::fromQModelIndex(qmIndex)
-                          << filterItemData(m_model->itemData(qmIndex))
-                          << qint32(m_model->flags(qmIndex));
+        writeContent(msg, indexes);
+        sendReply(msg);
+        break;
+    }
+
+    case Protocol::ModelContentRangeRequest:
+    {
+        quint32 size;
+        msg >> size;
+
+        QVector<QModelIndex> indexes;
+        for (quint32 i = 0; i < size; ++i) {
+            Protocol::ModelIndex parentIndex;
+            qint32 firstRow, lastRow, firstColumn, lastColumn;
+            msg >> parentIndex >> firstRow >> lastRow >> firstColumn >> lastColumn;
+            const QModelIndex parent = toQModelIndex(parentIndex);
+            if (!parentIndex.isEmpty() && !parent.isValid())
+                continue;
+            lastRow = qMin(lastRow, m_model->rowCount(parent) - 1);
+            lastColumn = qMin(lastColumn, m_model->columnCount(parent) - 1);
+            for (int row = qMax(0, firstRow); row <= lastRow; ++row) {
+                for (int column = qMax(0, firstColumn); column <= lastColumn; ++column)
+                    indexes.push_back(m_model->index(row, column, parent));
+            }
+        }
+        if (indexes.isEmpty())
+            break;
 
-        sendMessage(msg);
+        Message msg(m_myAddress, Protocol::ModelContentReply);
+        writeContent(msg, indexes);
+        sendReply(msg);
+        break;
+    }
+
+    case Protocol::ModelSubtreeRequest:
+    {
+        qint32 id;
+        Protocol::ModelIndex index;
+        qint32 depth, nodeBudget;
+        msg >> id >> index >> depth >> nodeBudget;
+        const QModelIndex root = toQModelIndex(index);
+
+        // breadth-first, so that the client knows every node before its children
+        struct SubtreeNode {
+            QModelIndex index;
+            qint32 level;
+            qint32 rowCount;
+            qint32 columnCount;
+            qint32 handle;
+        };
+        QVector<SubtreeNode> nodes;
+        QVector<QModelIndex> content;
+        if (index.isEmpty() || root.isValid())
+            nodes.push_back({ root, 0, -1, -1, -1 });
+        for (int i = 0; i < nodes.size(); ++i) {
+            const QModelIndex parent = nodes.at(i).index;
+            const qint32 rowCount = m_model->rowCount(parent);
+            const qint32 columnCount = m_model->columnCount(parent);
+            nodes[i].rowCount = rowCount;
+            nodes[i].columnCount = columnCount;
+            if (parent.isValid() && parent.column() == 0) {
+                updateNodeHandleLookup();
+                nodes[i].handle = rowCount > 0 ? nodeHandle(parent) : announcedNodeHandle(parent);
+            }
+
+            const qint32 level = nodes.at(i).level;
+            if (rowCount <= 0 || columnCount <= 0 || (depth >= 0 && level > depth) || rowCount > nodeBudget)
+                continue;
+            nodeBudget -= rowCount;
+            for (int row = 0; row < rowCount; ++row) {
+                const QModelIndex child = m_model->index(row, 0, parent);
+                nodes.push_back({ child, level + 1, -1, -1, -1 });
+                content.push_back(child);
+            }
+        }
+
+        Message reply(m_myAddress, Protocol::ModelSubtreeReply);
+        reply << id;
+        if (nodes.isEmpty()) { // the client will ask again once it processed all structure changes
+            reply << quint32(1) << index << qint32(-1) << qint32(-1) << qint32(-1);
+        } else {
+            reply << quint32(nodes.size()) << index << nodes.at(0).rowCount << nodes.at(0).columnCount << nodes.at(0).handle;
+            for (int i = 1; i < nodes.size(); ++i) {
+                const auto &node = nodes.at(i);
+                reply << fromQModelIndex(node.index) << node.rowCount << node.columnCount << node.handle;
+            }
+        }
+        writeContent(reply, content);
+        sendReply(reply);
         break;
     }
 
@@ -225,7 +361,7 @@ void RemoteModelServer::newRequest(const GammaRay::Message &msg)
 
         Message msg(m_myAddress, Protocol::ModelHeaderReply);
         msg << orientation << section << data;
-        sendMessage(msg);
+        sendReply(msg);
         break;
     }
 
@@ -236,7 +372,30 @@ void RemoteModelServer::newRequest(const GammaRay::Message &msg)
         QVariant value;
         msg >> index >> role >> value;
 
-        m_model->setData(Protocol::toQModelIndex(m_model, index), value, role);
+        m_model->setData(toQModelIndex(index), value, role);
+        break;
+    }
+
+    case Protocol::ModelVisibleRegionChanged:
+    {
+        quint32 size;
+        msg >> size;
+        QVector<VisibleRange> region;
+        region.reserve(size);
+        for (quint32 i = 0; i < size; ++i) {
+            Protocol::ModelIndex topLeft, bottomRight;
+            msg >> topLeft >> bottomRight;
+            VisibleRange range;
+            range.topLeft = toQModelIndex(topLeft);
+            range.bottomRight = toQModelIndex(bottomRight);
+            if (range.topLeft.isValid() && range.bottomRight.isValid()
+                && range.topLeft.parent() == range.bottomRight.parent())
+                region.push_back(range);
+        }
+        if (region.isEmpty())
+            m_visibleRegions.remove(currentClient());
+        else
+            m_visibleRegions.insert(currentClient(), region);
         break;
     }
 
@@ -254,7 +413,7 @@ void RemoteModelServer::newRequest(const GammaRay::Message &msg)
         msg >> barrierId;
         Message reply(m_myAddress, Protocol::ModelSyncBarrier);
         reply << barrierId;
-        sendMessage(reply);
+        sendReply(reply);
         break;
     }
     }
@@ -284,12 +443,9 @@ QMap<int, QVariant> RemoteModelServer::filterItemData(QMap<int, QVariant> &&item
 
 bool RemoteModelServer::canSerialize(const QVariant &value) const
 {
-    if (qstrcmp(value.typeName(), "QJSValue") == 0 || qstrcmp(value.typeName(), "QJsonObject") == 0 || qstrcmp(value.typeName(), "QJsonValue") == 0 || qstrcmp(value.typeName(), "QJsonArray") == 0) {
-        // QJSValue tries to serialize nested elements and asserts if that fails
-        // too bad it can contain QObject* as nested element, which obviously can't be serialized...
-        // QJsonObject serialization fails due to QTBUG-73437
-        return false;
-    }
+    const auto support = serializationSupport(value);
+    if (support != SerializableElements)
+        return support == Serializable;
 
     // recurse into containers
     if (value.canConvert<QVariantList>()) {
@@ -298,25 +454,55 @@ bool RemoteModelServer::canSerialize(const QVariant &value) const
             if (!canSerialize(v))
                 return false;
         }
-        // note: do not return true here, the fact we can write every single element
-        // does not mean we can write the entire thing, or vice vesa...
-    } else if (value.canConvert<QVariantMap>()) {
+    } else {
         auto iterable = value.value<QAssociativeIterable>();
         for (auto it = iterable.begin(); it != iterable.end(); ++it) {
             if (!canSerialize(it.value()) || !canSerialize(it.key()))
                 return false;
         }
-        // see above
     }
+    return true;
+}
 
-    // whitelist a few expensive to encode types we know we can serialize
-    if (value.userType() == qMetaTypeId<QUrl>() || value.userType() == qMetaTypeId<GammaRay::SourceLocation>())
-        return true;
+RemoteModelServer::SerializationSupport RemoteModelServer::serializationSupport(const QVariant &value) const
+{
+    // the verdict only depends on the type, so the dry run below happens once per type
+    static QHash<int, SerializationSupport> s_typeSupport;
+    const int type = value.userType();
+    const auto it = s_typeSupport.constFind(type);
+    if (it != s_typeSupport.constEnd())
+        return it.value();
+
+    SerializationSupport support = NotSerializable;
+    const char *typeName = value.typeName();
+    if (qstrcmp(typeName, "QJSValue") == 0 || qstrcmp(typeName, "QJsonObject") == 0 || qstrcmp(typeName, "QJsonValue") == 0 || qstrcmp(typeName, "QJsonArray") == 0) {
+        // QJSValue tries to serialize nested elements and asserts if that fails
+        // too bad it can contain QObject* as nested element, which obviously can't be serialized...
+        // QJsonObject serialization fails due to QTBUG-73437
+        support = NotSerializable;
+    } else if (type == qMetaTypeId<QUrl>() || type == qMetaTypeId<GammaRay::SourceLocation>()) {
+        // whitelist a few expensive to encode types we know we can serialize
+        support = Serializable;
+    } else {
+        // containers of variants depend on the actual elements, writing a variant that can't
+        // be written asserts, so check the container with an empty instance instead
+        const bool variantContainer = (value.canConvert<QVariantList>() || value.canConvert<QVariantMap>())
+                                      && typeName && strstr(typeName, "QVariant");
+        // ugly, but there doesn't seem to be a better way atm to find out without trying
+        m_dummyBuffer->seek(0);
+        QDataStream stream(m_dummyBuffer);
+        if (variantContainer) {
+            const QVariant emptyContainer(type, nullptr);
+            if (QMetaType::save(stream, type, emptyContainer.constData()))
+                support = SerializableElements;
+        } else if (QMetaType::save(stream, type, value.constData())) {
+            // for containers with fixed element types this also covers all elements
+            support = Serializable;
+        }
+    }
 
-    // ugly, but there doesn't seem to be a better way atm to find out without trying
-    m_dummyBuffer->seek(0);
-    QDataStream stream(m_dummyBuffer);
-    return QMetaType::save(stream, value.userType(), value.constData());
+    s_typeSupport.insert(type, support);
+    return support;
 }
 
 void RemoteModelServer::modelMonitored(bool monitored)
@@ -335,11 +521,156 @@ void RemoteModelServer::modelMonitored(bool monitored)
 void RemoteModelServer::dataChanged(const QModelIndex &begin, const QModelIndex &end,
                                     const QVector<int> &roles)
 {
-    if (!isConnected())
+    if (!isConnected() || !begin.isValid() || !end.isValid())
         return;
-    Message msg(m_myAddress, Protocol::ModelContentChanged);
-    msg << Protocol::fromQModelIndex(begin) << Protocol::fromQModelIndex(end) << roles;
-    sendMessage(msg);
+    queueDataChanged(begin, end, roles);
+    if (!m_dataChangedTimer->isActive())
+        m_dataChangedTimer->start();
+}
+
+void RemoteModelServer::writeContent(Message &msg, const QVector<QModelIndex> &indexes)
+{
+    if (Message::negotiatedFeatures() & Protocol::ColumnarModelContent) {
+        Protocol::ModelContent content;
+        content.indexes.reserve(indexes.size());
+        content.itemData.reserve(indexes.size());
+        content.flags.reserve(indexes.size());
+        for (const auto &qmIndex : indexes) {
+            content.indexes.push_back(fromQModelIndex(qmIndex));
+            content.itemData.push_back(filterItemData(m_model->itemData(qmIndex)));
+            content.flags.push_back(qint32(m_model->flags(qmIndex)));
+        }
+        msg << content;
+    } else {
+        msg << quint32(indexes.size());
+        for (const auto &qmIndex : indexes)
+            msg << fromQModelIndex(qmIndex)
+                << filterItemData(m_model->itemData(qmIndex))
+                << qint32(m_model->flags(qmIndex));
+    }
+}
+
+QVector<QModelIndex> RemoteModelServer::visibleIndexes(QObject *client, const QModelIndex &parent,
+                                                       int firstRow, int lastRow,
+                                                       int firstColumn, int lastColumn) const
+{
+    QVector<QModelIndex> indexes;
+    const auto it = m_visibleRegions.constFind(client);
+    if (it == m_visibleRegions.constEnd())
+        return indexes;
+    for (const auto &range : it.value()) {
+        if (!range.topLeft.isValid() || !range.bottomRight.isValid()
+            || range.topLeft.parent() != parent || range.bottomRight.parent() != parent)
+            continue;
+        // moves might have swapped the corners
+        const int top = qMax(firstRow, qMin(range.topLeft.row(), range.bottomRight.row()));
+        const int bottom = qMin(lastRow, qMax(range.topLeft.row(), range.bottomRight.row()));
+        const int left = qMax(firstColumn, qMin(range.topLeft.column(), range.bottomRight.column()));
+        const int right = qMin(lastColumn, qMax(range.topLeft.column(), range.bottomRight.column()));
+        for (int row = top; row <= bottom; ++row) {
+            for (int column = left; column <= right; ++column)
+                indexes.push_back(m_model->index(row, column, parent));
+        }
+    }
+
+    // the ranges of a client might overlap
+    std::sort(indexes.begin(), indexes.end());
+    indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+    return indexes;
+}
+
+void RemoteModelServer::queueDataChanged(const QModelIndex &begin, const QModelIndex &end,
+                                         const QVector<int> &roles)
+{
+    auto it = m_dirtyRegions.find(begin.parent());
+    if (it == m_dirtyRegions.end()) {
+        DirtyRegion region;
+        region.firstColumn = begin.column();
+        region.lastColumn = end.column();
+        region.rows.push_back(qMakePair(begin.row(), end.row()));
+        region.roles = roles;
+        m_dirtyRegions.insert(begin.parent(), region);
+        return;
+    }
+
+    auto &region = it.value();
+    // columns are few, so we just extend those
+    region.firstColumn = qMin(region.firstColumn, begin.column());
+    region.lastColumn = qMax(region.lastColumn, end.column());
+    if (roles.isEmpty() || region.roles.isEmpty()) {
+        region.roles.clear();
+    } else {
+        for (auto role : roles) {
+            if (!region.roles.contains(role))
+                region.roles.push_back(role);
+        }
+    }
+
+    // merge with all overlapping or adjacent row ranges
+    int first = begin.row();
+    int last = end.row();
+    auto &rows = region.rows;
+    auto rowIt = std::lower_bound(rows.begin(), rows.end(), first - 1,
+                                  [](const QPair<int, int> &range, int row) {
+        return range.second < row;
+    });
+    auto mergeEnd = rowIt;
+    while (mergeEnd != rows.end() && mergeEnd->first <= last + 1) {
+        first = qMin(first, mergeEnd->first);
+        last = qMax(last, mergeEnd->second);
+        ++mergeEnd;
+    }
+    rowIt = rows.erase(rowIt, mergeEnd);
+    rows.insert(rowIt, qMakePair(first, last));
+}
+
+void RemoteModelServer::sendDataChanges()
+{
+    m_dataChangedTimer->stop();
+    if (m_dirtyRegions.isEmpty())
+        return;
+
+    QHash<QModelIndex, DirtyRegion> regions;
+    std::swap(regions, m_dirtyRegions);
+    if (!isConnected() || !m_model)
+        return;
+
+    const auto clients = this->clients();
+    for (auto it = regions.constBegin(); it != regions.constEnd(); ++it) {
+        const auto &region = it.value();
+        for (const auto &rows : region.rows) {
+            const auto begin = fromQModelIndex(m_model->index(rows.first, region.firstColumn, it.key()));
+            const auto end = fromQModelIndex(m_model->index(rows.second, region.lastColumn, it.key()));
+            if (m_visibleRegions.isEmpty()) {
+                Message msg(m_myAddress, Protocol::ModelContentChanged);
+                msg << begin << end << region.roles;
+                writeContent(msg, QVector<QModelIndex>());
+                sendMessage(msg);
+                continue;
+            }
+
+            // cells currently shown by a client get their new content right away,
+            // saving it the round trip of requesting it
+            std::unique_ptr<Message> contentless;
+            for (auto client : clients) {
+                const auto indexes = visibleIndexes(client, it.key(), rows.first, rows.second,
+                                                    region.firstColumn, region.lastColumn);
+                if (indexes.isEmpty()) {
+                    if (!contentless) {
+                        contentless.reset(new Message(m_myAddress, Protocol::ModelContentChanged));
+                        *contentless << begin << end << region.roles;
+                        writeContent(*contentless, indexes);
+                    }
+                    sendMessageTo(client, *contentless);
+                    continue;
+                }
+                Message msg(m_myAddress, Protocol::ModelContentChanged);
+                msg << begin << end << region.roles;
+                writeContent(msg, indexes);
+                sendMessageTo(client, msg);
+            }
+        }
+    }
 }
 
 void RemoteModelServer::headerDataChanged(Qt::Orientation orientation, int first, int last)
@@ -353,7 +684,15 @@ void RemoteModelServer::headerDataChanged(Qt::Orientation orientation, int first
 
 void RemoteModelServer::rowsInserted(const QModelIndex &parent, int start, int end)
 {
-    sendAddRemoveMessage(Protocol::ModelRowsAdded, parent, start, end);
+    updateNodeHandles(parent);
+    if (!isConnected())
+        return;
+    Message msg(m_myAddress, Protocol::ModelRowsAdded);
+    msg << fromQModelIndex(parent) << start << end;
+    // the parent might have had no children so far, clients knowing it have to learn its
+    // handle now, as the children are addressed relative to it from now on
+    msg << (parent.isValid() && parent.column() == 0 ? nodeHandle(parent) : qint32(-1));
+    sendMessage(msg);
 }
 
 void RemoteModelServer::rowsAboutToBeMoved(const QModelIndex &sourceParent, int sourceStart,
@@ -363,29 +702,39 @@ void RemoteModelServer::rowsAboutToBeMoved(const QModelIndex &sourceParent, int
     Q_UNUSED(sourceStart);
     Q_UNUSED(sourceEnd);
     Q_UNUSED(destinationRow);
-    m_preOpIndexes.push_back(Protocol::fromQModelIndex(sourceParent));
-    m_preOpIndexes.push_back(Protocol::fromQModelIndex(destinationParent));
+    sendDataChanges();
+    m_preOpIndexes.push_back(fromQModelIndex(sourceParent));
+    m_preOpIndexes.push_back(fromQModelIndex(destinationParent));
 }
 
 void RemoteModelServer::rowsMoved(const QModelIndex &sourceParent, int sourceStart, int sourceEnd,
                                   const QModelIndex &destinationParent, int destinationRow)
 {
-    Q_UNUSED(sourceParent);
-    Q_UNUSED(destinationParent);
+    updateNodeHandles(sourceParent);
+    if (destinationParent != sourceParent)
+        updateNodeHandles(destinationParent);
     Q_ASSERT(m_preOpIndexes.size() >= 2);
     const auto destParentIdx = m_preOpIndexes.takeLast();
     const auto sourceParentIdx = m_preOpIndexes.takeLast();
-    sendMoveMessage(Protocol::ModelRowsMoved, sourceParentIdx, sourceStart, sourceEnd,
-                    destParentIdx, destinationRow);
+    if (!isConnected())
+        return;
+    Message msg(m_myAddress, Protocol::ModelRowsMoved);
+    msg << sourceParentIdx << qint32(sourceStart) << qint32(sourceEnd)
+        << destParentIdx << qint32(destinationRow);
+    // same as for rowsInserted()
+    msg << (destinationParent.isValid() && destinationParent.column() == 0 ? nodeHandle(destinationParent) : qint32(-1));
+    sendMessage(msg);
 }
 
 void RemoteModelServer::rowsRemoved(const QModelIndex &parent, int start, int end)
 {
+    updateNodeHandles(parent);
     sendAddRemoveMessage(Protocol::ModelRowsRemoved, parent, start, end);
 }
 
 void RemoteModelServer::columnsInserted(const QModelIndex &parent, int start, int end)
 {
+    m_nodeHandleLookupValid = false;
     sendAddRemoveMessage(Protocol::ModelColumnsAdded, parent, start, end);
 }
 
@@ -393,13 +742,15 @@ void RemoteModelServer::columnsMoved(const QModelIndex &sourceParent, int source
                                      int sourceEnd, const QModelIndex &destinationParent,
                                      int destinationColumn)
 {
+    m_nodeHandleLookupValid = false;
     sendMoveMessage(Protocol::ModelColumnsMoved,
-                    Protocol::fromQModelIndex(sourceParent), sourceStart, sourceEnd,
-                    Protocol::fromQModelIndex(destinationParent), destinationColumn);
+                    fromQModelIndex(sourceParent), sourceStart, sourceEnd,
+                    fromQModelIndex(destinationParent), destinationColumn);
 }
 
 void RemoteModelServer::columnsRemoved(const QModelIndex &parent, int start, int end)
 {
+    m_nodeHandleLookupValid = false;
     sendAddRemoveMessage(Protocol::ModelColumnsRemoved, parent, start, end);
 }
 
@@ -407,10 +758,14 @@ void RemoteModelServer::columnsRemoved(const QModelIndex &parent, int start, int
 void RemoteModelServer::layoutChanged(const QList<QPersistentModelIndex> &parents,
                                       QAbstractItemModel::LayoutChangeHint hint)
 {
+    if (parents.isEmpty())
+        m_nodeHandleLookupValid = false;
+    for (const auto &parent : parents)
+        updateNodeHandles(parent);
     QVector<Protocol::ModelIndex> indexes;
     indexes.reserve(parents.size());
     for (const auto &index : parents)
-        indexes.push_back(Protocol::fromQModelIndex(index));
+        indexes.push_back(fromQModelIndex(index));
     sendLayoutChanged(indexes, hint);
 }
 
@@ -427,6 +782,9 @@ void RemoteModelServer::sendLayoutChanged(const QVector< Protocol::ModelIndex >
 
 void RemoteModelServer::modelReset()
 {
+    clearNodeHandles();
+    m_dirtyRegions.clear();
+    m_dataChangedTimer->stop();
     if (!isConnected())
         return;
     sendMessage(Message(m_myAddress, Protocol::ModelReset));
@@ -438,7 +796,7 @@ void RemoteModelServer::sendAddRemoveMessage(Protocol::MessageType type, const Q
     if (!isConnected())
         return;
     Message msg(m_myAddress, type);
-    msg << Protocol::fromQModelIndex(parent) << start << end;
+    msg << fromQModelIndex(parent) << start << end;
     sendMessage(msg);
 }
 
@@ -463,6 +821,194 @@ void RemoteModelServer::modelDeleted()
         modelReset();
 }
 
+Protocol::ModelIndex RemoteModelServer::fromQModelIndex(const QModelIndex &index)
+{
+    if (!index.isValid())
+        return {};
+    updateNodeHandleLookup();
+
+    // path up to the closest ancestor that has a handle assigned
+    Protocol::ModelIndex result;
+    result.push_back(Protocol::ModelIndexData(index.row(), index.column()));
+    for (QModelIndex parent = index.parent(); parent.isValid(); parent = parent.parent()) {
+        const auto handle = announcedNodeHandle(parent);
+        if (handle >= 0) {
+            result.push_back(Protocol::ModelIndexData(Protocol::NodeHandleRow, handle));
+            break;
+        }
+        result.push_back(Protocol::ModelIndexData(parent.row(), parent.column()));
+    }
+    std::reverse(result.begin(), result.end());
+    return result;
+}
+
+QModelIndex RemoteModelServer::toQModelIndex(const Protocol::ModelIndex &index) const
+{
+    QModelIndex qmi;
+    auto it = index.constBegin();
+    if (it != index.constEnd() && it->row == Protocol::NodeHandleRow) {
+        qmi = m_nodeHandles.value(it->column).index;
+        if (!qmi.isValid())
+            return {}; // node is gone
+        ++it;
+    }
+
+    for (; it != index.constEnd(); ++it) {
+        qmi = m_model->index(it->row, it->column, qmi);
+        if (!qmi.isValid())
+            return {};
+    }
+    return qmi;
+}
+
+qint32 RemoteModelServer::nodeHandle(const QModelIndex &index, bool announce)
+{
+    updateNodeHandleLookup();
+    return assignNodeHandle(index, announce);
+}
+
+qint32 RemoteModelServer::assignNodeHandle(const QModelIndex &index, bool announce)
+{
+    const auto it = m_nodeHandleLookup.constFind(index);
+    if (it != m_nodeHandleLookup.constEnd()) {
+        if (announce)
+            m_nodeHandles[it.value()].announced = true;
+        return it.value();
+    }
+
+    // the parent needs a handle as well, so that a structural change only has to look at
+    // the handles of the direct children of the affected parent
+    const QModelIndex parent = index.parent();
+    const qint32 parentHandle = parent.isValid() ? assignNodeHandle(parent, false) : -1;
+
+    // handles are never reused, so requests for removed nodes can't hit a different one
+    const qint32 handle = m_nextNodeHandle++;
+    NodeHandle node;
+    node.index = index;
+    node.key = index;
+    node.announced = announce;
+    m_nodeHandles.insert(handle, node);
+    m_nodeHandleLookup.insert(index, handle);
+    m_childNodeHandles[parentHandle].push_back(handle);
+    return handle;
+}
+
+qint32 RemoteModelServer::announcedNodeHandle(const QModelIndex &index) const
+{
+    const auto it = m_nodeHandleLookup.constFind(index);
+    if (it == m_nodeHandleLookup.constEnd() || !m_nodeHandles.value(it.value()).announced)
+        return -1;
+    return it.value();
+}
+
+void RemoteModelServer::updateNodeHandleLookup()
+{
+    // without change notifications we can't tell whether indexes are still accurate
+    if (m_nodeHandleLookupValid && m_monitored)
+        return;
+
+    m_nodeHandleLookup.clear();
+    m_childNodeHandles.clear();
+    for (auto it = m_nodeHandles.begin(); it != m_nodeHandles.end();) {
+        if (!it.value().index.isValid()) {
+            it = m_nodeHandles.erase(it);
+            continue;
+        }
+        it.value().key = it.value().index;
+        m_nodeHandleLookup.insert(it.value().key, it.key());
+        ++it;
+    }
+    m_nodeHandleLookupValid = true;
+
+    // nodes might have changed their parent as well, possibly to one without a handle yet
+    const auto handles = m_nodeHandles.keys();
+    for (auto handle : handles) {
+        const QModelIndex parent = m_nodeHandles.value(handle).index.parent();
+        m_childNodeHandles[parent.isValid() ? assignNodeHandle(parent, false) : -1].push_back(handle);
+    }
+}
+
+void RemoteModelServer::updateNodeHandles(const QModelIndex &parent)
+{
+    // nothing to do if a full rebuild is pending anyway
+    if (!m_nodeHandleLookupValid || !m_monitored)
+        return;
+
+    qint32 parentHandle = -1;
+    if (parent.isValid()) {
+        const auto it = m_nodeHandleLookup.constFind(parent);
+        if (it == m_nodeHandleLookup.constEnd())
+            return; // then none of its children has one either
+        parentHandle = it.value();
+    }
+    const auto children = m_childNodeHandles.value(parentHandle);
+    if (children.isEmpty())
+        return;
+
+    // the new index of one node might be the previous one of another, so all outdated
+    // entries have to be gone before adding the new ones
+    QVector<qint32> remaining, changed;
+    remaining.reserve(children.size());
+    for (auto handle : children) {
+        const auto &node = m_nodeHandles[handle];
+        if (node.index == node.key) {
+            remaining.push_back(handle);
+            continue;
+        }
+        if (node.index.isValid()) {
+            m_nodeHandleLookup.remove(node.key);
+            changed.push_back(handle);
+        } else {
+            removeNodeHandle(handle);
+        }
+    }
+    for (auto handle : changed) {
+        auto &node = m_nodeHandles[handle];
+        node.key = node.index;
+        m_nodeHandleLookup.insert(node.key, handle);
+    }
+
+    // moves can take nodes to a different parent
+    QVector<qint32> moved;
+    for (auto handle : changed) {
+        if (m_nodeHandles.value(handle).index.parent() == parent)
+            remaining.push_back(handle);
+        else
+            moved.push_back(handle);
+    }
+    if (remaining.isEmpty())
+        m_childNodeHandles.remove(parentHandle);
+    else
+        m_childNodeHandles.insert(parentHandle, remaining);
+    for (auto handle : moved) {
+        const QModelIndex newParent = m_nodeHandles.value(handle).index.parent();
+        m_childNodeHandles[newParent.isValid() ? assignNodeHandle(newParent, false) : -1].push_back(handle);
+    }
+}
+
+void RemoteModelServer::removeNodeHandle(qint32 handle)
+{
+    const auto children = m_childNodeHandles.take(handle);
+    for (auto child : children)
+        removeNodeHandle(child);
+
+    const auto it = m_nodeHandles.find(handle);
+    if (it == m_nodeHandles.end())
+        return;
+    const auto lookupIt = m_nodeHandleLookup.find(it.value().key);
+    if (lookupIt != m_nodeHandleLookup.end() && lookupIt.value() == handle)
+        m_nodeHandleLookup.erase(lookupIt);
+    m_nodeHandles.erase(it);
+}
+
+void RemoteModelServer::clearNodeHandles()
+{
+    m_nodeHandles.clear();
+    m_childNodeHandles.clear();
+    m_nodeHandleLookup.clear();
+    m_nodeHandleLookupValid = true;
+}
+
 void RemoteModelServer::registerServer()
 {
     if (Q_UNLIKELY(s_registerServerCallback)) { // called from the ctor, so we can't rely on virtuals
@@ -473,6 +1019,13 @@ void RemoteModelServer::registerServer()
     Server::instance()->registerMessageHandler(m_myAddress, this, "newRequest");
     Server::instance()->registerMonitorNotifier(m_myAddress, this, "modelMonitored");
     connect(Endpoint::instance(), &Endpoint::disconnected, this, [this] { modelMonitored(); });
+    connect(Server::instance(), &Server::clientDisconnected, this, [this](QObject *client) {
+        m_visibleRegions.remove(client);
+    });
+    connect(Endpoint::instance(), &Endpoint::backpressureChanged, this, [this](bool backpressure) {
+        if (!backpressure)
+            sendDataChanges();
+    });
 }
 
 bool RemoteModelServer::isConnected() const
@@ -485,6 +1038,37 @@ void RemoteModelServer::sendMessage(const Message &msg) const
     Endpoint::send(msg);
 }
 
+void RemoteModelServer::sendReply(const Message &msg) const
+{
+    Endpoint::reply(msg);
+}
+
+QObject *RemoteModelServer::currentClient() const
+{
+    return Server::instance()->currentClient();
+}
+
+QVector<QObject *> RemoteModelServer::clients() const
+{
+    return Server::instance()->clients();
+}
+
+void RemoteModelServer::sendMessageTo(QObject *client, const Message &msg) const
+{
+    Server::instance()->sendToClient(client, msg);
+}
+
+int RemoteModelServer::maximumUpdateRate() const
+{
+    const int interval = m_dataChangedTimer->interval();
+    return interval > 0 ? 1000 / interval : 0;
+}
+
+void RemoteModelServer::setMaximumUpdateRate(int updatesPerSecond)
+{
+    m_dataChangedTimer->setInterval(updatesPerSecond > 0 ? qMax(1, 1000 / updatesPerSecond) : 0);
+}
+
 bool RemoteModelServer::proxyDynamicSortFilter() const
 {
     if (auto proxy = qobject_cast<QSortFilterProxyModel *>(m_model))
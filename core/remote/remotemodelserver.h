@@ -31,13 +31,17 @@
 
 #include <common/protocol.h>
 
+#include <QHash>
 #include <QObject>
+#include <QPersistentModelIndex>
 #include <QPointer>
 #include <QRegExp>
+#include <QVector>
 
 QT_BEGIN_NAMESPACE
 class QBuffer;
 class QAbstractItemModel;
+class QTimer;
 QT_END_NAMESPACE
 
 namespace GammaRay {
@@ -55,6 +59,7 @@ class RemoteModelServer : public QObject
         Qt::CaseSensitivity filterCaseSensitivity READ proxyFilterCaseSensitivity WRITE setProxyFilterCaseSensitivity)
     Q_PROPERTY(int filterKeyColumn READ proxyFilterKeyColumn WRITE setProxyFilterKeyColumn)
     Q_PROPERTY(QRegExp filterRegExp READ proxyFilterRegExp WRITE setProxyFilterRegExp)
+    Q_PROPERTY(int maximumUpdateRate READ maximumUpdateRate WRITE setMaximumUpdateRate)
 
 public:
     /** Registers a new model server object with name @p objectName (must be unique). */
@@ -66,6 +71,12 @@ public:
     /** Set the source model for this model server instance. */
     void setModel(QAbstractItemModel *model);
 
+    /** Content changes are collected and sent at most this many times per second,
+     *  0 (the default) sends them once per event loop iteration.
+     */
+    int maximumUpdateRate() const;
+    void setMaximumUpdateRate(int updatesPerSecond);
+
 public slots:
     void newRequest(const GammaRay::Message &msg);
     /** Notifications about an object on the client side (un)monitoring this object.
@@ -87,6 +98,43 @@ private:
         quint32 hint = 0);
     bool canSerialize(const QVariant &value) const;
 
+    /** Converts @p index into its transport representation, relative to the closest ancestor
+     *  with a node handle if there is one.
+     */
+    Protocol::ModelIndex fromQModelIndex(const QModelIndex &index);
+    /** Resolves @p index, which can be relative to a node handle. */
+    QModelIndex toQModelIndex(const Protocol::ModelIndex &index) const;
+    /** Returns the node handle for @p index, assigning a new one if necessary.
+     *  Unless @p announce is @c false, the handle is about to be sent to the client.
+     */
+    qint32 nodeHandle(const QModelIndex &index, bool announce = true);
+    /** Same as nodeHandle(), without bringing the lookup up to date first. */
+    qint32 assignNodeHandle(const QModelIndex &index, bool announce);
+    /** Returns the node handle the client might know for @p index, -1 if there is none.
+     *  The lookup has to be up to date for this.
+     */
+    qint32 announcedNodeHandle(const QModelIndex &index) const;
+    void updateNodeHandleLookup();
+    /** Follows structural changes among the children of @p parent. */
+    void updateNodeHandles(const QModelIndex &parent);
+    /** Drops @p handle and all handles below it. */
+    void removeNodeHandle(qint32 handle);
+    void clearNodeHandles();
+    /** Writes the content of @p indexes in the format RemoteModel expects for content replies. */
+    void writeContent(Message &msg, const QVector<QModelIndex> &indexes);
+    /** Cells within the given range of @p parent @p client asked for new content to be pushed for. */
+    QVector<QModelIndex> visibleIndexes(QObject *client, const QModelIndex &parent,
+                                        int firstRow, int lastRow,
+                                        int firstColumn, int lastColumn) const;
+    /** Merges a dataChanged() notification into the dirty region of its parent. */
+    void queueDataChanged(const QModelIndex &begin, const QModelIndex &end, const QVector<int> &roles);
+    enum SerializationSupport {
+        NotSerializable,
+        Serializable,
+        SerializableElements ///< container that is serializable if all its elements are
+    };
+    SerializationSupport serializationSupport(const QVariant &value) const;
+
     // proxy model settings
     bool proxyDynamicSortFilter() const;
     void setProxyDynamicSortFilter(bool dynamicSortFilter);
@@ -102,11 +150,21 @@ private:
     void registerServer();
     virtual bool isConnected() const;
     virtual void sendMessage(const Message &msg) const;
+    /** Sends @p msg only to the client whose request is currently being handled. */
+    virtual void sendReply(const Message &msg) const;
+    /** Identifies the client whose request is currently being handled. */
+    virtual QObject *currentClient() const;
+    /** All currently connected clients, as identified by currentClient(). */
+    virtual QVector<QObject *> clients() const;
+    /** Sends @p msg only to @p client. */
+    virtual void sendMessageTo(QObject *client, const Message &msg) const;
     friend class FakeRemoteModelServer;
 
 private slots:
     void dataChanged(const QModelIndex &begin, const QModelIndex &end,
                      const QVector<int> &roles = QVector<int>());
+    /** Sends the collected content changes, this has to happen before any structural change. */
+    void sendDataChanges();
     void headerDataChanged(Qt::Orientation orientation, int first, int last);
     void rowsInserted(const QModelIndex &parent, int start, int end);
     void rowsAboutToBeMoved(const QModelIndex &sourceParent, int sourceStart, int sourceEnd,
@@ -135,6 +193,43 @@ private:
     // the serialized index (move to sub-tree of source parent for example)
     // as operations can occur nested, we need to have a stack for this
     QList<Protocol::ModelIndex> m_preOpIndexes;
+    // persistent node handles handed out to the client, those remain valid until the node is removed
+    struct NodeHandle
+    {
+        QPersistentModelIndex index;
+        // the index this is filed under in m_nodeHandleLookup
+        QModelIndex key;
+        // handles are only announced for nodes with children, the others merely make sure
+        // every ancestor of a node with a handle has one as well
+        bool announced;
+    };
+    QHash<qint32, NodeHandle> m_nodeHandles;
+    // handles of the direct children of a node with a handle, -1 for the root
+    QHash<qint32, QVector<qint32> > m_childNodeHandles;
+    // reverse lookup; structural changes only change the indexes of the direct children
+    // of the affected parent, so only those are updated
+    QHash<QModelIndex, qint32> m_nodeHandleLookup;
+    qint32 m_nextNodeHandle;
+    // false if the lookup has to be rebuilt entirely, e.g. without change notifications
+    bool m_nodeHandleLookupValid;
+    // content changes not sent yet, per parent; the keys are only valid until the next
+    // structural change, which is why those are sent before any such change
+    struct DirtyRegion
+    {
+        int firstColumn;
+        int lastColumn;
+        QVector<QPair<int, int> > rows; // sorted, neither overlapping nor adjacent
+        QVector<int> roles; // empty for all roles
+    };
+    QHash<QModelIndex, DirtyRegion> m_dirtyRegions;
+    QTimer *m_dataChangedTimer;
+    // cells each client wants new content pushed for along with change notifications
+    struct VisibleRange
+    {
+        QPersistentModelIndex topLeft;
+        QPersistentModelIndex bottomRight;
+    };
+    QHash<QObject *, QVector<VisibleRange> > m_visibleRegions;
     Protocol::ObjectAddress m_myAddress;
     bool m_monitored;
 };
@@ -50,6 +50,10 @@
 using namespace GammaRay;
 using namespace std;
 
+// features changing the message payload, those have to be the same for all clients
+// as the payload is only serialized once for all of them
+static const quint32 payloadFeatures = Protocol::ColumnarModelContent;
+
 Server::Server(QObject *parent)
     : Endpoint(parent)
     , m_serverDevice(nullptr)
@@ -73,8 +77,8 @@ Server::Server(QObject *parent)
 #ifndef Q_OS_ANDROID
     m_broadcastTimer->start();
 #endif
+    // keep broadcasting while connected, further clients can attach any time
     connect(m_broadcastTimer, &QTimer::timeout, this, &Server::broadcast);
-    connect(this, &Server::disconnected, m_broadcastTimer, [this]{ m_broadcastTimer->start(); });
 
     connect(m_signalMapper, &MultiSignalMapper::signalEmitted,
             this, &Server::forwardSignal);
@@ -131,45 +135,94 @@ QUrl Server::serverAddress() const
 
 void Server::newConnection()
 {
-    if (isConnected()) {
-        cerr << Q_FUNC_INFO << " connected already, refusing incoming connection." << endl;
-        auto con = m_serverDevice->nextPendingConnection();
-        con->close();
-        con->deleteLater();
-        return;
-    }
-
-    m_broadcastTimer->stop();
     auto con = m_serverDevice->nextPendingConnection();
     // FIXME Use proper type for m_serverDevice->nextPendingConnection, instead
     // of relying on runtime-connect to a slot which doesn't exist in QIODevice
     connect(con, SIGNAL(disconnected()), con, SLOT(deleteLater()));
-    setDevice(con);
-
-    sendServerGreeting();
+    m_clients.insert(con, ClientState());
+    addDevice(con);
+    sendServerGreeting(con);
+    // everything else uses the data version of the other clients, which this one doesn't know yet
+    if (isDataVersionNegotiated())
+        setMessagesDeferred(con, true);
 
     emit connectionEstablished();
 }
 
-void Server::sendServerGreeting()
+void Server::sendServerGreeting(QIODevice *device)
 {
     // send greeting message for protocol version check
     {
         Message msg(endpointAddress(), Protocol::ServerVersion);
         msg << Protocol::version();
-        send(msg);
+        sendTo(device, msg);
     }
 
     {
         Message msg(endpointAddress(), Protocol::ServerInfo);
-        msg << label() << key() << pid() << Message::highestSupportedDataVersion(); // TODO: expand with anything else needed here: Qt/GammaRay version, hostname, that kind of stuff
-        send(msg);
+        // once another client negotiated the data version this is the only one we can offer
+        const quint8 dataVersion = isDataVersionNegotiated() ? Message::negotiatedDataVersion() : Message::highestSupportedDataVersion();
+        msg << label() << key() << pid() << dataVersion; // TODO: expand with anything else needed here: Qt/GammaRay version, hostname, that kind of stuff
+        sendTo(device, msg);
     }
 
     {
         Message msg(endpointAddress(), Protocol::ObjectMapReply);
         msg << objectAddresses();
-        send(msg);
+        sendTo(device, msg);
+    }
+}
+
+bool Server::isDataVersionNegotiated() const
+{
+    for (auto it = m_clients.constBegin(); it != m_clients.constEnd(); ++it) {
+        if (it.value().dataVersionNegotiated)
+            return true;
+    }
+    return false;
+}
+
+void Server::setObjectMonitored(Protocol::ObjectAddress address, bool monitored)
+{
+    m_propertySyncer->setObjectEnabled(address, monitored);
+    auto it = m_monitorNotifiers.constFind(address);
+    if (it == m_monitorNotifiers.constEnd())
+        return;
+    // cout << Q_FUNC_INFO << " un/monitor " << (int)address << endl;
+    QMetaObject::invokeMethod(it.value().first, it.value().second, Q_ARG(bool, monitored));
+}
+
+QObject *Server::currentClient() const
+{
+    return currentDevice();
+}
+
+QVector<QObject *> Server::clients() const
+{
+    QVector<QObject *> clients;
+    clients.reserve(m_clients.size());
+    for (auto it = m_clients.constBegin(); it != m_clients.constEnd(); ++it)
+        clients.push_back(it.key());
+    return clients;
+}
+
+void Server::sendToClient(QObject *client, const Message &msg)
+{
+    sendTo(qobject_cast<QIODevice *>(client), msg);
+}
+
+void Server::deviceDisconnected(QIODevice *device)
+{
+    emit clientDisconnected(device);
+
+    // whatever this client was watching might not be needed by anyone anymore
+    const auto client = m_clients.take(device);
+    for (auto address : client.monitoredObjects) {
+        auto it = m_monitorCount.find(address);
+        if (it == m_monitorCount.end() || --it.value() > 0)
+            continue;
+        m_monitorCount.erase(it);
+        setObjectMonitored(address, false);
     }
 }
 
@@ -180,15 +233,44 @@ void Server::messageReceived(const Message &msg)
         case Protocol::ClientDataVersionNegotiated:
         {
             quint8 version;
-            msg >> version;
+            quint32 features;
+            msg >> version >> features;
+            features &= Protocol::supportedFeatures();
+
+            const bool firstClient = !isDataVersionNegotiated();
+            if (!firstClient) {
+                const quint32 requiredFeatures = Message::negotiatedFeatures() & payloadFeatures;
+                if (version != Message::negotiatedDataVersion() || (features & requiredFeatures) != requiredFeatures) {
+                    cerr << Q_FUNC_INFO << " client is incompatible with the already connected ones, refusing connection." << endl;
+                    QPointer<QIODevice> device = currentDevice();
+                    QTimer::singleShot(0, this, [device]() {
+                        if (device)
+                            device->close();
+                    });
+                    break;
+                }
+                features = (features & ~payloadFeatures) | requiredFeatures;
+            }
+            m_clients[currentDevice()].dataVersionNegotiated = true;
 
             {
                 Message msg(endpointAddress(), Protocol::ServerDataVersionNegotiated);
-                msg << version;
-                send(msg);
+                msg << version << features;
+                reply(msg);
             }
 
-            Message::setNegotiatedDataVersion(version);
+            if (firstClient) {
+                Message::setNegotiatedDataVersion(version);
+                Message::setNegotiatedFeatures(features);
+                // clients still negotiating can't decode anything serialized with this version yet
+                for (auto it = m_clients.constBegin(); it != m_clients.constEnd(); ++it) {
+                    if (!it.value().dataVersionNegotiated)
+                        setMessagesDeferred(it.key(), true);
+                }
+            }
+            setStreamCompressionEnabled(features & Protocol::StreamCompression);
+            setMessageBatchingEnabled(true);
+            setMessagesDeferred(currentDevice(), false);
             break;
         }
         case Protocol::ObjectMonitored:
@@ -197,13 +279,23 @@ void Server::messageReceived(const Message &msg)
             Protocol::ObjectAddress addr;
             msg >> addr;
             Q_ASSERT(addr > Protocol::InvalidObjectAddress);
-            m_propertySyncer->setObjectEnabled(addr, msg.type() == Protocol::ObjectMonitored);
-            auto it = m_monitorNotifiers.constFind(addr);
-            if (it == m_monitorNotifiers.constEnd())
-                break;
-            // cout << Q_FUNC_INFO << " un/monitor " << (int)addr << endl;
-            QMetaObject::invokeMethod(it.value().first, it.value().second,
-                                      Q_ARG(bool, msg.type() == Protocol::ObjectMonitored));
+
+            // objects stay monitored as long as any client is monitoring them
+            auto &monitoredObjects = m_clients[currentDevice()].monitoredObjects;
+            if (msg.type() == Protocol::ObjectMonitored) {
+                if (monitoredObjects.contains(addr))
+                    break;
+                monitoredObjects.insert(addr);
+                if (++m_monitorCount[addr] == 1)
+                    setObjectMonitored(addr, true);
+            } else {
+                if (!monitoredObjects.remove(addr))
+                    break;
+                if (--m_monitorCount[addr] == 0) {
+                    m_monitorCount.remove(addr);
+                    setObjectMonitored(addr, false);
+                }
+            }
             break;
         }
         }
@@ -307,6 +399,9 @@ void Server::handlerDestroyed(Protocol::ObjectAddress objectAddress, const QStri
 {
     removeObjectNameAddressMapping(objectName);
     m_monitorNotifiers.remove(objectAddress);
+    m_monitorCount.remove(objectAddress);
+    for (auto it = m_clients.begin(); it != m_clients.end(); ++it)
+        it.value().monitoredObjects.remove(objectAddress);
 
     if (isConnected()) {
         Message msg(endpointAddress(), Protocol::ObjectRemoved);
@@ -34,6 +34,9 @@
 #include <common/endpoint.h>
 #include <common/objectbroker.h>
 
+#include <QSet>
+#include <QVector>
+
 QT_BEGIN_NAMESPACE
 class QTcpServer;
 class QUdpSocket;
@@ -108,12 +111,27 @@ public:
      */
      QString errorString() const;
 
+    /**
+     * Identifies the client that sent the message currently being handled,
+     * @c nullptr outside of message handling.
+     */
+    QObject *currentClient() const;
+    /** All currently connected clients. */
+    QVector<QObject *> clients() const;
+    /** Sends @p msg only to @p client, as identified by currentClient(). */
+    void sendToClient(QObject *client, const Message &msg);
+
+signals:
+    /** Emitted when the connection to @p client has been closed. */
+    void clientDisconnected(QObject *client);
+
 protected:
     void messageReceived(const Message &msg) override;
     void handlerDestroyed(Protocol::ObjectAddress objectAddress,
                           const QString &objectName) override;
     void objectDestroyed(Protocol::ObjectAddress objectAddress, const QString &objectName,
                          QObject *object) override;
+    void deviceDisconnected(QIODevice *device) override;
 
 private slots:
     void newConnection();
@@ -125,10 +143,22 @@ private slots:
     void forwardSignal(QObject *sender, int signalIndex, const QVector<QVariant> &args);
 
 private:
-    void sendServerGreeting();
+    void sendServerGreeting(QIODevice *device);
+    /** Returns @c true if any connected client completed the data version negotiation. */
+    bool isDataVersionNegotiated() const;
+    void setObjectMonitored(Protocol::ObjectAddress address, bool monitored);
 
 private:
+    struct ClientState
+    {
+        QSet<Protocol::ObjectAddress> monitoredObjects;
+        bool dataVersionNegotiated = false;
+    };
+
     ServerDevice *m_serverDevice;
+    QHash<QIODevice *, ClientState> m_clients;
+    // number of clients monitoring an object
+    QHash<Protocol::ObjectAddress, int> m_monitorCount;
     QHash<Protocol::ObjectAddress, QPair<QObject *, QByteArray> > m_monitorNotifiers;
     Protocol::ObjectAddress m_nextAddress;
 
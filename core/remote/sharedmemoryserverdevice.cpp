@@ -0,0 +1,72 @@
+/*
+  sharedmemoryserverdevice.cpp
+
+  This file is part of GammaRay, the Qt application inspection and
+  manipulation tool.
+
+  Copyright (C) 2019 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+
+  Licensees holding valid commercial KDAB GammaRay licenses may use this file in
+  accordance with GammaRay Commercial License Agreement provided with the Software.
+
+  Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sharedmemoryserverdevice.h"
+
+#include <common/sharedmemorydevice.h>
+
+#include <QCoreApplication>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+using namespace GammaRay;
+
+SharedMemoryServerDevice::SharedMemoryServerDevice(QObject *parent)
+    : LocalServerDevice(parent)
+    , m_segmentCount(0)
+{
+    // connections are only announced once their segment is set up
+    disconnect(m_server, &QLocalServer::newConnection, this, &ServerDevice::newConnection);
+    connect(m_server, &QLocalServer::newConnection, this, &SharedMemoryServerDevice::acceptConnections);
+}
+
+QIODevice *SharedMemoryServerDevice::nextPendingConnection()
+{
+    Q_ASSERT(!m_pendingConnections.isEmpty());
+    return m_pendingConnections.dequeue();
+}
+
+void SharedMemoryServerDevice::acceptConnections()
+{
+    while (m_server->hasPendingConnections()) {
+        QLocalSocket *socket = m_server->nextPendingConnection();
+        const QString key = QStringLiteral("gammaray-%1-%2").arg(QCoreApplication::applicationPid()).arg(++m_segmentCount);
+        QSharedMemory *segment = SharedMemoryDevice::createSegment(key);
+        if (!segment) {
+            socket->disconnectFromServer();
+            socket->deleteLater();
+            continue;
+        }
+
+        // handshake, anything following this is a doorbell ring
+        socket->write(key.toUtf8() + '\n');
+        auto device = new SharedMemoryDevice(segment, socket, SharedMemoryDevice::ServerRole, this);
+        socket->setParent(device);
+        m_pendingConnections.enqueue(device);
+        emit newConnection();
+    }
+}
@@ -52,8 +52,11 @@ RemoteViewServer::RemoteViewServer(const QString &name, QObject *parent)
     , m_pendingReset(false)
     , m_pendingCompleteFrame(false)
 {
-    Server::instance()->registerMonitorNotifier(Endpoint::instance()->objectAddress(
-                                                    name), this, "clientConnectedChanged");
+    const auto address = Endpoint::instance()->objectAddress(name);
+    Server::instance()->registerMonitorNotifier(address, this, "clientConnectedChanged");
+    // frames are large, don't let them hold up anything else
+    Server::instance()->setObjectPriority(address, Protocol::BulkPriority);
+    connect(Server::instance(), &Endpoint::backpressureChanged, this, &RemoteViewServer::checkRequestUpdate);
 
     m_updateTimer->setSingleShot(true);
     m_updateTimer->setInterval(10);
@@ -138,7 +141,8 @@ void RemoteViewServer::clientViewUpdated()
 void RemoteViewServer::checkRequestUpdate()
 {
     if (isActive() && !m_updateTimer->isActive() &&
-            m_clientReady && m_grabberReady && m_sourceChanged)
+            m_clientReady && m_grabberReady && m_sourceChanged &&
+            !Endpoint::hasBackpressure())
         m_updateTimer->start();
 }
 
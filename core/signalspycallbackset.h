@@ -46,6 +46,7 @@ struct GAMMARAY_CORE_EXPORT SignalSpyCallbackSet
 {
     SignalSpyCallbackSet() = default;
     bool isNull() const;
+    bool operator==(const SignalSpyCallbackSet &other) const;
 
     using BeginCallback = void (*)(QObject *, int, void **);
     using EndCallback = void (*)(QObject *, int);
@@ -54,6 +55,13 @@ struct GAMMARAY_CORE_EXPORT SignalSpyCallbackSet
     EndCallback signalEndCallback = nullptr;
     BeginCallback slotBeginCallback = nullptr;
     EndCallback slotEndCallback = nullptr;
+
+    /** Pass signal indexes to the signal callbacks as provided by Qt, rather than
+     *  mapping them to method indexes. This avoids the mapping cost on every emission
+     *  if the callbacks do not need it.
+     *  @since 2.12
+     */
+    bool rawSignalIndexes = false;
 };
 }
 
@@ -0,0 +1,263 @@
+/*
+  sortedobjectset.cpp
+
+  This file is part of GammaRay, the Qt application inspection and
+  manipulation tool.
+
+  Copyright (C) 2019 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+
+  Licensees holding valid commercial KDAB GammaRay licenses may use this file in
+  accordance with GammaRay Commercial License Agreement provided with the Software.
+
+  Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sortedobjectset.h"
+
+#include <utility>
+
+using namespace GammaRay;
+
+namespace GammaRay {
+struct SortedObjectSetNode
+{
+    explicit SortedObjectSetNode(QObject *obj);
+
+    QObject *obj;
+    quint32 priority;
+    int size; // of the subtree rooted here
+    SortedObjectSetNode *left;
+    SortedObjectSetNode *right;
+};
+}
+
+namespace {
+typedef SortedObjectSetNode Node;
+
+quint32 priorityFor(const QObject *obj)
+{
+    // SplitMix64 finalizer, addresses are neither random nor independent of the key order
+    auto x = static_cast<quint64>(reinterpret_cast<quintptr>(obj));
+    x = (x ^ (x >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+    x = (x ^ (x >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+    x = x ^ (x >> 31);
+    return static_cast<quint32>(x >> 32);
+}
+
+int sizeOf(const Node *node)
+{
+    return node ? node->size : 0;
+}
+
+void updateSize(Node *node)
+{
+    node->size = 1 + sizeOf(node->left) + sizeOf(node->right);
+}
+
+// splits @p node into entries less than @p obj and the remaining ones
+void split(Node *node, const QObject *obj, Node *&less, Node *&greaterOrEqual)
+{
+    if (!node) {
+        less = greaterOrEqual = nullptr;
+        return;
+    }
+    if (node->obj < obj) {
+        split(node->right, obj, node->right, greaterOrEqual);
+        less = node;
+    } else {
+        split(node->left, obj, less, node->left);
+        greaterOrEqual = node;
+    }
+    updateSize(node);
+}
+
+// pre-condition: all entries in @p left are less than those in @p right
+Node *merge(Node *left, Node *right)
+{
+    if (!left)
+        return right;
+    if (!right)
+        return left;
+    if (left->priority > right->priority) {
+        left->right = merge(left->right, right);
+        updateSize(left);
+        return left;
+    }
+    right->left = merge(left, right->left);
+    updateSize(right);
+    return right;
+}
+
+// pre-condition: @p obj is contained in the subtree at @p node
+Node *erase(Node *node, const QObject *obj)
+{
+    if (node->obj == obj) {
+        Node *replacement = merge(node->left, node->right);
+        delete node;
+        return replacement;
+    }
+    if (obj < node->obj)
+        node->left = erase(node->left, obj);
+    else
+        node->right = erase(node->right, obj);
+    updateSize(node);
+    return node;
+}
+
+Node *clone(const Node *node)
+{
+    if (!node)
+        return nullptr;
+    auto copy = new Node(*node);
+    copy->left = clone(node->left);
+    copy->right = clone(node->right);
+    return copy;
+}
+
+void destroy(Node *node)
+{
+    if (!node)
+        return;
+    destroy(node->left);
+    destroy(node->right);
+    delete node;
+}
+}
+
+SortedObjectSetNode::SortedObjectSetNode(QObject *obj)
+    : obj(obj)
+    , priority(priorityFor(obj))
+    , size(1)
+    , left(nullptr)
+    , right(nullptr)
+{
+}
+
+SortedObjectSet::SortedObjectSet()
+    : m_root(nullptr)
+{
+}
+
+SortedObjectSet::SortedObjectSet(const SortedObjectSet &other)
+    : m_root(clone(other.m_root))
+{
+}
+
+SortedObjectSet::~SortedObjectSet()
+{
+    destroy(m_root);
+}
+
+SortedObjectSet &SortedObjectSet::operator=(const SortedObjectSet &other)
+{
+    SortedObjectSet copy(other);
+    swap(copy);
+    return *this;
+}
+
+void SortedObjectSet::swap(SortedObjectSet &other)
+{
+    std::swap(m_root, other.m_root);
+}
+
+int SortedObjectSet::size() const
+{
+    return sizeOf(m_root);
+}
+
+bool SortedObjectSet::isEmpty() const
+{
+    return !m_root;
+}
+
+QObject *SortedObjectSet::at(int row) const
+{
+    Q_ASSERT(row >= 0 && row < size());
+    const Node *node = m_root;
+    forever {
+        const int leftSize = sizeOf(node->left);
+        if (row == leftSize)
+            return node->obj;
+        if (row < leftSize) {
+            node = node->left;
+        } else {
+            row -= leftSize + 1;
+            node = node->right;
+        }
+    }
+}
+
+int SortedObjectSet::indexOf(const QObject *obj) const
+{
+    int row = 0;
+    for (const Node *node = m_root; node;) {
+        if (obj < node->obj) {
+            node = node->left;
+        } else if (node->obj < obj) {
+            row += sizeOf(node->left) + 1;
+            node = node->right;
+        } else {
+            return row + sizeOf(node->left);
+        }
+    }
+    return -1;
+}
+
+int SortedObjectSet::lowerBound(const QObject *obj) const
+{
+    int row = 0;
+    for (const Node *node = m_root; node;) {
+        if (node->obj < obj) {
+            row += sizeOf(node->left) + 1;
+            node = node->right;
+        } else {
+            node = node->left;
+        }
+    }
+    return row;
+}
+
+bool SortedObjectSet::contains(const QObject *obj) const
+{
+    return indexOf(obj) >= 0;
+}
+
+int SortedObjectSet::insert(QObject *obj)
+{
+    if (contains(obj))
+        return -1;
+
+    Node *less = nullptr;
+    Node *greater = nullptr;
+    split(m_root, obj, less, greater);
+    const int row = sizeOf(less);
+    m_root = merge(merge(less, new Node(obj)), greater);
+    return row;
+}
+
+int SortedObjectSet::remove(const QObject *obj)
+{
+    const int row = indexOf(obj);
+    if (row >= 0)
+        m_root = erase(m_root, obj);
+    return row;
+}
+
+void SortedObjectSet::clear()
+{
+    destroy(m_root);
+    m_root = nullptr;
+}
@@ -0,0 +1,82 @@
+/*
+  sortedobjectset.h
+
+  This file is part of GammaRay, the Qt application inspection and
+  manipulation tool.
+
+  Copyright (C) 2019 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+
+  Licensees holding valid commercial KDAB GammaRay licenses may use this file in
+  accordance with GammaRay Commercial License Agreement provided with the Software.
+
+  Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GAMMARAY_SORTEDOBJECTSET_H
+#define GAMMARAY_SORTEDOBJECTSET_H
+
+#include <QtGlobal>
+
+QT_BEGIN_NAMESPACE
+class QObject;
+QT_END_NAMESPACE
+
+namespace GammaRay {
+struct SortedObjectSetNode;
+
+/**
+ * Set of QObject pointers, kept sorted by address.
+ *
+ * Unlike a sorted vector, inserting and removing entries as well as
+ * mapping between entries and their position is O(log(n)), which
+ * matters for models with rows for each entry, such as parents with
+ * many thousands of children in the object tree.
+ *
+ * This is implemented as a treap with subtree sizes, where the node
+ * priorities are derived from the object address.
+ */
+class SortedObjectSet
+{
+public:
+    SortedObjectSet();
+    SortedObjectSet(const SortedObjectSet &other);
+    ~SortedObjectSet();
+    SortedObjectSet &operator=(const SortedObjectSet &other);
+    void swap(SortedObjectSet &other);
+
+    int size() const;
+    bool isEmpty() const;
+
+    /** Returns the entry at position @p row, which has to be in range. */
+    QObject *at(int row) const;
+    /** Returns the position of @p obj, or -1 if not contained. */
+    int indexOf(const QObject *obj) const;
+    /** Returns the number of entries sorted before @p obj, ie. its position once inserted. */
+    int lowerBound(const QObject *obj) const;
+    bool contains(const QObject *obj) const;
+
+    /** Adds @p obj and returns its position, or -1 if it was contained already. */
+    int insert(QObject *obj);
+    /** Removes @p obj and returns its former position, or -1 if it was not contained. */
+    int remove(const QObject *obj);
+    void clear();
+
+private:
+    SortedObjectSetNode *m_root;
+};
+}
+
+#endif // GAMMARAY_SORTEDOBJECTSET_H
@@ -34,6 +34,7 @@ using namespace GammaRay;
 
 StackTraceModel::StackTraceModel(QObject* parent)
     : QAbstractTableModel(parent)
+    , m_pendingResolve(nullptr)
 {
 }
 
@@ -41,6 +42,10 @@ StackTraceModel::~StackTraceModel() = default;
 
 void StackTraceModel::setStackTrace(const Execution::Trace& trace)
 {
+    // cancels any outstanding resolve request
+    delete m_pendingResolve;
+    m_pendingResolve = nullptr;
+
     if (!m_trace.empty()) {
         beginRemoveRows(QModelIndex(), 0, m_trace.size() - 1);
         m_frames.clear();
@@ -53,9 +58,23 @@ void StackTraceModel::setStackTrace(const Execution::Trace& trace)
         m_trace = trace;
         m_frames.clear();
         endInsertRows();
+        resolveFrames();
     }
 }
 
+void StackTraceModel::resolveFrames()
+{
+    m_pendingResolve = new QObject(this);
+    Execution::resolveAllAsync(m_trace, m_pendingResolve, [this](const QVector<Execution::ResolvedFrame> &frames) {
+        m_pendingResolve->deleteLater();
+        m_pendingResolve = nullptr;
+        if (frames.size() != m_trace.size())
+            return;
+        m_frames = frames;
+        emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount(QModelIndex()) - 1));
+    });
+}
+
 int StackTraceModel::columnCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent);
@@ -74,8 +93,11 @@ QVariant StackTraceModel::data(const QModelIndex &index, int role) const
     if (!index.isValid())
         return QVariant();
 
-    if (m_trace.size() && !m_frames.size()) {
-        m_frames = Execution::resolveAll(m_trace);
+    if (m_frames.isEmpty()) {
+        // still being resolved
+        if (role == Qt::DisplayRole && index.column() == 0)
+            return tr("Resolving...");
+        return QVariant();
     }
 
     if (role == Qt::DisplayRole) {
@@ -39,7 +39,9 @@
 
 namespace GammaRay {
 
-/*! A table model for displaying a single stack trace. */
+/*! A table model for displaying a single stack trace.
+ *  Frames are resolved in the background, rows are filled in once that is done.
+ */
 class GAMMARAY_CORE_EXPORT StackTraceModel : public QAbstractTableModel
 {
     Q_OBJECT
@@ -55,8 +57,11 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
 
 private:
-    mutable QVector<Execution::ResolvedFrame> m_frames;
+    void resolveFrames();
+
+    QVector<Execution::ResolvedFrame> m_frames;
     Execution::Trace m_trace;
+    QObject *m_pendingResolve;
 };
 }
 
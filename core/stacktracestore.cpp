@@ -0,0 +1,153 @@
+/*
+  stacktracestore.cpp
+
+  This file is part of GammaRay, the Qt application inspection and
+  manipulation tool.
+
+  Copyright (C) 2019 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+
+  Licensees holding valid commercial KDAB GammaRay licenses may use this file in
+  accordance with GammaRay Commercial License Agreement provided with the Software.
+
+  Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stacktracestore.h"
+
+using namespace GammaRay;
+
+StackTraceStore::StackTraceStore()
+    : m_memoryBudget(-1)
+    , m_memoryUsage(0)
+    , m_droppedCount(0)
+{
+}
+
+StackTraceStore::~StackTraceStore() = default;
+
+qint64 StackTraceStore::memoryBudget() const
+{
+    return m_memoryBudget;
+}
+
+void StackTraceStore::setMemoryBudget(qint64 bytes)
+{
+    m_memoryBudget = bytes;
+}
+
+bool StackTraceStore::insert(const QObject *obj, const Execution::Trace &trace)
+{
+    remove(obj);
+
+    auto idIt = m_idsByTrace.constFind(trace);
+    qint64 cost = objectCost();
+    if (idIt == m_idsByTrace.constEnd())
+        cost += traceCost(trace);
+    if (m_memoryBudget >= 0 && m_memoryUsage + cost > m_memoryBudget) {
+        ++m_droppedCount;
+        return false;
+    }
+    m_memoryUsage += cost;
+
+    int id;
+    if (idIt != m_idsByTrace.constEnd()) {
+        id = idIt.value();
+        ++m_traces[id].refCount;
+    } else {
+        const Entry entry = { trace, 1 };
+        if (m_freeIds.isEmpty()) {
+            id = m_traces.size();
+            m_traces.push_back(entry);
+        } else {
+            id = m_freeIds.takeLast();
+            m_traces[id] = entry;
+        }
+        m_idsByTrace.insert(trace, id);
+    }
+    m_traceIds.insert(obj, id);
+    return true;
+}
+
+void StackTraceStore::remove(const QObject *obj)
+{
+    const auto it = m_traceIds.find(obj);
+    if (it == m_traceIds.end())
+        return;
+    const int id = it.value();
+    m_traceIds.erase(it);
+    m_memoryUsage -= objectCost();
+
+    Entry &entry = m_traces[id];
+    if (--entry.refCount > 0)
+        return;
+    m_memoryUsage -= traceCost(entry.trace);
+    m_idsByTrace.remove(entry.trace);
+    entry.trace = Execution::Trace();
+    m_freeIds.push_back(id);
+}
+
+void StackTraceStore::clear()
+{
+    m_traceIds.clear();
+    m_idsByTrace.clear();
+    m_traces.clear();
+    m_freeIds.clear();
+    m_memoryUsage = 0;
+}
+
+bool StackTraceStore::contains(const QObject *obj) const
+{
+    return m_traceIds.contains(obj);
+}
+
+Execution::Trace StackTraceStore::trace(const QObject *obj) const
+{
+    const auto it = m_traceIds.constFind(obj);
+    if (it == m_traceIds.constEnd())
+        return Execution::Trace();
+    return m_traces.at(it.value()).trace;
+}
+
+int StackTraceStore::size() const
+{
+    return m_traceIds.size();
+}
+
+int StackTraceStore::uniqueTraceCount() const
+{
+    return m_idsByTrace.size();
+}
+
+int StackTraceStore::droppedCount() const
+{
+    return m_droppedCount;
+}
+
+qint64 StackTraceStore::memoryUsage() const
+{
+    return m_memoryUsage;
+}
+
+// rough estimates of the hash node and vector entry overhead, we don't need to be exact here
+qint64 StackTraceStore::objectCost()
+{
+    return 4 * sizeof(void *);
+}
+
+qint64 StackTraceStore::traceCost(const Execution::Trace &trace)
+{
+    return sizeof(Entry) + 8 * sizeof(void *) + trace.size() * sizeof(void *);
+}
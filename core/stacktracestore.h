@@ -0,0 +1,104 @@
+/*
+  stacktracestore.h
+
+  This file is part of GammaRay, the Qt application inspection and
+  manipulation tool.
+
+  Copyright (C) 2019 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+
+  Licensees holding valid commercial KDAB GammaRay licenses may use this file in
+  accordance with GammaRay Commercial License Agreement provided with the Software.
+
+  Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GAMMARAY_STACKTRACESTORE_H
+#define GAMMARAY_STACKTRACESTORE_H
+
+#include "execution.h"
+
+#include <QHash>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+class QObject;
+QT_END_NAMESPACE
+
+namespace GammaRay {
+
+/**
+ * Bounded storage for the construction stack traces of objects.
+ *
+ * Objects created from the same code location usually share the exact same
+ * stack trace, so identical traces are stored only once and referenced by a
+ * reference-counted id. Once the approximated memory usage reaches the
+ * configured budget, traces of further objects are dropped.
+ *
+ * @note Not thread-safe, synchronization is up to the caller.
+ */
+class StackTraceStore
+{
+public:
+    StackTraceStore();
+    ~StackTraceStore();
+
+    /** Memory budget in bytes, negative values mean unbounded. */
+    qint64 memoryBudget() const;
+    void setMemoryBudget(qint64 bytes);
+
+    /**
+     * Stores @p trace for @p obj, replacing any previous trace for it.
+     * Returns @c false if this would exceed the memory budget.
+     */
+    bool insert(const QObject *obj, const Execution::Trace &trace);
+    /** Drops the trace of @p obj, if any. */
+    void remove(const QObject *obj);
+    void clear();
+
+    bool contains(const QObject *obj) const;
+    /** Returns the trace stored for @p obj, or an empty trace. */
+    Execution::Trace trace(const QObject *obj) const;
+
+    /** Number of objects a trace is stored for. */
+    int size() const;
+    /** Number of distinct traces stored. */
+    int uniqueTraceCount() const;
+    /** Number of traces rejected due to the memory budget. */
+    int droppedCount() const;
+    /** Approximated memory used, in bytes. */
+    qint64 memoryUsage() const;
+
+private:
+    Q_DISABLE_COPY(StackTraceStore)
+    struct Entry {
+        Execution::Trace trace;
+        int refCount;
+    };
+
+    static qint64 objectCost();
+    static qint64 traceCost(const Execution::Trace &trace);
+
+    QHash<const QObject *, int> m_traceIds;
+    QHash<Execution::Trace, int> m_idsByTrace;
+    QVector<Entry> m_traces;
+    QVector<int> m_freeIds;
+    qint64 m_memoryBudget;
+    qint64 m_memoryUsage;
+    int m_droppedCount;
+};
+}
+
+#endif // GAMMARAY_STACKTRACESTORE_H
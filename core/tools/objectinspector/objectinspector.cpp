@@ -114,16 +114,10 @@ void ObjectInspector::modelIndexSelected(const QModelIndex &index)
 
 void ObjectInspector::objectSelected(QObject *object)
 {
-    const QAbstractItemModel *model = m_selectionModel->model();
-    const QModelIndexList indexList
-        = model->match(model->index(0, 0),
-                       ObjectModel::ObjectRole,
-                       QVariant::fromValue<QObject *>(object), 1,
-                       Qt::MatchExactly | Qt::MatchRecursive | Qt::MatchWrap);
-    if (indexList.isEmpty())
+    const QModelIndex index = Probe::instance()->indexForObject(object, m_selectionModel->model());
+    if (!index.isValid())
         return;
 
-    const QModelIndex index = indexList.first();
     m_selectionModel->select(
         index,
         QItemSelectionModel::Select | QItemSelectionModel::Clear
@@ -228,7 +222,9 @@ void ObjectInspector::scanForThreadAffinityIssues()
             problem.severity = Problem::Warning;
             problem.description = QStringLiteral("The thread %1 has affinity with itself.").arg(objectName);
             problem.object = ObjectId(object);
-            problem.locations.append(probe->objectCreationSourceLocation(object));
+            const auto creationLocation = probe->resolveObjectCreationSourceLocation(object);
+            if (creationLocation.isValid())
+                problem.locations.append(creationLocation);
             problem.problemId = QStringLiteral("com.kdab.GammaRay.ObjectInspector.ThreadAffinityCheck.Self.%1")
                     .arg(QString::number(reinterpret_cast<quintptr>(object)));
             problem.findingCategory = Problem::Scan;
@@ -246,7 +242,9 @@ void ObjectInspector::scanForThreadAffinityIssues()
             problem.severity = Problem::Warning;
             problem.description = QStringLiteral("The object %1 doesn't have the same thread affinity as its parent %2.").arg(objectName, parentName);
             problem.object = ObjectId(object);
-            problem.locations.append(probe->objectCreationSourceLocation(object));
+            const auto creationLocation = probe->resolveObjectCreationSourceLocation(object);
+            if (creationLocation.isValid())
+                problem.locations.append(creationLocation);
             problem.problemId = QStringLiteral("com.kdab.GammaRay.ObjectInspector.ThreadAffinityCheck.%1:%2")
                     .arg(QString::number(reinterpret_cast<quintptr>(object)),
                          QString::number(reinterpret_cast<quintptr>(parent)));
@@ -259,7 +257,9 @@ void ObjectInspector::scanForThreadAffinityIssues()
             problem.severity = Problem::Warning;
             problem.description = QStringLiteral("The object %1 has thread %2 as parent, but doesn't have affinity with it.").arg(objectName, parentName);
             problem.object = ObjectId(object);
-            problem.locations.append(probe->objectCreationSourceLocation(object));
+            const auto creationLocation = probe->resolveObjectCreationSourceLocation(object);
+            if (creationLocation.isValid())
+                problem.locations.append(creationLocation);
             problem.problemId = QStringLiteral("com.kdab.GammaRay.ObjectInspector.ThreadAffinityCheck.Parent.%1")
                     .arg(QString::number(reinterpret_cast<quintptr>(object)),
                          QString::number(reinterpret_cast<quintptr>(parent)));
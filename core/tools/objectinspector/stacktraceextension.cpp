@@ -33,14 +33,19 @@
 #include <core/propertycontroller.h>
 
 #include <QDebug>
+#include <QTimer>
 
 using namespace GammaRay;
 
 StackTraceExtension::StackTraceExtension(PropertyController* controller)
-    : PropertyControllerExtension(controller->objectBaseName() + ".stackTrace")
+    : StackTraceExtensionInterface(controller->objectBaseName() + ".stackTraceExtension", controller)
+    , PropertyControllerExtension(controller->objectBaseName() + ".stackTrace")
     , m_model(new StackTraceModel(controller))
+    , m_statisticsTimer(new QTimer(this))
 {
     controller->registerModel(m_model, QStringLiteral("stackTraceModel"));
+    m_statisticsTimer->setInterval(1000);
+    connect(m_statisticsTimer, &QTimer::timeout, this, &StackTraceExtension::updateStatistics);
 }
 
 StackTraceExtension::~StackTraceExtension() = default;
@@ -49,5 +54,16 @@ bool StackTraceExtension::setQObject(QObject *object)
 {
     const auto trace = Probe::instance()->objectCreationStackTrace(object);
     m_model->setStackTrace(trace);
-    return !trace.empty();
+    if (trace.empty()) {
+        m_statisticsTimer->stop();
+        return false;
+    }
+    updateStatistics();
+    m_statisticsTimer->start();
+    return true;
+}
+
+void StackTraceExtension::updateStatistics()
+{
+    setStatistics(Probe::instance()->objectCreationStackTraceStatistics());
 }
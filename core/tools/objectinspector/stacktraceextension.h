@@ -30,20 +30,32 @@
 #define GAMMARAY_STACKTRACEEXTENSION_H
 
 #include <core/propertycontrollerextension.h>
+#include <common/tools/objectinspector/stacktraceextensioninterface.h>
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
 
 namespace GammaRay {
 class StackTraceModel;
 
-class StackTraceExtension : public PropertyControllerExtension
+class StackTraceExtension : public StackTraceExtensionInterface, public PropertyControllerExtension
 {
+    Q_OBJECT
+    Q_INTERFACES(GammaRay::StackTraceExtensionInterface)
 public:
     explicit StackTraceExtension(PropertyController *controller);
-    ~StackTraceExtension();
+    ~StackTraceExtension() override;
 
     bool setQObject(QObject *object) override;
 
+private slots:
+    void updateStatistics();
+
 private:
     StackTraceModel *m_model;
+    // the store changes with every object created or destroyed, so we poll while it is shown
+    QTimer *m_statisticsTimer;
 };
 }
 
@@ -223,7 +223,9 @@ void ActionModel::scanForShortcutDuplicates() const
             p.description = QStringLiteral("Key sequence %1 is ambigous.").arg(sequence.toString(QKeySequence::NativeText));
             p.problemId = QStringLiteral("gammaray_actioninspector.ShortcutDuplicates:%1").arg(sequence.toString(QKeySequence::PortableText));
             p.object = ObjectId(action);
-            p.locations.push_back(ObjectDataProvider::creationLocation(action));
+            const auto creationLocation = ObjectDataProvider::resolvedCreationLocation(action);
+            if (creationLocation.isValid())
+                p.locations.push_back(creationLocation);
             p.findingCategory = Problem::Scan;
             ProblemCollector::addProblem(p);
         }
@@ -45,6 +45,7 @@
 
 #include <common/endpoint.h>
 #include <common/modelevent.h>
+#include <common/modelutils.h>
 #include <common/objectbroker.h>
 #include <common/probecontrollerinterface.h>
 #include <common/problem.h>
@@ -470,15 +471,10 @@ void QuickInspector::selectItem(QQuickItem *item)
     Model::used(model);
     Model::used(m_sgSelectionModel->model());
 
-    const QModelIndexList indexList
-        = model->match(model->index(0, 0),
-                       ObjectModel::ObjectRole,
-                       QVariant::fromValue<QQuickItem *>(item), 1,
-                       Qt::MatchExactly | Qt::MatchRecursive | Qt::MatchWrap);
-    if (indexList.isEmpty())
+    const QModelIndex index = ModelUtils::mapFromSource(model, m_itemModel->indexForItem(item));
+    if (!index.isValid())
         return;
 
-    const QModelIndex index = indexList.first();
     m_itemSelectionModel->select(index,
                                  QItemSelectionModel::Select
                                  |QItemSelectionModel::Clear
@@ -491,15 +487,10 @@ void QuickInspector::selectSGNode(QSGNode *node)
     const QAbstractItemModel *model = m_sgSelectionModel->model();
     Model::used(model);
 
-    const QModelIndexList indexList = model->match(model->index(0, 0), ObjectModel::ObjectRole,
-                                                   QVariant::fromValue(
-                                                       node), 1,
-                                                   Qt::MatchExactly | Qt::MatchRecursive
-                                                   | Qt::MatchWrap);
-    if (indexList.isEmpty())
+    const QModelIndex index = ModelUtils::mapFromSource(model, m_sgModel->indexForNode(node));
+    if (!index.isValid())
         return;
 
-    const QModelIndex index = indexList.first();
     m_sgSelectionModel->select(index,
                                QItemSelectionModel::Select
                                |QItemSelectionModel::Clear
@@ -886,7 +877,9 @@ void QuickInspector::scanForProblems()
                         QString::number(reinterpret_cast<quintptr>(item), 16)
                     );
                     p.object = ObjectId(item);
-                    p.locations.push_back(ObjectDataProvider::creationLocation(item));
+                    const auto creationLocation = ObjectDataProvider::resolvedCreationLocation(item);
+                    if (creationLocation.isValid())
+                        p.locations.push_back(creationLocation);
                     p.problemId = QStringLiteral("com.kdab.GammaRay.QuickItemChecker.OutOfView:%1").arg(reinterpret_cast<quintptr>(item));
                     p.findingCategory = Problem::Scan;
                     ProblemCollector::addProblem(p);
@@ -43,6 +43,8 @@
 #include <core/remote/serverproxymodel.h>
 #include <core/propertycontrollerextension.h>
 
+#include <common/modelevent.h>
+#include <common/modelutils.h>
 #include <common/objectbroker.h>
 #include <common/endpoint.h>
 #include <common/metatypedeclarations.h>
@@ -245,14 +247,11 @@ void SceneInspector::nonQObjectSelected(void *obj, const QString &typeName)
 
 void SceneInspector::sceneItemSelected(QGraphicsItem *item)
 {
-    const auto indexList = m_itemSelectionModel->model()->match(
-        m_itemSelectionModel->model()->index(0, 0),
-        SceneModel::SceneItemRole,
-        QVariant::fromValue<QGraphicsItem *>(item), 1,
-        Qt::MatchExactly | Qt::MatchRecursive | Qt::MatchWrap);
-    if (indexList.isEmpty())
+    const auto model = m_itemSelectionModel->model();
+    Model::used(model);
+    const auto index = ModelUtils::mapFromSource(model, m_sceneModel->indexForItem(item));
+    if (!index.isValid())
         return;
-    const QModelIndex index = indexList.first();
     m_itemSelectionModel->setCurrentIndex(index,
                                           QItemSelectionModel::ClearAndSelect
                                           | QItemSelectionModel::Rows);
@@ -148,6 +148,17 @@ QModelIndex SceneModel::index(int row, int column, const QModelIndex &parent) co
     return createIndex(row, column, parentItem->childItems().at(row));
 }
 
+QModelIndex SceneModel::indexForItem(QGraphicsItem *item) const
+{
+    if (!item || !m_scene || item->scene() != m_scene)
+        return QModelIndex();
+    const int row = item->parentItem() ? item->parentItem()->childItems().indexOf(item)
+                                       : topLevelItems().indexOf(item);
+    if (row < 0)
+        return QModelIndex();
+    return createIndex(row, 0, item);
+}
+
 QList<QGraphicsItem *> SceneModel::topLevelItems() const
 {
     QList<QGraphicsItem *> topLevel;
@@ -48,6 +48,8 @@ public:
     explicit SceneModel(QObject *parent = nullptr);
     void setScene(QGraphicsScene *scene);
     QGraphicsScene *scene() const;
+    /// Returns the index of @p item, without searching the entire scene
+    QModelIndex indexForItem(QGraphicsItem *item) const;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
@@ -32,6 +32,7 @@
 #include <compat/qasconst.h>
 
 #include <core/objectmodelbase.h>
+#include <core/probe.h>
 #include <core/util.h>
 
 #include <QAbstractTransition>
@@ -76,6 +77,7 @@ class StateModelPrivate
 // private slots:
     void stateConfigurationChanged();
     void handleMachineDestroyed(QObject *);
+    void objectCreationSourceLocationResolved(QObject *obj);
 };
 }
 
@@ -144,10 +146,31 @@ void StateModelPrivate::handleMachineDestroyed(QObject *)
     q->endResetModel();
 }
 
+void StateModelPrivate::objectCreationSourceLocationResolved(QObject *obj)
+{
+    Q_Q(StateModel);
+    if (!m_stateMachine)
+        return;
+
+    // obj might be gone already, so only compare it against the state objects
+    QVector<State> states = children(m_stateMachine->rootState());
+    while (!states.isEmpty()) {
+        const State state = states.takeLast();
+        if (m_stateMachine->stateObject(state) == obj) {
+            const auto index = indexForState(state);
+            emit q->dataChanged(index, index, QVector<int>() << ObjectModel::CreationLocationRole);
+            return;
+        }
+        states += children(state);
+    }
+}
+
 StateModel::StateModel(QObject *parent)
     : QAbstractItemModel(parent)
     , d_ptr(new StateModelPrivate(this))
 {
+    connect(Probe::instance(), &Probe::objectCreationSourceLocationResolved,
+            this, [this](QObject *obj) { Q_D(StateModel); d->objectCreationSourceLocationResolved(obj); });
 }
 
 StateModel::~StateModel()
@@ -29,6 +29,7 @@
 #include "timermodel.h"
 
 #include <core/objectdataprovider.h>
+#include <core/probe.h>
 
 #include <common/objectmodel.h>
 #include <common/objectid.h>
@@ -184,6 +185,8 @@ TimerModel::TimerModel(QObject *parent)
     m_pushTimer->setSingleShot(true);
     m_pushTimer->setInterval(5000);
     connect(m_pushTimer, &QTimer::timeout, this, &TimerModel::pushChanges);
+    connect(Probe::instance(), &Probe::objectCreationSourceLocationResolved,
+            this, &TimerModel::objectCreationSourceLocationResolved);
 
     QInternal::registerCallback(QInternal::EventNotifyCallback, eventNotifyCallback);
 }
@@ -654,6 +657,20 @@ void TimerModel::pushChanges()
     applyChanges(changes);
 }
 
+void TimerModel::objectCreationSourceLocationResolved(QObject *obj)
+{
+    if (!m_sourceModel)
+        return;
+
+    // obj might be gone already, so only compare it against the receivers we know
+    for (int i = 0; i < rowCount(); ++i) {
+        const auto idx = index(i, 0);
+        const auto timerInfo = findTimerInfo(idx);
+        if (timerInfo && timerInfo->lastReceiverObject.data() == obj)
+            emit dataChanged(idx, idx, QVector<int>() << ObjectModel::CreationLocationRole);
+    }
+}
+
 void TimerModel::applyChanges(const TimerIdInfoContainer &changes)
 {
     QSet<TimerId> updatedIds;
@@ -94,6 +94,7 @@ private slots:
     void triggerPushChanges();
     void pushChanges();
     void applyChanges(const GammaRay::TimerModel::TimerIdInfoContainer &changes);
+    void objectCreationSourceLocationResolved(QObject *obj);
 
     void slotBeginRemoveRows(const QModelIndex &parent, int start, int end);
     void slotEndRemoveRows();
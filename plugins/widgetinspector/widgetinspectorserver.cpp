@@ -344,15 +344,9 @@ void WidgetInspectorServer::widgetSelected(QWidget *widget)
     if (m_selectedWidget == widget)
         return;
 
-    const QAbstractItemModel *model = m_widgetSelectionModel->model();
-    const QModelIndexList indexList
-        = model->match(model->index(0, 0),
-                       ObjectModel::ObjectRole,
-                       QVariant::fromValue<QObject *>(widget), 1,
-                       Qt::MatchExactly | Qt::MatchRecursive | Qt::MatchWrap);
-    if (indexList.isEmpty())
+    const QModelIndex index = m_probe->indexForObject(widget, m_widgetSelectionModel->model());
+    if (!index.isValid())
         return;
-    const QModelIndex index = indexList.first();
     m_widgetSelectionModel->select(
         index,
         QItemSelectionModel::Select | QItemSelectionModel::Clear
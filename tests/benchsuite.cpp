@@ -77,3 +77,28 @@ void BenchSuite::probe_objectAdded()
     qDeleteAll(objects);
     delete Probe::instance();
 }
+
+void BenchSuite::probe_queuedObjectChanges()
+{
+    Probe::createProbe(false);
+
+    static const int NUM_OBJECTS = 10000;
+    QVector<QObject *> objects;
+    objects.reserve(NUM_OBJECTS);
+    for (int i = 0; i < NUM_OBJECTS; ++i)
+        objects << new QObject;
+
+    // queue creations as done from the ctor hook before the event loop runs,
+    // then look them up and purge them again, as child events and destruction do
+    QBENCHMARK_ONCE {
+        for (QObject *obj : objects)
+            Probe::objectAdded(obj, true);
+        for (QObject *obj : objects)
+            Probe::instance()->isObjectCreationQueued(obj);
+        for (QObject *obj : objects)
+            Probe::objectRemoved(obj);
+    }
+
+    qDeleteAll(objects);
+    delete Probe::instance();
+}
@@ -39,6 +39,7 @@ class BenchSuite : public QObject
 private slots:
     void iconForObject();
     void probe_objectAdded();
+    void probe_queuedObjectChanges();
 };
 }
 
@@ -0,0 +1,390 @@
+/*
+  endpointtest.cpp
+
+  This file is part of GammaRay, the Qt application inspection and
+  manipulation tool.
+
+  Copyright (C) 2019 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+
+  Licensees holding valid commercial KDAB GammaRay licenses may use this file in
+  accordance with GammaRay Commercial License Agreement provided with the Software.
+
+  Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common/endpoint.h>
+#include <common/message.h>
+#include <common/protocol.h>
+
+#include <QtTest/qtest.h>
+#include <QObject>
+#include <QSignalSpy>
+#include <QUrl>
+
+#include <limits>
+
+using namespace GammaRay;
+
+namespace {
+const Protocol::ObjectAddress ModelObject = 100;
+const Protocol::ObjectAddress SelectionObject = 101;
+const Protocol::ObjectAddress BulkObject = 102;
+
+// incompressible, so that message sizes on the wire are predictable
+QByteArray randomData(int size)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    quint32 state = size;
+    for (int i = 0; i < size; ++i) {
+        state = state * 1103515245 + 12345;
+        data[i] = char(state >> 24);
+    }
+    return data;
+}
+
+void send(Protocol::ObjectAddress address, qint32 sequence, int size)
+{
+    Message msg(address, Protocol::ModelContentReply);
+    msg << sequence << randomData(size);
+    Endpoint::send(msg);
+}
+}
+
+/*! A device looping back to itself, holding written data until transmit() is called. */
+class LoopbackDevice : public QIODevice
+{
+    Q_OBJECT
+public:
+    explicit LoopbackDevice(QObject *parent = nullptr)
+        : QIODevice(parent)
+        , m_transmitted(0)
+    {
+        open(QIODevice::ReadWrite);
+    }
+
+    bool isSequential() const override
+    {
+        return true;
+    }
+
+    qint64 bytesAvailable() const override
+    {
+        return m_received.size() + QIODevice::bytesAvailable();
+    }
+
+    qint64 bytesToWrite() const override
+    {
+        return m_inFlight.size();
+    }
+
+    /*! Delivers up to @p bytes of the written data to the reading end. */
+    void transmit(qint64 bytes = std::numeric_limits<qint64>::max())
+    {
+        const int size = int(qMin<qint64>(bytes, m_inFlight.size()));
+        if (size == 0)
+            return;
+        m_received += m_inFlight.left(size);
+        m_inFlight.remove(0, size);
+        m_transmitted += size;
+        emit bytesWritten(size);
+        emit readyRead();
+    }
+
+    /*! Transmits until a total of @p bytes were delivered, or nothing is left. */
+    void transmitUntil(qint64 bytes)
+    {
+        while (m_transmitted < bytes && bytesToWrite() > 0)
+            transmit(qMin<qint64>(bytes - m_transmitted, 16 * 1024));
+    }
+
+    void transmitAll()
+    {
+        while (bytesToWrite() > 0)
+            transmit();
+    }
+
+signals:
+    void disconnected();
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        const int size = int(qMin<qint64>(maxSize, m_received.size()));
+        memcpy(data, m_received.constData(), size);
+        m_received.remove(0, size);
+        return size;
+    }
+
+    qint64 writeData(const char *data, qint64 maxSize) override
+    {
+        m_inFlight.append(data, int(maxSize));
+        return maxSize;
+    }
+
+private:
+    QByteArray m_inFlight;
+    QByteArray m_received;
+    qint64 m_transmitted;
+};
+
+class TestEndpoint : public Endpoint
+{
+    Q_OBJECT
+public:
+    struct ReceivedMessage
+    {
+        Protocol::ObjectAddress address;
+        qint32 sequence;
+        QByteArray data;
+    };
+
+    TestEndpoint()
+        : device(new LoopbackDevice(this))
+    {
+        addObjectNameAddressMapping(QStringLiteral("model"), ModelObject);
+        addObjectNameAddressMapping(QStringLiteral("selection"), SelectionObject);
+        addObjectNameAddressMapping(QStringLiteral("bulk"), BulkObject);
+        setObjectPriority(BulkObject, Protocol::BulkPriority);
+        setDevice(device);
+    }
+
+    bool isRemoteClient() const override
+    {
+        return false;
+    }
+
+    QUrl serverAddress() const override
+    {
+        return QUrl();
+    }
+
+    /*! Connects another endpoint, looping back to this one as well. */
+    LoopbackDevice *addLoopbackDevice()
+    {
+        auto loopback = new LoopbackDevice(this);
+        addDevice(loopback);
+        return loopback;
+    }
+
+    void setDeferred(QIODevice *device, bool deferred)
+    {
+        setMessagesDeferred(device, deferred);
+    }
+
+    QVector<qint32> receivedSequences() const
+    {
+        QVector<qint32> sequences;
+        for (const auto &msg : received)
+            sequences.push_back(msg.sequence);
+        return sequences;
+    }
+
+    LoopbackDevice *device;
+    QVector<ReceivedMessage> received;
+
+protected:
+    void messageReceived(const Message &msg) override
+    {
+        ReceivedMessage message;
+        message.address = msg.address();
+        if (msg.type() == Protocol::MethodCall) {
+            // method calls are recorded with sequence -1
+            dispatchMessage(msg);
+            message.sequence = -1;
+        } else {
+            msg >> message.sequence >> message.data;
+        }
+        received.push_back(message);
+    }
+
+    void handlerDestroyed(Protocol::ObjectAddress, const QString &) override {}
+    void objectDestroyed(Protocol::ObjectAddress, const QString &, QObject *) override {}
+};
+
+class MethodReceiver : public QObject
+{
+    Q_OBJECT
+public:
+    int calls = 0;
+
+public slots:
+    void call()
+    {
+        ++calls;
+    }
+};
+
+class EndpointTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testChunking()
+    {
+        TestEndpoint endpoint;
+        send(BulkObject, 1, 1024 * 1024);
+
+        // only a few chunks are handed to the device at a time
+        QVERIFY(endpoint.device->bytesToWrite() > 0);
+        QVERIFY(endpoint.device->bytesToWrite() < 256 * 1024);
+        QVERIFY(endpoint.received.isEmpty());
+
+        endpoint.device->transmitAll();
+        QCOMPARE(endpoint.received.size(), 1);
+        QCOMPARE(endpoint.received.at(0).address, BulkObject);
+        QCOMPARE(endpoint.received.at(0).sequence, 1);
+        QCOMPARE(endpoint.received.at(0).data, randomData(1024 * 1024));
+    }
+
+    void testInterleaving()
+    {
+        TestEndpoint endpoint;
+        send(BulkObject, 1, 1024 * 1024);
+        send(SelectionObject, 2, 100);
+        send(ModelObject, 3, 100);
+        endpoint.device->transmitAll();
+
+        // small interactive messages don't wait for large bulk ones
+        QCOMPARE(endpoint.receivedSequences(), QVector<qint32>({ 2, 3, 1 }));
+        QCOMPARE(endpoint.received.at(2).data, randomData(1024 * 1024));
+    }
+
+    void testOrdering()
+    {
+        TestEndpoint endpoint;
+        send(ModelObject, 1, 256 * 1024);
+        send(SelectionObject, 2, 100);
+        send(BulkObject, 3, 256 * 1024);
+        send(BulkObject, 4, 100);
+        send(ModelObject, 5, 100);
+        endpoint.device->transmitAll();
+
+        // interactive messages stay in order across objects, bulk ones per object
+        QCOMPARE(endpoint.receivedSequences(), QVector<qint32>({ 1, 2, 5, 3, 4 }));
+        QCOMPARE(endpoint.received.at(0).data, randomData(256 * 1024));
+        QCOMPARE(endpoint.received.at(3).data, randomData(256 * 1024));
+    }
+
+    void testBackpressure()
+    {
+        TestEndpoint endpoint;
+        QSignalSpy spy(&endpoint, SIGNAL(backpressureChanged(bool)));
+        QVERIFY(spy.isValid());
+        QVERIFY(!Endpoint::hasBackpressure());
+
+        send(BulkObject, 1, 3 * 1024 * 1024);
+        QVERIFY(!Endpoint::hasBackpressure());
+        send(BulkObject, 2, 2 * 1024 * 1024);
+        QVERIFY(Endpoint::hasBackpressure());
+        QCOMPARE(spy.size(), 1);
+        QCOMPARE(spy.at(0).at(0).toBool(), true);
+
+        // below the high watermark isn't enough to clear it
+        endpoint.device->transmitUntil(3 * 1024 * 1024);
+        QVERIFY(Endpoint::hasBackpressure());
+        QCOMPARE(spy.size(), 1);
+
+        // below the low watermark is
+        endpoint.device->transmitUntil(4 * 1024 * 1024 + 512 * 1024);
+        QVERIFY(!Endpoint::hasBackpressure());
+        QCOMPARE(spy.size(), 2);
+        QCOMPARE(spy.at(1).at(0).toBool(), false);
+
+        endpoint.device->transmitAll();
+        QCOMPARE(endpoint.receivedSequences(), QVector<qint32>({ 1, 2 }));
+    }
+
+    void testMethodInterning()
+    {
+        TestEndpoint endpoint;
+        MethodReceiver receiver;
+        endpoint.registerObject(QStringLiteral("model"), &receiver);
+
+        // the first call carries the method name, later ones only the id assigned to it
+        endpoint.invokeObject(QStringLiteral("model"), "call");
+        const auto firstCallSize = endpoint.device->bytesToWrite();
+        endpoint.device->transmitAll();
+        QCOMPARE(receiver.calls, 1);
+
+        endpoint.invokeObject(QStringLiteral("model"), "call");
+        const auto secondCallSize = endpoint.device->bytesToWrite();
+        endpoint.device->transmitAll();
+        QCOMPARE(receiver.calls, 2);
+        QCOMPARE(firstCallSize - secondCallSize, qint64(sizeof(quint32) + qstrlen("call")));
+    }
+
+    void testUnknownMethodId()
+    {
+        TestEndpoint endpoint;
+        MethodReceiver receiver;
+        endpoint.registerObject(QStringLiteral("model"), &receiver);
+
+        // an id that was never introduced along with a name
+        Message msg(ModelObject, Protocol::MethodCall);
+        msg << quint16(5) << QVariantList();
+        Endpoint::send(msg);
+        endpoint.device->transmitAll();
+        QCOMPARE(receiver.calls, 0);
+
+        // and that doesn't mess up the ids assigned afterwards
+        endpoint.invokeObject(QStringLiteral("model"), "call");
+        endpoint.invokeObject(QStringLiteral("model"), "call");
+        endpoint.device->transmitAll();
+        QCOMPARE(receiver.calls, 2);
+    }
+
+    void testMethodIdsPerConnection()
+    {
+        TestEndpoint endpoint;
+        MethodReceiver receiver;
+        endpoint.registerObject(QStringLiteral("model"), &receiver);
+
+        endpoint.invokeObject(QStringLiteral("model"), "call");
+        endpoint.device->transmitAll();
+        QCOMPARE(receiver.calls, 1);
+
+        // a connection added later gets to know the method name first
+        auto device2 = endpoint.addLoopbackDevice();
+        endpoint.invokeObject(QStringLiteral("model"), "call");
+        QCOMPARE(device2->bytesToWrite() - endpoint.device->bytesToWrite(),
+                 qint64(sizeof(quint32) + qstrlen("call")));
+        endpoint.device->transmitAll();
+        device2->transmitAll();
+        QCOMPARE(receiver.calls, 3);
+    }
+
+    void testDeferredMethodCalls()
+    {
+        TestEndpoint endpoint;
+        MethodReceiver receiver;
+        endpoint.registerObject(QStringLiteral("model"), &receiver);
+
+        // calls are held back along with everything else, and don't overtake it
+        endpoint.setDeferred(endpoint.device, true);
+        send(SelectionObject, 1, 100);
+        endpoint.invokeObject(QStringLiteral("model"), "call");
+        send(SelectionObject, 2, 100);
+        QCOMPARE(endpoint.device->bytesToWrite(), qint64(0));
+
+        endpoint.setDeferred(endpoint.device, false);
+        endpoint.device->transmitAll();
+        QCOMPARE(endpoint.receivedSequences(), QVector<qint32>({ 1, -1, 2 }));
+        QCOMPARE(receiver.calls, 1);
+    }
+};
+
+QTEST_MAIN(EndpointTest)
+
+#include "endpointtest.moc"
@@ -69,6 +69,67 @@ private slots:
         }
     }
 
+    void testResolveAsync()
+    {
+        if (!Execution::stackTracingAvailable())
+            return;
+        const auto trace = Execution::stackTrace(32);
+        QVector<Execution::ResolvedFrame> frames;
+        bool done = false;
+        Execution::resolveAllAsync(trace, this, [&](const QVector<Execution::ResolvedFrame> &resolved) {
+            frames = resolved;
+            done = true;
+        });
+        QTRY_VERIFY(done);
+        QCOMPARE(frames.size(), trace.size());
+
+        const auto resolved = Execution::resolveAll(trace);
+        for (int i = 0; i < frames.size(); ++i)
+            QCOMPARE(frames.at(i).name, resolved.at(i).name);
+    }
+
+    void testResolveAsyncCancel()
+    {
+        if (!Execution::stackTracingAvailable())
+            return;
+        const auto trace = Execution::stackTrace(32);
+        bool called = false;
+        {
+            QObject context;
+            Execution::resolveAllAsync(trace, &context, [&](const QVector<Execution::ResolvedFrame> &) {
+                called = true;
+            });
+        }
+        // a later request is only delivered after the first one has been processed
+        bool done = false;
+        Execution::resolveAllAsync(trace, this, [&](const QVector<Execution::ResolvedFrame> &) {
+            done = true;
+        });
+        QTRY_VERIFY(done);
+        QVERIFY(!called);
+    }
+
+    void testResolveOneAsync()
+    {
+        if (!Execution::stackTracingAvailable())
+            return;
+        const auto trace = Execution::stackTrace(32);
+        QVERIFY(trace.size() > 1);
+        Execution::ResolvedFrame frame;
+        bool done = false;
+        Execution::resolveOneAsync(trace, 1, this, [&](const Execution::ResolvedFrame &resolved) {
+            frame = resolved;
+            done = true;
+        });
+        QTRY_VERIFY(done);
+        QCOMPARE(frame.name, Execution::resolveOne(trace, 1).name);
+
+        // available without resolving again now
+        Execution::ResolvedFrame cachedFrame;
+        QVERIFY(Execution::resolveOneCached(trace, 1, &cachedFrame));
+        QCOMPARE(cachedFrame.name, frame.name);
+    }
+
     void benchmarkStackTrace()
     {
         if (!Execution::stackTracingAvailable())
@@ -0,0 +1,376 @@
+/*
+  messagetest.cpp
+
+  This file is part of GammaRay, the Qt application inspection and
+  manipulation tool.
+
+  Copyright (C) 2019 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+
+  Licensees holding valid commercial KDAB GammaRay licenses may use this file in
+  accordance with GammaRay Commercial License Agreement provided with the Software.
+
+  Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <common/message.h>
+#include <common/protocol.h>
+
+#include <QtTest/qtest.h>
+#include <QBuffer>
+#include <QObject>
+
+using namespace GammaRay;
+
+namespace {
+// roughly what RemoteModelServer sends for a ModelContentRequest
+void writeModelContent(Message &msg, int rows)
+{
+    msg << quint32(rows);
+    for (int row = 0; row < rows; ++row) {
+        Protocol::ModelIndex index;
+        index.push_back(Protocol::ModelIndexData(row, 0));
+        QMap<int, QVariant> itemData;
+        itemData.insert(Qt::DisplayRole, QStringLiteral("QObject 0x%1").arg(row * 16, 8, 16, QLatin1Char('0')));
+        itemData.insert(Qt::ToolTipRole, QStringLiteral("Object of type QObject"));
+        msg << index << itemData << qint32(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
+    }
+}
+}
+
+class MessageTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testRoundTrip_data()
+    {
+        QTest::addColumn<int>("rows");
+        QTest::newRow("empty") << 0;
+        QTest::newRow("small") << 1;
+        QTest::newRow("compressed") << 100;
+    }
+
+    void testRoundTrip()
+    {
+        QFETCH(int, rows);
+
+        QBuffer device;
+        device.open(QIODevice::ReadWrite);
+        int payloadSize = 0;
+        {
+            Message msg(42, Protocol::ModelContentReply);
+            if (rows)
+                writeModelContent(msg, rows);
+            payloadSize = msg.size();
+            msg.write(&device);
+        }
+        {
+            Message msg(43, Protocol::ModelRowColumnCountReply);
+            msg << qint32(rows);
+            msg.write(&device);
+        }
+        if (rows > 1)
+            QVERIFY(device.size() < payloadSize);
+
+        device.seek(0);
+        QVERIFY(Message::canReadMessage(&device));
+        {
+            const auto msg = Message::readMessage(&device);
+            QCOMPARE(msg.address(), Protocol::ObjectAddress(42));
+            QCOMPARE(msg.type(), Protocol::MessageType(Protocol::ModelContentReply));
+            QCOMPARE(msg.size(), payloadSize);
+            if (rows) {
+                quint32 count;
+                msg >> count;
+                QCOMPARE(count, quint32(rows));
+                for (int row = 0; row < rows; ++row) {
+                    Protocol::ModelIndex index;
+                    QMap<int, QVariant> itemData;
+                    qint32 flags;
+                    msg >> index >> itemData >> flags;
+                    QCOMPARE(index.size(), 1);
+                    QCOMPARE(index.at(0).row, row);
+                    QCOMPARE(itemData.value(Qt::ToolTipRole).toString(), QStringLiteral("Object of type QObject"));
+                    QCOMPARE(flags, qint32(Qt::ItemIsSelectable | Qt::ItemIsEnabled));
+                }
+            }
+        }
+
+        QVERIFY(Message::canReadMessage(&device));
+        {
+            const auto msg = Message::readMessage(&device);
+            QCOMPARE(msg.address(), Protocol::ObjectAddress(43));
+            QCOMPARE(msg.type(), Protocol::MessageType(Protocol::ModelRowColumnCountReply));
+            qint32 value;
+            msg >> value;
+            QCOMPARE(value, rows);
+        }
+        QVERIFY(!Message::canReadMessage(&device));
+    }
+
+    void testPartialMessage()
+    {
+        QByteArray data;
+        {
+            QBuffer device(&data);
+            device.open(QIODevice::WriteOnly);
+            Message msg(42, Protocol::ModelContentReply);
+            writeModelContent(msg, 20);
+            msg.write(&device);
+        }
+
+        QBuffer device;
+        device.open(QIODevice::ReadWrite);
+        device.write(data.left(data.size() - 1));
+        device.seek(0);
+        QVERIFY(!Message::canReadMessage(&device));
+
+        device.seek(device.size());
+        device.write(data.right(1));
+        device.seek(0);
+        QVERIFY(Message::canReadMessage(&device));
+        const auto msg = Message::readMessage(&device);
+        QCOMPARE(msg.type(), Protocol::MessageType(Protocol::ModelContentReply));
+        quint32 count;
+        msg >> count;
+        QCOMPARE(count, quint32(20));
+    }
+
+    void testStreamCompression()
+    {
+        MessageStream writer;
+        MessageStream reader;
+        writer.setCompressionEnabled(true);
+
+        QBuffer device;
+        device.open(QIODevice::ReadWrite);
+        for (int i = 0; i < 200; ++i) {
+            Message msg(42, Protocol::ModelContentReply);
+            // alternate between small, regular and messages too large for streaming
+            writeModelContent(msg, i % 50 == 0 ? 1000 : i % 3);
+            msg.write(&device, &writer);
+        }
+        QVERIFY(writer.bytesWritten() < writer.uncompressedBytesWritten() / 2);
+        QCOMPARE(quint64(device.size()), writer.bytesWritten());
+
+        device.seek(0);
+        for (int i = 0; i < 200; ++i) {
+            QVERIFY(Message::canReadMessage(&device));
+            const auto msg = Message::readMessage(&device, &reader);
+            const int rows = i % 50 == 0 ? 1000 : i % 3;
+            if (!rows) {
+                QCOMPARE(msg.size(), 0);
+                continue;
+            }
+            quint32 count;
+            msg >> count;
+            QCOMPARE(count, quint32(rows));
+            for (int row = 0; row < rows; ++row) {
+                Protocol::ModelIndex index;
+                QMap<int, QVariant> itemData;
+                qint32 flags;
+                msg >> index >> itemData >> flags;
+                QCOMPARE(index.at(0).row, row);
+                QCOMPARE(itemData.size(), 2);
+            }
+        }
+        QVERIFY(!Message::canReadMessage(&device));
+        QCOMPARE(reader.bytesRead(), writer.bytesWritten());
+        QCOMPARE(reader.uncompressedBytesRead(), writer.uncompressedBytesWritten());
+    }
+
+    void testWriteToMultipleDevices()
+    {
+        MessageStream streamWriter;
+        streamWriter.setCompressionEnabled(true);
+        MessageStream streamReader;
+
+        QBuffer plain1, plain2, streamed;
+        plain1.open(QIODevice::ReadWrite);
+        plain2.open(QIODevice::ReadWrite);
+        streamed.open(QIODevice::ReadWrite);
+        {
+            Message msg(42, Protocol::ModelContentReply);
+            writeModelContent(msg, 100);
+            // mixing independent and stream compression must not reuse the wrong frame
+            msg.write(&plain1);
+            msg.write(&streamed, &streamWriter);
+            msg.write(&plain2);
+        }
+        QVERIFY(plain1.size() > 0);
+        QCOMPARE(plain1.data(), plain2.data());
+
+        for (auto device : { &plain1, &plain2, &streamed }) {
+            device->seek(0);
+            QVERIFY(Message::canReadMessage(device));
+            const auto msg = Message::readMessage(device, device == &streamed ? &streamReader : nullptr);
+            quint32 count;
+            msg >> count;
+            QCOMPARE(count, quint32(100));
+        }
+    }
+
+    void testAppendedMessages()
+    {
+        QBuffer device;
+        device.open(QIODevice::ReadWrite);
+        {
+            Message batch(1, Protocol::MessageBatch);
+            for (int i = 0; i < 10; ++i) {
+                Message msg(42, Protocol::ModelContentReply);
+                writeModelContent(msg, i);
+                batch.append(msg);
+            }
+            Message msg(43, Protocol::ModelRowColumnCountReply);
+            batch.append(msg);
+            batch.write(&device);
+        }
+
+        device.seek(0);
+        QVERIFY(Message::canReadMessage(&device));
+        const auto batch = Message::readMessage(&device);
+        QCOMPARE(batch.type(), Protocol::MessageType(Protocol::MessageBatch));
+        for (int i = 0; i < 10; ++i) {
+            QVERIFY(batch.canReadAppendedMessage());
+            const auto msg = batch.readAppendedMessage();
+            QCOMPARE(msg.address(), Protocol::ObjectAddress(42));
+            QCOMPARE(msg.type(), Protocol::MessageType(Protocol::ModelContentReply));
+            if (i) {
+                quint32 count;
+                msg >> count;
+                QCOMPARE(count, quint32(i));
+            } else {
+                QCOMPARE(msg.size(), 0);
+            }
+        }
+        QVERIFY(batch.canReadAppendedMessage());
+        const auto msg = batch.readAppendedMessage();
+        QCOMPARE(msg.address(), Protocol::ObjectAddress(43));
+        QCOMPARE(msg.size(), 0);
+        QVERIFY(!batch.canReadAppendedMessage());
+    }
+
+    void testModelContent()
+    {
+        Protocol::ModelContent content;
+        for (int i = 0; i < 10; ++i) {
+            Protocol::ModelIndex index;
+            index.push_back(Protocol::ModelIndexData(i, 1));
+            content.indexes.push_back(index);
+            QMap<int, QVariant> itemData;
+            itemData.insert(Qt::DisplayRole, QStringLiteral("item %1").arg(i));
+            if (i % 2)
+                itemData.insert(Qt::ToolTipRole, QStringLiteral("tool tip"));
+            // mixed value types for the same role
+            itemData.insert(Qt::UserRole, i % 3 ? QVariant(i) : QVariant(QStringLiteral("text")));
+            content.itemData.push_back(itemData);
+            content.flags.push_back(i == 5 ? Qt::NoItemFlags : Qt::ItemIsEnabled);
+        }
+
+        QBuffer device;
+        device.open(QIODevice::ReadWrite);
+        {
+            Message msg(42, Protocol::ModelContentReply);
+            msg << content;
+            msg.write(&device);
+        }
+
+        device.seek(0);
+        const auto msg = Message::readMessage(&device);
+        Protocol::ModelContent result;
+        msg >> result;
+        QCOMPARE(result.indexes.size(), content.indexes.size());
+        for (int i = 0; i < content.indexes.size(); ++i) {
+            QCOMPARE(result.indexes.at(i).size(), 1);
+            QCOMPARE(result.indexes.at(i).at(0).row, i);
+            QCOMPARE(result.indexes.at(i).at(0).column, 1);
+            QCOMPARE(result.itemData.at(i), content.itemData.at(i));
+            QCOMPARE(result.flags.at(i), content.flags.at(i));
+        }
+    }
+
+    void benchmarkWrite()
+    {
+        QBuffer device;
+        device.open(QIODevice::WriteOnly);
+        QBENCHMARK {
+            device.seek(0);
+            for (int i = 0; i < 100; ++i) {
+                Message msg(42, Protocol::ModelContentReply);
+                writeModelContent(msg, 50);
+                msg.write(&device);
+            }
+        }
+    }
+
+    void benchmarkStreamWrite()
+    {
+        QBuffer device;
+        device.open(QIODevice::WriteOnly);
+        MessageStream stream;
+        stream.setCompressionEnabled(true);
+        QBENCHMARK {
+            device.seek(0);
+            for (int i = 0; i < 100; ++i) {
+                Message msg(42, Protocol::ModelContentReply);
+                writeModelContent(msg, 50);
+                msg.write(&device, &stream);
+            }
+        }
+    }
+
+    void benchmarkBatchWrite()
+    {
+        QBuffer device;
+        device.open(QIODevice::WriteOnly);
+        MessageStream stream;
+        stream.setCompressionEnabled(true);
+        QBENCHMARK {
+            device.seek(0);
+            Message batch(1, Protocol::MessageBatch);
+            for (int i = 0; i < 100; ++i) {
+                Message msg(42, Protocol::ModelContentChanged);
+                msg << Protocol::ModelIndex() << Protocol::ModelIndex() << QVector<int>();
+                batch.append(msg);
+            }
+            batch.write(&device, &stream);
+        }
+    }
+
+    void benchmarkRead()
+    {
+        QBuffer device;
+        device.open(QIODevice::ReadWrite);
+        for (int i = 0; i < 100; ++i) {
+            Message msg(42, Protocol::ModelContentReply);
+            writeModelContent(msg, 50);
+            msg.write(&device);
+        }
+
+        QBENCHMARK {
+            device.seek(0);
+            while (Message::canReadMessage(&device)) {
+                const auto msg = Message::readMessage(&device);
+                quint32 count;
+                msg >> count;
+            }
+        }
+    }
+};
+
+QTEST_MAIN(MessageTest)
+
+#include "messagetest.moc"
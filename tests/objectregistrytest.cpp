@@ -0,0 +1,176 @@
+/*
+  objectregistrytest.cpp
+
+  This file is part of GammaRay, the Qt application inspection and
+  manipulation tool.
+
+  Copyright (C) 2019 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+
+  Licensees holding valid commercial KDAB GammaRay licenses may use this file in
+  accordance with GammaRay Commercial License Agreement provided with the Software.
+
+  Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config-gammaray.h>
+
+#include "core/objectregistry.h"
+
+#include <QtTest/qtest.h>
+#include <QAtomicInt>
+#include <QObject>
+#include <QThread>
+#include <QVector>
+
+#include <memory>
+#include <vector>
+
+using namespace GammaRay;
+
+namespace {
+class LookupThread : public QThread
+{
+public:
+    LookupThread(const ObjectRegistry *registry, const QVector<QObject *> &objects)
+        : m_registry(registry)
+        , m_objects(objects)
+    {
+    }
+
+    void run() override
+    {
+        while (!stop.load()) {
+            for (QObject *obj : m_objects) {
+                if (!m_registry->contains(obj))
+                    failures.ref();
+            }
+        }
+    }
+
+    QAtomicInt stop;
+    QAtomicInt failures;
+
+private:
+    const ObjectRegistry *m_registry;
+    QVector<QObject *> m_objects;
+};
+}
+
+class ObjectRegistryTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testInsertRemove()
+    {
+        ObjectRegistry registry;
+        QObject a, b;
+        QVERIFY(!registry.contains(&a));
+        QVERIFY(!registry.contains(nullptr));
+
+        QVERIFY(registry.insert(&a));
+        QVERIFY(!registry.insert(&a));
+        QVERIFY(registry.contains(&a));
+        QVERIFY(!registry.contains(&b));
+        QCOMPARE(registry.size(), 1);
+
+        QVERIFY(registry.insert(&b));
+        QVERIFY(registry.remove(&a));
+        QVERIFY(!registry.remove(&a));
+        QVERIFY(!registry.contains(&a));
+        QVERIFY(registry.contains(&b));
+        QCOMPARE(registry.size(), 1);
+
+        registry.clear();
+        QVERIFY(!registry.contains(&b));
+        QCOMPARE(registry.size(), 0);
+    }
+
+    void testGrowth()
+    {
+        std::vector<std::unique_ptr<QObject> > objects;
+        ObjectRegistry registry;
+        for (int i = 0; i < 10000; ++i) {
+            objects.emplace_back(new QObject);
+            QVERIFY(registry.insert(objects.back().get()));
+        }
+        QCOMPARE(registry.size(), 10000);
+
+        for (int i = 0; i < 10000; i += 2)
+            QVERIFY(registry.remove(objects.at(i).get()));
+        for (int i = 0; i < 10000; ++i)
+            QCOMPARE(registry.contains(objects.at(i).get()), i % 2 == 1);
+        QCOMPARE(registry.size(), 5000);
+
+        // reuses tombstones and rehashes without losing entries
+        for (int round = 0; round < 10; ++round) {
+            for (int i = 0; i < 10000; i += 2)
+                QVERIFY(registry.insert(objects.at(i).get()));
+            for (int i = 0; i < 10000; i += 2)
+                QVERIFY(registry.remove(objects.at(i).get()));
+        }
+        for (int i = 0; i < 10000; ++i)
+            QCOMPARE(registry.contains(objects.at(i).get()), i % 2 == 1);
+    }
+
+    void testConcurrentLookup()
+    {
+        std::vector<std::unique_ptr<QObject> > objects;
+        QVector<QObject *> stable;
+        QVector<QObject *> volatileObjects;
+        ObjectRegistry registry;
+        for (int i = 0; i < 2000; ++i) {
+            objects.emplace_back(new QObject);
+            if (i % 2) {
+                stable.push_back(objects.back().get());
+                registry.insert(objects.back().get());
+            } else {
+                volatileObjects.push_back(objects.back().get());
+            }
+        }
+
+        LookupThread reader(&registry, stable);
+        reader.start();
+        for (int round = 0; round < 100; ++round) {
+            for (QObject *obj : volatileObjects)
+                registry.insert(obj);
+            for (QObject *obj : volatileObjects)
+                registry.remove(obj);
+        }
+        reader.stop.ref();
+        QVERIFY(reader.wait());
+        QCOMPARE(reader.failures.load(), 0);
+        QCOMPARE(registry.size(), stable.size());
+    }
+
+    void benchmarkContains()
+    {
+        std::vector<std::unique_ptr<QObject> > objects;
+        ObjectRegistry registry;
+        for (int i = 0; i < 10000; ++i) {
+            objects.emplace_back(new QObject);
+            registry.insert(objects.back().get());
+        }
+
+        QBENCHMARK {
+            for (const auto &obj : objects)
+                registry.contains(obj.get());
+        }
+    }
+};
+
+QTEST_MAIN(ObjectRegistryTest)
+
+#include "objectregistrytest.moc"
@@ -34,6 +34,7 @@
 #include <QDebug>
 #include <QtTest/qtest.h>
 #include <QObject>
+#include <QPointer>
 #include <QSignalSpy>
 #include <QSortFilterProxyModel>
 #include <QStandardItemModel>
@@ -58,6 +59,11 @@ public:
         FakeRemoteModelServer::s_registerServerCallback = &fakeRegisterServer;
     }
 
+    int nodeHandleCount() const
+    {
+        return m_nodeHandles.size();
+    }
+
 signals:
     void message(const GammaRay::Message &msg);
 
@@ -69,17 +75,60 @@ private slots:
         emit message(Message::readMessage(&buffer));
     }
 
+    void deliverMessageTo(QObject *client, const QByteArray &ba)
+    {
+        // the client might have been destroyed meanwhile
+        if (!m_clients.contains(client))
+            return;
+        QBuffer buffer(const_cast<QByteArray*>(&ba));
+        buffer.open(QIODevice::ReadOnly);
+        qobject_cast<RemoteModel*>(client)->newMessage(Message::readMessage(&buffer));
+    }
+
 private:
-    bool isConnected() const override { return true; }
-    void sendMessage(const Message &msg) const override
+    static QByteArray serialize(const Message &msg)
     {
         QByteArray ba;
         QBuffer buffer(&ba);
         buffer.open(QIODevice::WriteOnly);
         msg.write(&buffer);
         buffer.close();
-        QMetaObject::invokeMethod(const_cast<FakeRemoteModelServer*>(this), "deliverMessage", Qt::QueuedConnection, Q_ARG(QByteArray, ba));
+        return ba;
     }
+
+    bool isConnected() const override { return true; }
+    void sendMessage(const Message &msg) const override
+    {
+        QMetaObject::invokeMethod(const_cast<FakeRemoteModelServer*>(this), "deliverMessage", Qt::QueuedConnection, Q_ARG(QByteArray, serialize(msg)));
+    }
+    void sendReply(const Message &msg) const override
+    {
+        sendMessage(msg);
+    }
+    // clients are identified by the FakeRemoteModel whose message() signal delivered the request
+    QObject *currentClient() const override
+    {
+        auto client = sender();
+        if (client && !m_clients.contains(client))
+            m_clients.push_back(client);
+        return client;
+    }
+    QVector<QObject*> clients() const override
+    {
+        QVector<QObject*> clients;
+        for (const auto &client : m_clients) {
+            if (client)
+                clients.push_back(client);
+        }
+        return clients;
+    }
+    void sendMessageTo(QObject *client, const Message &msg) const override
+    {
+        QMetaObject::invokeMethod(const_cast<FakeRemoteModelServer*>(this), "deliverMessageTo", Qt::QueuedConnection,
+                                  Q_ARG(QObject*, client), Q_ARG(QByteArray, serialize(msg)));
+    }
+
+    mutable QVector<QPointer<QObject> > m_clients;
 };
 
 class FakeRemoteModel : public RemoteModel
@@ -208,6 +257,245 @@ private slots:
         QCOMPARE(client.rowCount(), 4);
     }
 
+    void testListRemoteModelColumnar()
+    {
+        Message::setNegotiatedFeatures(Protocol::ColumnarModelContent);
+        testListRemoteModel();
+        Message::resetNegotiatedDataVersion();
+    }
+
+    void testDataChangedCoalescing()
+    {
+        QScopedPointer<QStandardItemModel> listModel(new QStandardItemModel(this));
+        for (int i = 0; i < 10; ++i)
+            listModel->appendRow(new QStandardItem(QStringLiteral("entry%1").arg(i)));
+
+        FakeRemoteModelServer server(QStringLiteral("com.kdab.GammaRay.UnitTest.Coalescing"), this);
+        server.setModel(listModel.data());
+        server.modelMonitored(true);
+
+        FakeRemoteModel client(QStringLiteral("com.kdab.GammaRay.UnitTest.Coalescing"), this);
+        connect(&server, &FakeRemoteModelServer::message, &client,
+                &RemoteModel::newMessage);
+        connect(&client, &FakeRemoteModel::message, &server,
+                &RemoteModelServer::newRequest);
+
+        QTRY_COMPARE(client.rowCount(), 10);
+        for (int i = 0; i < 10; ++i)
+            QVERIFY(waitForData(client.index(i, 0)));
+
+        QSignalSpy spy(&client, SIGNAL(dataChanged(QModelIndex,QModelIndex)));
+        QVERIFY(spy.isValid());
+
+        // overlapping and adjacent changes within one event loop iteration end up as one range
+        listModel->item(2)->setText(QStringLiteral("changed2"));
+        listModel->item(1)->setText(QStringLiteral("changed1"));
+        listModel->item(3)->setText(QStringLiteral("changed3"));
+        listModel->item(2)->setText(QStringLiteral("changed2b"));
+        listModel->item(7)->setText(QStringLiteral("changed7"));
+
+        QTRY_COMPARE(spy.size(), 2);
+        QTest::qWait(10);
+        QCOMPARE(spy.size(), 2);
+        QCOMPARE(spy.at(0).at(0).toModelIndex().row(), 1);
+        QCOMPARE(spy.at(0).at(1).toModelIndex().row(), 3);
+        QCOMPARE(spy.at(1).at(0).toModelIndex().row(), 7);
+        QCOMPARE(spy.at(1).at(1).toModelIndex().row(), 7);
+
+        QVERIFY(waitForData(client.index(2, 0)));
+        QCOMPARE(client.index(2, 0).data().toString(), QStringLiteral("changed2b"));
+        QVERIFY(waitForData(client.index(7, 0)));
+        QCOMPARE(client.index(7, 0).data().toString(), QStringLiteral("changed7"));
+
+        // pending changes go out ahead of structural changes
+        spy.clear();
+        listModel->item(5)->setText(QStringLiteral("changed5"));
+        listModel->removeRow(0);
+        QTRY_COMPARE(client.rowCount(), 9);
+        QCOMPARE(spy.size(), 1);
+        QCOMPARE(spy.at(0).at(0).toModelIndex().row(), 5);
+    }
+
+    void testPushVisibleContent()
+    {
+        QScopedPointer<QStandardItemModel> listModel(new QStandardItemModel(this));
+        for (int i = 0; i < 10; ++i)
+            listModel->appendRow(new QStandardItem(QStringLiteral("entry%1").arg(i)));
+
+        FakeRemoteModelServer server(QStringLiteral("com.kdab.GammaRay.UnitTest.Push"), this);
+        server.setModel(listModel.data());
+        server.modelMonitored(true);
+
+        FakeRemoteModel client(QStringLiteral("com.kdab.GammaRay.UnitTest.Push"), this);
+        connect(&server, &FakeRemoteModelServer::message, &client,
+                &RemoteModel::newMessage);
+        connect(&client, &FakeRemoteModel::message, &server,
+                &RemoteModelServer::newRequest);
+
+        QTRY_COMPARE(client.rowCount(), 10);
+        for (int i = 0; i < 10; ++i)
+            QVERIFY(waitForData(client.index(i, 0)));
+
+        client.setVisibleRegion(QItemSelection(client.index(2, 0), client.index(4, 0)));
+
+        QSignalSpy spy(&client, SIGNAL(dataChanged(QModelIndex,QModelIndex)));
+        QVERIFY(spy.isValid());
+        listModel->item(3)->setText(QStringLiteral("changed3"));
+        listModel->item(8)->setText(QStringLiteral("changed8"));
+        QTRY_COMPARE(spy.size(), 2);
+
+        // visible cells are up to date without another request, the others only invalidated
+        const auto loadingState = [](const QModelIndex &index) {
+            return index.data(RemoteModelRole::LoadingState).value<RemoteModelNodeState::NodeStates>();
+        };
+        QCOMPARE(int(loadingState(client.index(3, 0))), int(RemoteModelNodeState::NoState));
+        QCOMPARE(client.index(3, 0).data().toString(), QStringLiteral("changed3"));
+        QVERIFY(loadingState(client.index(8, 0)) & RemoteModelNodeState::Outdated);
+
+        // and back to invalidations only
+        client.setVisibleRegion(QItemSelection());
+        spy.clear();
+        listModel->item(3)->setText(QStringLiteral("changed3b"));
+        QTRY_COMPARE(spy.size(), 1);
+        QVERIFY(loadingState(client.index(3, 0)) & RemoteModelNodeState::Outdated);
+        QVERIFY(waitForData(client.index(3, 0)));
+        QCOMPARE(client.index(3, 0).data().toString(), QStringLiteral("changed3b"));
+    }
+
+    void testPushVisibleContentPerClient()
+    {
+        QScopedPointer<QStandardItemModel> listModel(new QStandardItemModel(this));
+        for (int i = 0; i < 10; ++i)
+            listModel->appendRow(new QStandardItem(QStringLiteral("entry%1").arg(i)));
+
+        FakeRemoteModelServer server(QStringLiteral("com.kdab.GammaRay.UnitTest.PushPerClient"), this);
+        server.setModel(listModel.data());
+        server.modelMonitored(true);
+
+        FakeRemoteModel client1(QStringLiteral("com.kdab.GammaRay.UnitTest.PushPerClient"), this);
+        connect(&server, &FakeRemoteModelServer::message, &client1,
+                &RemoteModel::newMessage);
+        connect(&client1, &FakeRemoteModel::message, &server,
+                &RemoteModelServer::newRequest);
+        FakeRemoteModel client2(QStringLiteral("com.kdab.GammaRay.UnitTest.PushPerClient"), this);
+        connect(&server, &FakeRemoteModelServer::message, &client2,
+                &RemoteModel::newMessage);
+        connect(&client2, &FakeRemoteModel::message, &server,
+                &RemoteModelServer::newRequest);
+
+        QTRY_COMPARE(client1.rowCount(), 10);
+        QTRY_COMPARE(client2.rowCount(), 10);
+        for (int i = 0; i < 10; ++i) {
+            QVERIFY(waitForData(client1.index(i, 0)));
+            QVERIFY(waitForData(client2.index(i, 0)));
+        }
+
+        client1.setVisibleRegion(QItemSelection(client1.index(2, 0), client1.index(4, 0)));
+        client2.setVisibleRegion(QItemSelection(client2.index(6, 0), client2.index(8, 0)));
+
+        QSignalSpy spy1(&client1, SIGNAL(dataChanged(QModelIndex,QModelIndex)));
+        QVERIFY(spy1.isValid());
+        QSignalSpy spy2(&client2, SIGNAL(dataChanged(QModelIndex,QModelIndex)));
+        QVERIFY(spy2.isValid());
+        listModel->item(3)->setText(QStringLiteral("changed3"));
+        listModel->item(7)->setText(QStringLiteral("changed7"));
+        QTRY_COMPARE(spy1.size(), 2);
+        QTRY_COMPARE(spy2.size(), 2);
+
+        // each client only gets the content it shows itself
+        const auto loadingState = [](const QModelIndex &index) {
+            return index.data(RemoteModelRole::LoadingState).value<RemoteModelNodeState::NodeStates>();
+        };
+        QCOMPARE(int(loadingState(client1.index(3, 0))), int(RemoteModelNodeState::NoState));
+        QCOMPARE(client1.index(3, 0).data().toString(), QStringLiteral("changed3"));
+        QVERIFY(loadingState(client1.index(7, 0)) & RemoteModelNodeState::Outdated);
+        QCOMPARE(int(loadingState(client2.index(7, 0))), int(RemoteModelNodeState::NoState));
+        QCOMPARE(client2.index(7, 0).data().toString(), QStringLiteral("changed7"));
+        QVERIFY(loadingState(client2.index(3, 0)) & RemoteModelNodeState::Outdated);
+    }
+
+    void testViewportPrefetch()
+    {
+        QScopedPointer<QStandardItemModel> listModel(new QStandardItemModel(this));
+        for (int i = 0; i < 1000; ++i)
+            listModel->appendRow(new QStandardItem(QStringLiteral("entry%1").arg(i)));
+
+        FakeRemoteModelServer server(QStringLiteral("com.kdab.GammaRay.UnitTest.Viewport"), this);
+        server.setModel(listModel.data());
+        server.modelMonitored(true);
+
+        FakeRemoteModel client(QStringLiteral("com.kdab.GammaRay.UnitTest.Viewport"), this);
+        connect(&server, &FakeRemoteModelServer::message, &client,
+                &RemoteModel::newMessage);
+        connect(&client, &FakeRemoteModel::message, &server,
+                &RemoteModelServer::newRequest);
+
+        QTRY_COMPARE(client.rowCount(), 1000);
+        const auto loadingState = [&client](int row) {
+            return client.index(row, 0).data(RemoteModelRole::LoadingState).value<RemoteModelNodeState::NodeStates>();
+        };
+
+        // a request for a row the view scrolls away from before it is sent is dropped
+        client.index(100, 0).data();
+        QVERIFY(loadingState(100) & RemoteModelNodeState::Loading);
+        client.setViewport(this, QItemSelection(client.index(500, 0), client.index(509, 0)));
+
+        // one page around the visible rows is prefetched
+        QTRY_COMPARE(int(loadingState(505)), int(RemoteModelNodeState::NoState));
+        QCOMPARE(int(loadingState(490)), int(RemoteModelNodeState::NoState));
+        QCOMPARE(int(loadingState(519)), int(RemoteModelNodeState::NoState));
+        QCOMPARE(client.index(519, 0).data().toString(), QStringLiteral("entry519"));
+        QVERIFY(loadingState(489) & RemoteModelNodeState::Empty);
+        QVERIFY(loadingState(520) & RemoteModelNodeState::Empty);
+        QCOMPARE(int(loadingState(100)), int(RemoteModelNodeState::Empty | RemoteModelNodeState::Outdated));
+
+        // asking again afterwards works
+        QVERIFY(waitForData(client.index(100, 0)));
+        QCOMPARE(client.index(100, 0).data().toString(), QStringLiteral("entry100"));
+
+        client.setViewport(this, QItemSelection());
+    }
+
+    void testCacheEviction()
+    {
+        QScopedPointer<QStandardItemModel> listModel(new QStandardItemModel(this));
+        for (int i = 0; i < 100; ++i)
+            listModel->appendRow(new QStandardItem(QStringLiteral("entry%1").arg(i)));
+
+        FakeRemoteModelServer server(QStringLiteral("com.kdab.GammaRay.UnitTest.Cache"), this);
+        server.setModel(listModel.data());
+        server.modelMonitored(true);
+
+        FakeRemoteModel client(QStringLiteral("com.kdab.GammaRay.UnitTest.Cache"), this);
+        connect(&server, &FakeRemoteModelServer::message, &client,
+                &RemoteModel::newMessage);
+        connect(&client, &FakeRemoteModel::message, &server,
+                &RemoteModelServer::newRequest);
+        client.setCacheBudget(2048);
+
+        QTRY_COMPARE(client.rowCount(), 100);
+        const auto loadingState = [&client](int row) {
+            return client.index(row, 0).data(RemoteModelRole::LoadingState).value<RemoteModelNodeState::NodeStates>();
+        };
+
+        // row 0 is looked at all the time, so it stays while everything else gets scrolled through
+        for (int row = 0; row < 100; ++row) {
+            QVERIFY(waitForData(client.index(row, 0)));
+            QCOMPARE(client.index(0, 0).data().toString(), QStringLiteral("entry0"));
+        }
+        QCOMPARE(int(loadingState(0)), int(RemoteModelNodeState::NoState));
+        QCOMPARE(int(loadingState(99)), int(RemoteModelNodeState::NoState));
+        QCOMPARE(int(loadingState(1)), int(RemoteModelNodeState::Empty | RemoteModelNodeState::Outdated));
+
+        // evicted data is fetched again on demand
+        QVERIFY(waitForData(client.index(1, 0)));
+        QCOMPARE(client.index(1, 0).data().toString(), QStringLiteral("entry1"));
+
+        client.setCacheBudget(0);
+        QCOMPARE(int(loadingState(0)), int(RemoteModelNodeState::Empty | RemoteModelNodeState::Outdated));
+        QCOMPARE(client.rowCount(), 100);
+    }
+
     void testTreeRemoteModel()
     {
         QScopedPointer<QStandardItemModel> treeModel(new QStandardItemModel(this));
@@ -263,6 +551,278 @@ private slots:
         QCOMPARE(i11.data().toString(), QStringLiteral("entry11"));
     }
 
+    void testSubtreeFetch()
+    {
+        QScopedPointer<QStandardItemModel> treeModel(new QStandardItemModel(this));
+        for (int i = 0; i < 3; ++i) {
+            auto item = new QStandardItem(QStringLiteral("entry%1").arg(i));
+            for (int j = 0; j < 3; ++j) {
+                auto child = new QStandardItem(QStringLiteral("entry%1%2").arg(i).arg(j));
+                for (int k = 0; k < 2; ++k)
+                    child->appendRow(new QStandardItem(QStringLiteral("entry%1%2%3").arg(i).arg(j).arg(k)));
+                item->appendRow(child);
+            }
+            treeModel->appendRow(item);
+        }
+
+        FakeRemoteModelServer server(QStringLiteral("com.kdab.GammaRay.UnitTest.Subtree"), this);
+        server.setModel(treeModel.data());
+        server.modelMonitored(true);
+
+        FakeRemoteModel client(QStringLiteral("com.kdab.GammaRay.UnitTest.Subtree"), this);
+        connect(&server, &FakeRemoteModelServer::message, &client,
+                &RemoteModel::newMessage);
+        connect(&client, &FakeRemoteModel::message, &server,
+                &RemoteModelServer::newRequest);
+        QVector<Protocol::MessageType> requests;
+        connect(&client, &FakeRemoteModel::message, this, [&requests](const GammaRay::Message &msg) {
+            requests.push_back(msg.type());
+        });
+
+        // everything below the root in one go
+        client.fetchSubtree(QModelIndex(), -1);
+        QCOMPARE(client.rowCount(), 0); // must not ask separately while that is on its way
+        QTRY_COMPARE(client.rowCount(), 3);
+        const auto i1 = client.index(1, 0);
+        QCOMPARE(client.rowCount(i1), 3);
+        const auto i12 = client.index(2, 0, i1);
+        QCOMPARE(client.rowCount(i12), 2);
+        const auto i121 = client.index(1, 0, i12);
+        QCOMPARE(client.rowCount(i121), 0);
+        QCOMPARE(int(i121.data(RemoteModelRole::LoadingState).value<RemoteModelNodeState::NodeStates>()), int(RemoteModelNodeState::NoState));
+        QCOMPARE(i121.data().toString(), QStringLiteral("entry121"));
+        QCOMPARE(requests, QVector<Protocol::MessageType>() << Protocol::ModelSubtreeRequest);
+
+        // limited depth, only the direct children of i2 and their row counts are known afterwards
+        FakeRemoteModel client2(QStringLiteral("com.kdab.GammaRay.UnitTest.Subtree"), this);
+        connect(&server, &FakeRemoteModelServer::message, &client2,
+                &RemoteModel::newMessage);
+        connect(&client2, &FakeRemoteModel::message, &server,
+                &RemoteModelServer::newRequest);
+        connect(&client2, &FakeRemoteModel::message, this, [&requests](const GammaRay::Message &msg) {
+            requests.push_back(msg.type());
+        });
+        QTRY_COMPARE(client2.rowCount(), 3);
+        const auto i2 = client2.index(2, 0);
+        requests.clear();
+        client2.fetchSubtree(i2, 0);
+        QTRY_COMPARE(client2.rowCount(i2), 3);
+        const auto i20 = client2.index(0, 0, i2);
+        QCOMPARE(client2.rowCount(i20), 2);
+        QCOMPARE(int(i20.data(RemoteModelRole::LoadingState).value<RemoteModelNodeState::NodeStates>()), int(RemoteModelNodeState::NoState));
+        QCOMPARE(requests, QVector<Protocol::MessageType>() << Protocol::ModelSubtreeRequest);
+        const auto i200 = client2.index(0, 0, i20);
+        QVERIFY(i200.data(RemoteModelRole::LoadingState).value<RemoteModelNodeState::NodeStates>() & RemoteModelNodeState::Empty);
+    }
+
+    void testSubtreeRootRemoved()
+    {
+        QScopedPointer<QStandardItemModel> treeModel(new QStandardItemModel(this));
+        for (int i = 0; i < 3; ++i) {
+            auto item = new QStandardItem(QStringLiteral("entry%1").arg(i));
+            for (int j = 0; j < 2; ++j)
+                item->appendRow(new QStandardItem(QStringLiteral("entry%1%2").arg(i).arg(j)));
+            treeModel->appendRow(item);
+        }
+
+        FakeRemoteModelServer server(QStringLiteral("com.kdab.GammaRay.UnitTest.SubtreeRemoved"), this);
+        server.setModel(treeModel.data());
+        server.modelMonitored(true);
+
+        FakeRemoteModel client(QStringLiteral("com.kdab.GammaRay.UnitTest.SubtreeRemoved"), this);
+        connect(&server, &FakeRemoteModelServer::message, &client,
+                &RemoteModel::newMessage);
+        // requests can be held back, to have the server state change while they are on their way
+        bool holdRequests = false;
+        QVector<QByteArray> heldRequests;
+        QVector<Protocol::MessageType> requests;
+        connect(&client, &FakeRemoteModel::message, &server, [&](const GammaRay::Message &msg) {
+            requests.push_back(msg.type());
+            if (!holdRequests) {
+                server.newRequest(msg);
+                return;
+            }
+            QByteArray ba;
+            QBuffer buffer(&ba);
+            buffer.open(QIODevice::WriteOnly);
+            msg.write(&buffer);
+            heldRequests.push_back(ba);
+        });
+
+        QTRY_COMPARE(client.rowCount(), 3);
+        holdRequests = true;
+        client.fetchSubtree(client.index(1, 0), -1);
+        QCOMPARE(heldRequests.size(), 1);
+
+        treeModel->removeRow(1);
+        QTRY_COMPARE(client.rowCount(), 2);
+
+        holdRequests = false;
+        QBuffer buffer(&heldRequests[0]);
+        buffer.open(QIODevice::ReadOnly);
+        server.newRequest(Message::readMessage(&buffer));
+        QTest::qWait(1);
+
+        // the reply belongs to a deleted node, so it's ignored and the new row is asked for normally
+        requests.clear();
+        const auto i1 = client.index(1, 0);
+        QCOMPARE(client.rowCount(i1), 0);
+        QTRY_COMPARE(client.rowCount(i1), 2);
+        QVERIFY(requests.contains(Protocol::ModelRowColumnCountRequest));
+        const auto i10 = client.index(0, 0, i1);
+        QVERIFY(waitForData(i10));
+        QCOMPARE(i10.data().toString(), QStringLiteral("entry20"));
+    }
+
+    void testTreeRemoteModelNodeHandles()
+    {
+        QScopedPointer<QStandardItemModel> treeModel(new QStandardItemModel(this));
+        auto e0 = new QStandardItem(QStringLiteral("entry0"));
+        auto e00 = new QStandardItem(QStringLiteral("entry00"));
+        e00->appendRow(new QStandardItem(QStringLiteral("entry000")));
+        e0->appendRow(e00);
+        treeModel->appendRow(e0);
+
+        FakeRemoteModelServer server(QStringLiteral("com.kdab.GammaRay.UnitTest.NodeHandleModel"), this);
+        server.setModel(treeModel.data());
+        server.modelMonitored(true);
+
+        FakeRemoteModel client(QStringLiteral("com.kdab.GammaRay.UnitTest.NodeHandleModel"), this);
+        connect(&server, &FakeRemoteModelServer::message, &client,
+                &RemoteModel::newMessage);
+        connect(&client, &FakeRemoteModel::message, &server,
+                &RemoteModelServer::newRequest);
+
+        ModelTest modelTest(&client);
+        QTest::qWait(25);
+
+        auto i0 = client.index(0, 0);
+        QTRY_COMPARE(client.rowCount(i0), 1);
+        auto i00 = client.index(0, 0, i0);
+        QTRY_COMPARE(client.rowCount(i00), 1);
+        auto i000 = client.index(0, 0, i00);
+        QVERIFY(waitForData(i000));
+        QCOMPARE(i000.data().toString(), QStringLiteral("entry000"));
+
+        // shifts the path of all existing nodes, handles have to follow that
+        treeModel->insertRow(0, new QStandardItem(QStringLiteral("entry-1")));
+        QTest::qWait(10);
+        QCOMPARE(client.rowCount(), 2);
+
+        e00->appendRow(new QStandardItem(QStringLiteral("entry001")));
+        QTest::qWait(10);
+        i0 = client.index(1, 0);
+        i00 = client.index(0, 0, i0);
+        QCOMPARE(client.rowCount(i00), 2);
+        auto i001 = client.index(1, 0, i00);
+        QVERIFY(waitForData(i001));
+        QCOMPARE(i001.data().toString(), QStringLiteral("entry001"));
+
+        e00->child(0)->setText(QStringLiteral("entry000 changed"));
+        i000 = client.index(0, 0, i00);
+        QTRY_COMPARE(i000.data().toString(), QStringLiteral("entry000 changed"));
+    }
+
+    void testNodeHandleOfEmptiedNode()
+    {
+        QScopedPointer<QStandardItemModel> treeModel(new QStandardItemModel(this));
+        auto e0 = new QStandardItem(QStringLiteral("entry0"));
+        e0->appendRow(new QStandardItem(QStringLiteral("entry00")));
+        treeModel->appendRow(e0);
+
+        FakeRemoteModelServer server(QStringLiteral("com.kdab.GammaRay.UnitTest.EmptiedNodeHandle"), this);
+        server.setModel(treeModel.data());
+        server.modelMonitored(true);
+
+        // gets e0 assigned a handle while it has children
+        FakeRemoteModel client(QStringLiteral("com.kdab.GammaRay.UnitTest.EmptiedNodeHandle"), this);
+        connect(&server, &FakeRemoteModelServer::message, &client,
+                &RemoteModel::newMessage);
+        connect(&client, &FakeRemoteModel::message, &server,
+                &RemoteModelServer::newRequest);
+        QTRY_COMPARE(client.rowCount(), 1);
+        QTRY_COMPARE(client.rowCount(client.index(0, 0)), 1);
+
+        const auto deleteMe = e0->takeRow(0);
+        qDeleteAll(deleteMe);
+        QTRY_COMPARE(client.rowCount(client.index(0, 0)), 0);
+
+        // discovers e0 only while it is empty
+        FakeRemoteModel client2(QStringLiteral("com.kdab.GammaRay.UnitTest.EmptiedNodeHandle"), this);
+        connect(&server, &FakeRemoteModelServer::message, &client2,
+                &RemoteModel::newMessage);
+        connect(&client2, &FakeRemoteModel::message, &server,
+                &RemoteModelServer::newRequest);
+        QTRY_COMPARE(client2.rowCount(), 1);
+        auto i0 = client2.index(0, 0);
+        client2.rowCount(i0);
+        QTest::qWait(10);
+        QCOMPARE(client2.rowCount(i0), 0);
+
+        // the children are now addressed relative to e0's handle
+        e0->appendRow(new QStandardItem(QStringLiteral("entry01")));
+        QTRY_COMPARE(client2.rowCount(i0), 1);
+        const auto i01 = client2.index(0, 0, i0);
+        QVERIFY(waitForData(i01));
+        QCOMPARE(i01.data().toString(), QStringLiteral("entry01"));
+    }
+
+    void testNodeHandleOfLeaf()
+    {
+        QScopedPointer<QStandardItemModel> treeModel(new QStandardItemModel(this));
+        auto e0 = new QStandardItem(QStringLiteral("entry0"));
+        treeModel->appendRow(e0);
+        treeModel->appendRow(new QStandardItem(QStringLiteral("entry1")));
+
+        FakeRemoteModelServer server(QStringLiteral("com.kdab.GammaRay.UnitTest.LeafNodeHandle"), this);
+        server.setModel(treeModel.data());
+        server.modelMonitored(true);
+
+        FakeRemoteModel client(QStringLiteral("com.kdab.GammaRay.UnitTest.LeafNodeHandle"), this);
+        connect(&server, &FakeRemoteModelServer::message, &client,
+                &RemoteModel::newMessage);
+        connect(&client, &FakeRemoteModel::message, &server,
+                &RemoteModelServer::newRequest);
+        FakeRemoteModel client2(QStringLiteral("com.kdab.GammaRay.UnitTest.LeafNodeHandle"), this);
+        connect(&server, &FakeRemoteModelServer::message, &client2,
+                &RemoteModel::newMessage);
+        connect(&client2, &FakeRemoteModel::message, &server,
+                &RemoteModelServer::newRequest);
+
+        // leaves don't get a handle
+        QTRY_COMPARE(client.rowCount(), 2);
+        QTRY_COMPARE(client2.rowCount(), 2);
+        auto i0 = client.index(0, 0);
+        auto i0b = client2.index(0, 0);
+        client.rowCount(i0);
+        client2.rowCount(i0b);
+        QTest::qWait(10);
+        QCOMPARE(client.rowCount(i0), 0);
+        QCOMPARE(client2.rowCount(i0b), 0);
+        QCOMPARE(server.nodeHandleCount(), 0);
+
+        // until they get children, which are addressed relative to it for both clients then
+        e0->appendRow(new QStandardItem(QStringLiteral("entry00")));
+        QTRY_COMPARE(client.rowCount(i0), 1);
+        QTRY_COMPARE(client2.rowCount(i0b), 1);
+        QCOMPARE(server.nodeHandleCount(), 1);
+        QVERIFY(waitForData(client.index(0, 0, i0)));
+        QVERIFY(waitForData(client2.index(0, 0, i0b)));
+        QCOMPARE(client2.index(0, 0, i0b).data().toString(), QStringLiteral("entry00"));
+
+        // shifting the node doesn't affect its handle
+        treeModel->insertRow(0, new QStandardItem(QStringLiteral("entry-1")));
+        QTRY_COMPARE(client.rowCount(), 3);
+        e0->child(0)->setText(QStringLiteral("entry00 changed"));
+        i0 = client.index(1, 0);
+        QTRY_COMPARE(client.index(0, 0, i0).data().toString(), QStringLiteral("entry00 changed"));
+
+        // and removing it drops the handle
+        treeModel->removeRow(1);
+        QTRY_COMPARE(client.rowCount(), 2);
+        QCOMPARE(server.nodeHandleCount(), 0);
+    }
+
     // this should not make a difference if the above works, however it broke massively with Qt 5.4...
     void testSortProxy()
     {
@@ -320,6 +880,43 @@ private slots:
 // QEXPECT_FAIL("", "QSFPM misbehavior, no idea yet where this is coming from", Continue);
         QCOMPARE(proxy.rowCount(pi1), 2);
     }
+
+    void testUnserializableData()
+    {
+        QScopedPointer<QStandardItemModel> listModel(new QStandardItemModel(this));
+        for (int i = 0; i < 2; ++i) {
+            auto item = new QStandardItem(QStringLiteral("entry%1").arg(i));
+            item->setData(QVariantList({ 42, QStringLiteral("text") }), Qt::UserRole);
+            // only serializable elements for the first item
+            if (i)
+                item->setData(QVariantList({ 42, QVariant::fromValue<QObject *>(this) }), Qt::UserRole + 1);
+            else
+                item->setData(QVariantList({ 23 }), Qt::UserRole + 1);
+            item->setData(QVariant::fromValue<QObject *>(this), Qt::UserRole + 2);
+            listModel->appendRow(item);
+        }
+
+        FakeRemoteModelServer server(QStringLiteral("com.kdab.GammaRay.UnitTest.UnserializableData"), this);
+        server.setModel(listModel.data());
+        server.modelMonitored(true);
+
+        FakeRemoteModel client(QStringLiteral("com.kdab.GammaRay.UnitTest.UnserializableData"), this);
+        connect(&server, &FakeRemoteModelServer::message, &client,
+                &RemoteModel::newMessage);
+        connect(&client, &FakeRemoteModel::message, &server,
+                &RemoteModelServer::newRequest);
+
+        QTRY_COMPARE(client.rowCount(), 2);
+
+        for (int i = 0; i < 2; ++i) {
+            const auto index = client.index(i, 0);
+            QVERIFY(waitForData(index));
+            QCOMPARE(index.data().toString(), QStringLiteral("entry%1").arg(i));
+            QCOMPARE(index.data(Qt::UserRole).toList().size(), 2);
+            QCOMPARE(index.data(Qt::UserRole + 1).isValid(), i == 0);
+            QVERIFY(!index.data(Qt::UserRole + 2).isValid());
+        }
+    }
 };
 
 QTEST_MAIN(RemoteModelTest)
@@ -0,0 +1,182 @@
+/*
+  sharedmemorydevicetest.cpp
+
+  This file is part of GammaRay, the Qt application inspection and
+  manipulation tool.
+
+  Copyright (C) 2019 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+
+  Licensees holding valid commercial KDAB GammaRay licenses may use this file in
+  accordance with GammaRay Commercial License Agreement provided with the Software.
+
+  Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common/sharedmemorydevice.h>
+
+#include <QtTest/qtest.h>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QRegularExpression>
+#include <QSharedMemory>
+#include <QSignalSpy>
+
+#include <memory>
+
+using namespace GammaRay;
+
+class SharedMemoryDeviceTest : public QObject
+{
+    Q_OBJECT
+private:
+    // small rings, so we exercise wrapping and backpressure
+    static const int RingSize = 4096;
+
+    void createDevices(int ringSize = RingSize)
+    {
+        const QString name = QStringLiteral("gammaray-shmtest-%1").arg(QCoreApplication::applicationPid());
+        QLocalServer::removeServer(name);
+        QVERIFY(m_server.listen(name));
+
+        m_clientSocket.reset(new QLocalSocket);
+        m_clientSocket->connectToServer(name);
+        QVERIFY(m_clientSocket->waitForConnected(1000));
+        QVERIFY(m_server.waitForNewConnection(1000));
+        m_serverSocket.reset(m_server.nextPendingConnection());
+        m_serverSocket->setParent(nullptr);
+
+        const QString key = name + QString::number(++m_segmentCount);
+        auto serverSegment = SharedMemoryDevice::createSegment(key, ringSize);
+        QVERIFY(serverSegment);
+        auto clientSegment = SharedMemoryDevice::attachSegment(key);
+        QVERIFY(clientSegment);
+#ifdef Q_OS_UNIX
+        // removed once attached, so nothing is left behind after a crash
+        QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QStringLiteral("^Failed to attach to shared memory segment")));
+        QVERIFY(!SharedMemoryDevice::attachSegment(key));
+#endif
+
+        m_serverDevice.reset(new SharedMemoryDevice(serverSegment, m_serverSocket.get(), SharedMemoryDevice::ServerRole));
+        m_clientDevice.reset(new SharedMemoryDevice(clientSegment, m_clientSocket.get(), SharedMemoryDevice::ClientRole));
+    }
+
+    static QByteArray testData(int size)
+    {
+        QByteArray data(size, Qt::Uninitialized);
+        for (int i = 0; i < size; ++i)
+            data[i] = char(i * 7);
+        return data;
+    }
+
+    static QByteArray transfer(SharedMemoryDevice *sender, SharedMemoryDevice *receiver, const QByteArray &data)
+    {
+        sender->write(data);
+        QByteArray received;
+        QElapsedTimer timer;
+        timer.start();
+        while (received.size() < data.size() && timer.elapsed() < 5000) {
+            received += receiver->readAll();
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+        }
+        return received;
+    }
+
+private slots:
+    void cleanup()
+    {
+        m_serverDevice.reset();
+        m_clientDevice.reset();
+        m_serverSocket.reset();
+        m_clientSocket.reset();
+        m_server.close();
+    }
+
+    void testTransfer_data()
+    {
+        QTest::addColumn<int>("size");
+        QTest::newRow("small") << 42;
+        QTest::newRow("ring size") << int(RingSize);
+        QTest::newRow("larger than ring") << 10 * RingSize + 17;
+    }
+
+    void testTransfer()
+    {
+        QFETCH(int, size);
+        createDevices();
+
+        const auto data = testData(size);
+        QCOMPARE(transfer(m_serverDevice.get(), m_clientDevice.get(), data), data);
+        QCOMPARE(transfer(m_clientDevice.get(), m_serverDevice.get(), data), data);
+        QCOMPARE(m_serverDevice->bytesToWrite(), qint64(0));
+        QCOMPARE(m_clientDevice->bytesToWrite(), qint64(0));
+
+        // again, now starting at an offset in the ring
+        QCOMPARE(transfer(m_serverDevice.get(), m_clientDevice.get(), data), data);
+    }
+
+    void testReadyRead()
+    {
+        createDevices();
+        QSignalSpy spy(m_clientDevice.get(), SIGNAL(readyRead()));
+        QVERIFY(spy.isValid());
+
+        m_serverDevice->write("hello");
+        QVERIFY(spy.wait());
+        QCOMPARE(m_clientDevice->bytesAvailable(), qint64(5));
+        QCOMPARE(m_clientDevice->readAll(), QByteArray("hello"));
+
+        // the reader re-armed the doorbell, so we get notified again
+        m_serverDevice->write("world");
+        QVERIFY(spy.wait());
+        QCOMPARE(m_clientDevice->readAll(), QByteArray("world"));
+    }
+
+    void testDisconnect()
+    {
+        createDevices();
+        QSignalSpy spy(m_serverDevice.get(), SIGNAL(disconnected()));
+        QVERIFY(spy.isValid());
+
+        m_clientDevice->close();
+        QVERIFY(!m_clientDevice->isOpen());
+        QTRY_COMPARE(spy.size(), 1);
+        QVERIFY(!m_serverDevice->isOpen());
+    }
+
+    void benchmarkTransfer()
+    {
+        createDevices(SharedMemoryDevice::DefaultRingSize);
+        const auto data = testData(1024 * 1024);
+        QBENCHMARK {
+            transfer(m_serverDevice.get(), m_clientDevice.get(), data);
+        }
+    }
+
+private:
+    QLocalServer m_server;
+    std::unique_ptr<QLocalSocket> m_serverSocket;
+    std::unique_ptr<QLocalSocket> m_clientSocket;
+    std::unique_ptr<SharedMemoryDevice> m_serverDevice;
+    std::unique_ptr<SharedMemoryDevice> m_clientDevice;
+    int m_segmentCount = 0;
+};
+
+QTEST_MAIN(SharedMemoryDeviceTest)
+
+#include "sharedmemorydevicetest.moc"
@@ -26,6 +26,8 @@
 
 #include "baseprobetest.h"
 
+#include <core/util.h>
+
 #include <QPointer>
 
 using namespace GammaRay;
@@ -40,6 +42,22 @@ signals:
     void mySignal();
 };
 
+static QObject *s_expectedCaller = nullptr;
+static int s_rawSignalIndex = -1;
+static int s_methodIndex = -1;
+
+static void rawIndexCallback(QObject *caller, int index, void **)
+{
+    if (caller == s_expectedCaller)
+        s_rawSignalIndex = index;
+}
+
+static void methodIndexCallback(QObject *caller, int index, void **)
+{
+    if (caller == s_expectedCaller)
+        s_methodIndex = index;
+}
+
 class Receiver : public QObject
 {
     Q_OBJECT
@@ -71,6 +89,76 @@ private slots:
         QVERIFY(s2.isNull());
     }
 
+    void benchmarkRawIndexDispatch()
+    {
+        createProbe();
+
+        SignalSpyCallbackSet callbacks;
+        callbacks.signalBeginCallback = rawIndexCallback;
+        callbacks.rawSignalIndexes = true;
+        Probe::instance()->registerSignalSpyCallbackSet(callbacks);
+
+        Sender s;
+        QTest::qWait(1); // let the probe pick up s
+        QBENCHMARK {
+            for (int i = 0; i < 1000; ++i)
+                s.emitSignal();
+        }
+        Probe::instance()->unregisterSignalSpyCallbackSet(callbacks);
+    }
+
+    void benchmarkMethodIndexDispatch()
+    {
+        createProbe();
+
+        SignalSpyCallbackSet callbacks;
+        callbacks.signalBeginCallback = methodIndexCallback;
+        Probe::instance()->registerSignalSpyCallbackSet(callbacks);
+
+        Sender s;
+        QTest::qWait(1);
+        QBENCHMARK {
+            for (int i = 0; i < 1000; ++i)
+                s.emitSignal();
+        }
+        Probe::instance()->unregisterSignalSpyCallbackSet(callbacks);
+    }
+
+    void testCallbackIndexes()
+    {
+        createProbe();
+
+        SignalSpyCallbackSet rawCallbacks;
+        rawCallbacks.signalBeginCallback = rawIndexCallback;
+        rawCallbacks.rawSignalIndexes = true;
+        Probe::instance()->registerSignalSpyCallbackSet(rawCallbacks);
+        SignalSpyCallbackSet methodCallbacks;
+        methodCallbacks.signalBeginCallback = methodIndexCallback;
+        Probe::instance()->registerSignalSpyCallbackSet(methodCallbacks);
+
+        Sender s;
+        QTest::qWait(1);
+        s_rawSignalIndex = -1;
+        s_methodIndex = -1;
+        s_expectedCaller = &s;
+        s.emitSignal();
+        s_expectedCaller = nullptr;
+
+        Probe::instance()->unregisterSignalSpyCallbackSet(rawCallbacks);
+        Probe::instance()->unregisterSignalSpyCallbackSet(methodCallbacks);
+
+        QCOMPARE(s_methodIndex, Sender::staticMetaObject.indexOfSignal("mySignal()"));
+        QVERIFY(s_rawSignalIndex >= 0);
+        QCOMPARE(Util::signalIndexToMethodIndex(&Sender::staticMetaObject, s_rawSignalIndex), s_methodIndex);
+
+        // nothing is called anymore once unregistered
+        s_methodIndex = -1;
+        s_expectedCaller = &s;
+        s.emitSignal();
+        s_expectedCaller = nullptr;
+        QCOMPARE(s_methodIndex, -1);
+    }
+
     void cleanupTestCase()
     {
         // explicitly delete the probe as our usual cleanup doesn't work since we will
@@ -0,0 +1,108 @@
+/*
+  sortedobjectsettest.cpp
+
+  This file is part of GammaRay, the Qt application inspection and
+  manipulation tool.
+
+  Copyright (C) 2019 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+
+  Licensees holding valid commercial KDAB GammaRay licenses may use this file in
+  accordance with GammaRay Commercial License Agreement provided with the Software.
+
+  Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config-gammaray.h>
+
+#include "core/sortedobjectset.h"
+
+#include <QtTest/qtest.h>
+#include <QObject>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+using namespace GammaRay;
+
+class SortedObjectSetTest : public QObject
+{
+    Q_OBJECT
+private:
+    static void verifyContent(const SortedObjectSet &set, std::vector<QObject *> expected)
+    {
+        std::sort(expected.begin(), expected.end());
+        QCOMPARE(set.size(), static_cast<int>(expected.size()));
+        for (int i = 0; i < set.size(); ++i) {
+            QCOMPARE(set.at(i), expected.at(i));
+            QCOMPARE(set.indexOf(expected.at(i)), i);
+        }
+    }
+
+private slots:
+    void testInsertRemove()
+    {
+        std::vector<std::unique_ptr<QObject> > objects;
+        std::vector<QObject *> contained;
+        SortedObjectSet set;
+        QVERIFY(set.isEmpty());
+
+        for (int i = 0; i < 1000; ++i) {
+            objects.emplace_back(new QObject);
+            QObject *obj = objects.back().get();
+            const int row = set.lowerBound(obj);
+            QCOMPARE(set.insert(obj), row);
+            QCOMPARE(set.insert(obj), -1);
+            contained.push_back(obj);
+        }
+        verifyContent(set, contained);
+
+        for (int i = 0; i < 1000; i += 3) {
+            QObject *obj = objects.at(i).get();
+            const int row = set.indexOf(obj);
+            QVERIFY(row >= 0);
+            QCOMPARE(set.remove(obj), row);
+            QCOMPARE(set.remove(obj), -1);
+            QVERIFY(!set.contains(obj));
+            contained.erase(std::find(contained.begin(), contained.end(), obj));
+        }
+        verifyContent(set, contained);
+
+        SortedObjectSet copy(set);
+        set.clear();
+        QVERIFY(set.isEmpty());
+        verifyContent(copy, contained);
+    }
+
+    void benchmarkInsertRemove()
+    {
+        std::vector<std::unique_ptr<QObject> > objects;
+        for (int i = 0; i < 50000; ++i)
+            objects.emplace_back(new QObject);
+
+        QBENCHMARK {
+            SortedObjectSet set;
+            for (const auto &obj : objects)
+                set.insert(obj.get());
+            for (const auto &obj : objects)
+                set.remove(obj.get());
+        }
+    }
+};
+
+QTEST_MAIN(SortedObjectSetTest)
+
+#include "sortedobjectsettest.moc"
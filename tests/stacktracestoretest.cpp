@@ -0,0 +1,131 @@
+/*
+  stacktracestoretest.cpp
+
+  This file is part of GammaRay, the Qt application inspection and
+  manipulation tool.
+
+  Copyright (C) 2019 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+
+  Licensees holding valid commercial KDAB GammaRay licenses may use this file in
+  accordance with GammaRay Commercial License Agreement provided with the Software.
+
+  Contact info@kdab.com if any conditions of this licensing are not clear to you.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config-gammaray.h>
+
+#include "core/stacktracestore.h"
+
+#include <QtTest/qtest.h>
+#include <QObject>
+#include <QVector>
+
+#include <memory>
+#include <vector>
+
+using namespace GammaRay;
+
+static Q_NEVER_INLINE Execution::Trace traceA()
+{
+    return Execution::stackTrace(32);
+}
+
+static Q_NEVER_INLINE Execution::Trace traceB()
+{
+    return Execution::stackTrace(32);
+}
+
+class StackTraceStoreTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase()
+    {
+        if (!Execution::stackTracingAvailable())
+            QSKIP("stack tracing not available on this platform");
+    }
+
+    void testTraceEquality()
+    {
+        // same call site, thus same frames
+        QVector<Execution::Trace> traces;
+        for (int i = 0; i < 2; ++i)
+            traces.push_back(traceA());
+        QVERIFY(traces.at(0) == traces.at(0));
+        QVERIFY(traces.at(0) != traceB());
+#ifndef Q_OS_WIN // resolved traces are only compared by identity
+        QVERIFY(traces.at(0) == traces.at(1));
+        QCOMPARE(qHash(traces.at(0)), qHash(traces.at(1)));
+#endif
+    }
+
+    void testInsertRemove()
+    {
+        const auto a = traceA();
+        const auto b = traceB();
+        StackTraceStore store;
+        QObject o1, o2, o3;
+        QVERIFY(store.insert(&o1, a));
+        QVERIFY(store.insert(&o2, a));
+        QVERIFY(store.insert(&o3, b));
+        QCOMPARE(store.size(), 3);
+        QCOMPARE(store.uniqueTraceCount(), 2);
+        QVERIFY(store.contains(&o1));
+        QVERIFY(store.trace(&o1) == a);
+
+        const auto usage = store.memoryUsage();
+        QVERIFY(usage > 0);
+        store.remove(&o1);
+        QVERIFY(!store.contains(&o1));
+        QVERIFY(store.trace(&o1).empty());
+        QVERIFY(store.memoryUsage() < usage);
+
+        // replacing drops the last reference to the old trace
+        QVERIFY(store.insert(&o2, b));
+        QCOMPARE(store.size(), 2);
+        QCOMPARE(store.uniqueTraceCount(), 1);
+
+        store.remove(&o2);
+        store.remove(&o3);
+        QCOMPARE(store.size(), 0);
+        QCOMPARE(store.uniqueTraceCount(), 0);
+        QCOMPARE(store.memoryUsage(), qint64(0));
+    }
+
+    void testMemoryBudget()
+    {
+        const auto a = traceA();
+        const auto b = traceB();
+        std::vector<std::unique_ptr<QObject> > objects;
+        StackTraceStore store;
+        store.setMemoryBudget(4096);
+        for (int i = 0; i < 1000; ++i) {
+            objects.emplace_back(new QObject);
+            store.insert(objects.back().get(), i % 2 ? a : b);
+        }
+        QVERIFY(store.memoryUsage() <= store.memoryBudget());
+        QVERIFY(store.droppedCount() > 0);
+        QCOMPARE(store.size() + store.droppedCount(), 1000);
+
+        // removal makes room again
+        store.remove(objects.front().get());
+        QVERIFY(store.insert(objects.back().get(), a));
+    }
+};
+
+QTEST_MAIN(StackTraceStoreTest)
+
+#include "stacktracestoretest.moc"
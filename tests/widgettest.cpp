@@ -27,6 +27,7 @@
 #include "baseprobetest.h"
 
 #include <common/objectbroker.h>
+#include <common/objectmodel.h>
 
 #include <3rdparty/qt/modeltest.h>
 
@@ -92,6 +93,34 @@ private slots:
         QTest::qWait(1); // event loop re-entry
         QCOMPARE(visibleRowCount(model), 0);
     }
+
+    void testIndexForObject()
+    {
+        createProbe();
+
+        // the widget plugin activates with the first widget
+        auto w1 = new QWidget;
+        auto w2 = new QWidget(w1);
+        QTest::qWait(1); // event loop re-entry
+
+        auto *model = ObjectBroker::model(QStringLiteral("com.kdab.GammaRay.WidgetTree"));
+        QVERIFY(model);
+        auto probe = Probe::instance();
+        for (auto m : { model, probe->objectTreeModel(), probe->objectListModel() }) {
+            const auto idx = probe->indexForObject(w2, m);
+            QVERIFY(idx.isValid());
+            QCOMPARE(idx.model(), static_cast<const QAbstractItemModel *>(m));
+            QCOMPARE(idx.data(ObjectModel::ObjectRole).value<QObject *>(), w2);
+        }
+        QCOMPARE(probe->indexForObject(w2, model).parent(), probe->indexForObject(w1, model));
+
+        // not in the widget model, and not known at all, respectively
+        QVERIFY(!probe->indexForObject(probe, model).isValid());
+        QObject notTracked;
+        QVERIFY(!probe->indexForObject(&notTracked, model).isValid());
+
+        delete w1;
+    }
 };
 
 QTEST_MAIN(WidgetTest)
@@ -30,10 +30,16 @@
 #include "deferredtreeview.h"
 #include "deferredtreeview_p.h"
 
+#include <QAbstractProxyModel>
+#include <QItemSelection>
+#include <QKeyEvent>
+#include <QScrollBar>
 #include <QTimer>
 
 #include <private/qheaderview_p.h>
 
+#include <algorithm>
+
 using namespace GammaRay;
 
 namespace {
@@ -64,9 +70,15 @@ DeferredTreeView::DeferredTreeView(QWidget *parent)
     , m_expandNewContent(false)
     , m_allExpanded(false)
     , m_timer(new QTimer(this))
+    , m_viewportHintTimer(new QTimer(this))
+    , m_recursiveExpansionTimer(new QTimer(this))
 {
     m_timer->setSingleShot(true);
     m_timer->setInterval(125);
+    m_viewportHintTimer->setSingleShot(true);
+    m_viewportHintTimer->setInterval(0);
+    m_recursiveExpansionTimer->setSingleShot(true);
+    m_recursiveExpansionTimer->setInterval(0);
 
     setHeader(new HeaderView(header()->orientation(), this));
 
@@ -82,10 +94,20 @@ DeferredTreeView::DeferredTreeView(QWidget *parent)
 
     connect(header(), &QHeaderView::sectionCountChanged, this, &DeferredTreeView::sectionCountChanged);
     connect(m_timer, &QTimer::timeout, this, &DeferredTreeView::timeout);
+    connect(m_viewportHintTimer, &QTimer::timeout, this, &DeferredTreeView::updateViewportHint);
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, m_viewportHintTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+    connect(this, &QTreeView::expanded, m_viewportHintTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+    connect(this, &QTreeView::collapsed, m_viewportHintTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+    connect(m_recursiveExpansionTimer, &QTimer::timeout, this, &DeferredTreeView::expandRecursiveInsertedRows);
+    connect(this, &QTreeView::collapsed, this, &DeferredTreeView::stopRecursiveExpansion);
 }
 
 void DeferredTreeView::setModel(QAbstractItemModel *model)
 {
+    // the previous model shouldn't keep anything up to date for us anymore
+    sendViewportHint(QItemSelection());
+    m_recursiveExpansions.clear();
+    m_recursiveInsertedRows.clear();
     QTreeView::setModel(model);
 
     if (model)
@@ -163,6 +185,17 @@ void DeferredTreeView::setStretchLastSection(bool stretch)
     header()->setStretchLastSection(stretch);
 }
 
+void DeferredTreeView::expandRecursively(const QModelIndex &index, int depth)
+{
+    if (!model() || !index.isValid() || depth < -1)
+        return;
+
+    m_recursiveExpansions.push_back(qMakePair(QPersistentModelIndex(index), depth));
+    // before looking at the children, so the model doesn't start fetching them one by one
+    requestSubtree(index, depth);
+    expandSubtree(index, depth);
+}
+
 void DeferredTreeView::resetDeferredInitialized()
 {
     for (auto it = m_sectionsProperties.begin(), end = m_sectionsProperties.end(); it != end; ++it)
@@ -173,6 +206,169 @@ void DeferredTreeView::rowsInserted(const QModelIndex &parent, int start, int en
 {
     QTreeView::rowsInserted(parent, start, end);
     triggerExpansion(parent);
+
+    if (!m_recursiveExpansions.isEmpty() && recursiveExpansionDepth(parent) >= -1) {
+        m_recursiveInsertedRows.push_back(QPersistentModelIndex(parent));
+        m_recursiveExpansionTimer->start();
+    }
+}
+
+void DeferredTreeView::updateGeometries()
+{
+    QTreeView::updateGeometries();
+    m_viewportHintTimer->start();
+}
+
+void DeferredTreeView::showEvent(QShowEvent *event)
+{
+    QTreeView::showEvent(event);
+    m_viewportHintTimer->start();
+}
+
+void DeferredTreeView::hideEvent(QHideEvent *event)
+{
+    QTreeView::hideEvent(event);
+    m_viewportHintTimer->stop();
+    sendViewportHint(QItemSelection());
+}
+
+void DeferredTreeView::keyPressEvent(QKeyEvent *event)
+{
+    // QTreeView would only expand what is loaded already
+    if (event->key() == Qt::Key_Asterisk && currentIndex().isValid() && state() != EditingState) {
+        expandRecursively(currentIndex().sibling(currentIndex().row(), 0));
+        event->accept();
+        return;
+    }
+    QTreeView::keyPressEvent(event);
+}
+
+void DeferredTreeView::updateViewportHint()
+{
+    if (!model() || !isVisible())
+        return;
+
+    QItemSelection visible;
+    QModelIndex first;
+    QModelIndex last;
+    const auto addRange = [&]() {
+        if (first.isValid())
+            visible.select(first, last.sibling(last.row(), model()->columnCount(last.parent()) - 1));
+    };
+
+    // consecutive rows of the same parent form one range
+    const QModelIndex bottom = indexAt(QPoint(0, viewport()->height() - 1));
+    QModelIndex index = indexAt(QPoint(0, 0));
+    for (index = index.sibling(index.row(), 0); index.isValid(); index = indexBelow(index)) {
+        if (last.isValid() && index.parent() == last.parent() && index.row() == last.row() + 1) {
+            last = index;
+        } else {
+            addRange();
+            first = last = index;
+        }
+        if (bottom.isValid() && index.row() == bottom.row() && index.parent() == bottom.parent())
+            break;
+    }
+    addRange();
+
+    sendViewportHint(visible);
+}
+
+void DeferredTreeView::sendViewportHint(const QItemSelection &visible)
+{
+    QAbstractItemModel *sourceModel = model();
+    QItemSelection selection = visible;
+    while (auto proxy = qobject_cast<QAbstractProxyModel *>(sourceModel)) {
+        selection = proxy->mapSelectionToSource(selection);
+        sourceModel = proxy->sourceModel();
+    }
+
+    // RemoteModel lives in the client library, which we can't depend on here
+    if (!sourceModel || sourceModel->metaObject()->indexOfMethod("setViewport(QObject*,QItemSelection)") < 0)
+        return;
+    QMetaObject::invokeMethod(sourceModel, "setViewport", Q_ARG(QObject *, this),
+                              Q_ARG(QItemSelection, selection));
+}
+
+void DeferredTreeView::requestSubtree(const QModelIndex &index, int depth)
+{
+    QAbstractItemModel *sourceModel = model();
+    QModelIndex sourceIndex = index;
+    while (auto proxy = qobject_cast<QAbstractProxyModel *>(sourceModel)) {
+        sourceIndex = proxy->mapToSource(sourceIndex);
+        sourceModel = proxy->sourceModel();
+    }
+
+    if (!sourceModel || sourceModel->metaObject()->indexOfMethod("fetchSubtree(QModelIndex,int)") < 0)
+        return;
+    QMetaObject::invokeMethod(sourceModel, "fetchSubtree", Q_ARG(QModelIndex, sourceIndex),
+                              Q_ARG(int, depth));
+}
+
+int DeferredTreeView::recursiveExpansionDepth(const QModelIndex &index) const
+{
+    for (const auto &expansion : m_recursiveExpansions) {
+        if (!expansion.first.isValid())
+            continue;
+        int level = 0;
+        for (QModelIndex i = index; i.isValid(); i = i.parent(), ++level) {
+            if (expansion.first != i)
+                continue;
+            if (expansion.second < 0)
+                return -1;
+            if (level <= expansion.second)
+                return expansion.second - level;
+            break;
+        }
+    }
+    return -2;
+}
+
+void DeferredTreeView::expandSubtree(const QModelIndex &index, int depth)
+{
+    // expanding is cheap while a relayout is pending anyway
+    scheduleDelayedItemsLayout();
+
+    QVector<QPair<QModelIndex, int> > indexes;
+    indexes.push_back(qMakePair(index, depth));
+    while (!indexes.isEmpty()) {
+        const auto current = indexes.takeLast();
+        expand(current.first);
+        if (current.second == 0)
+            continue;
+        const int rowCount = model()->rowCount(current.first);
+        for (int row = 0; row < rowCount; ++row) {
+            const QModelIndex child = model()->index(row, 0, current.first);
+            if (model()->hasChildren(child))
+                indexes.push_back(qMakePair(child, current.second < 0 ? -1 : current.second - 1));
+        }
+    }
+}
+
+void DeferredTreeView::expandRecursiveInsertedRows()
+{
+    m_recursiveExpansions.erase(std::remove_if(m_recursiveExpansions.begin(), m_recursiveExpansions.end(),
+                                               [](const QPair<QPersistentModelIndex, int> &expansion) {
+        return !expansion.first.isValid();
+    }), m_recursiveExpansions.end());
+
+    const auto parents = m_recursiveInsertedRows;
+    m_recursiveInsertedRows.clear();
+    for (const auto &parent : parents) {
+        if (!parent.isValid())
+            continue;
+        const int depth = recursiveExpansionDepth(parent);
+        if (depth >= -1)
+            expandSubtree(parent, depth);
+    }
+}
+
+void DeferredTreeView::stopRecursiveExpansion(const QModelIndex &index)
+{
+    m_recursiveExpansions.erase(std::remove_if(m_recursiveExpansions.begin(), m_recursiveExpansions.end(),
+                                               [&index](const QPair<QPersistentModelIndex, int> &expansion) {
+        return expansion.first == index;
+    }), m_recursiveExpansions.end());
 }
 
 void DeferredTreeView::sectionCountChanged()
@@ -221,6 +417,7 @@ void DeferredTreeView::timeout()
         }
     } else {
         m_allExpanded = true;
+        requestSubtree(QModelIndex(), -1);
         expandAll();
     }
 
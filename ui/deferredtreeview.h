@@ -35,6 +35,7 @@
 #include <QMap>
 
 QT_BEGIN_NAMESPACE
+class QItemSelection;
 class QTimer;
 QT_END_NAMESPACE
 
@@ -67,14 +68,25 @@ public:
     bool stretchLastSection() const;
     void setStretchLastSection(bool stretch);
 
+    /** Expands @p index and its children down to @p depth levels, -1 meaning all of them.
+     *  Unlike QTreeView's version this also covers content that is still being loaded, and
+     *  lets remote models fetch the whole subtree at once. Content added to the subtree
+     *  later on is expanded as well, until @p index is collapsed again.
+     */
+    void expandRecursively(const QModelIndex &index, int depth = -1);
+
 signals:
     void newContentExpanded();
 
 protected:
     void resetDeferredInitialized();
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
 
 protected slots:
     void rowsInserted(const QModelIndex &parent, int start, int end) override;
+    void updateGeometries() override;
 
 private:
     struct DeferredHeaderProperties
@@ -98,11 +110,27 @@ private:
     bool m_allExpanded;
     QVector<QPersistentModelIndex> m_insertedRows;
     QTimer *m_timer;
+    QTimer *m_viewportHintTimer;
+    // root and depth of recursive expansions
+    QVector<QPair<QPersistentModelIndex, int> > m_recursiveExpansions;
+    QVector<QPersistentModelIndex> m_recursiveInsertedRows;
+    QTimer *m_recursiveExpansionTimer;
+
+    /** Tells the model about the rows currently shown, if it supports that. */
+    void sendViewportHint(const QItemSelection &visible);
+    /** Asks the model to load the subtree below @p index in one go, if it supports that. */
+    void requestSubtree(const QModelIndex &index, int depth);
+    /** Returns the remaining depth to expand @p index with, or -2 if not part of a recursive expansion. */
+    int recursiveExpansionDepth(const QModelIndex &index) const;
+    void expandSubtree(const QModelIndex &index, int depth);
 
 private slots:
     void sectionCountChanged();
     void triggerExpansion(const QModelIndex &parent);
     void timeout();
+    void updateViewportHint();
+    void expandRecursiveInsertedRows();
+    void stopRecursiveExpansion(const QModelIndex &index);
 };
 } // namespace GammaRay
 
@@ -45,6 +45,7 @@
 #include "stacktracetab.h"
 
 #include <common/objectbroker.h>
+#include <common/tools/objectinspector/stacktraceextensioninterface.h>
 
 #include <ui/uistatemanager.h>
 
@@ -116,6 +117,8 @@ public:
                                                PropertyWidgetTabPriority::Advanced);
         PropertyWidget::registerTab<StackTraceTab>(QStringLiteral("stackTrace"), tr("Stack Trace"),
                                                    PropertyWidgetTabPriority::Exotic);
+        ObjectBroker::registerClientObjectFactoryCallback<StackTraceExtensionInterface *>(
+            createExtension<StackTraceExtensionInterface>);
     }
 };
 }
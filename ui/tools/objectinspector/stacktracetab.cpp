@@ -31,10 +31,12 @@
 
 #include <ui/contextmenuextension.h>
 #include <ui/propertywidget.h>
+#include <ui/propertybinder.h>
 #include <ui/propertyeditor/propertyeditordelegate.h>
 
 #include <common/objectbroker.h>
 #include <common/sourcelocation.h>
+#include <common/tools/objectinspector/stacktraceextensioninterface.h>
 
 #include <QMenu>
 
@@ -49,6 +51,10 @@ GammaRay::StackTraceTab::StackTraceTab(PropertyWidget *parent)
     ui->stackTraceView->setModel(ObjectBroker::model(parent->objectBaseName() + QStringLiteral(".stackTraceModel")));
     ui->stackTraceView->header()->setObjectName(QStringLiteral("stackTraceViewHeader"));
     connect(ui->stackTraceView, &QWidget::customContextMenuRequested, this, &StackTraceTab::contextMenuRequested);
+
+    auto extension = ObjectBroker::object<StackTraceExtensionInterface *>(
+        parent->objectBaseName() + ".stackTraceExtension");
+    new PropertyBinder(extension, "statistics", ui->statisticsLabel, "text");
 }
 
 StackTraceTab::~StackTraceTab() = default;